@@ -0,0 +1,371 @@
+#include "batch.h"
+#include "featurefile.h"
+#include "featurematrix.h"
+#include "mfccextractor.h"
+#include "segmentation.h"
+#include "similarity.h"
+#include "similaritymatrix.h"
+#include "wavfile.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <iostream>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#endif
+
+namespace {
+
+bool isWavName(const char* name) {
+    const size_t length = std::strlen(name);
+    if (length <= 4 || name[length - 4] != '.')
+        return false;
+    const char* extension = name + length - 3;
+    return std::tolower(extension[0]) == 'w' && std::tolower(extension[1]) == 'a' && std::tolower(extension[2]) == 'v';
+}
+
+}
+
+// Everything one file needs on its way through the stages, reused by the following files of its slot
+struct batch_pipeline::job {
+    job(const mfcc_extractor<double>& extractor, const foote_segmenter<double>& segmenter)
+        : extractor(extractor), segmenter(segmenter) {}
+
+    std::string path;
+    wav_file wav;
+    sample_span<int16_t> samples;       // mono 16-bit PCM, in the mapping or in mono
+    std::vector<int16_t> mono;          // downmix of multichannel files
+    mfcc_extractor<double> extractor;
+    similarity_engine<double> similarity;
+    foote_segmenter<double> segmenter;
+    feature_matrix<double> features;
+    similarity_matrix<double> ssm;
+    banded_similarity_matrix<double> bandedSsm;
+    std::vector<size_t> boundaries;
+
+    batch_stage stage = BATCH_READ;     // stage running or last run
+    std::string error;                  // empty unless the stage failed
+    double audioSeconds = 0;
+    double stageSeconds[BATCH_NUM_STAGES] = {};
+};
+
+void batch_report::print() const {
+    std::cout << "files: " << numFiles << " written, " << numFailed << " failed, " << seconds << " seconds" << std::endl;
+    std::cout << "throughput: " << filesPerSecond() << " files/s, " << audioSeconds << " s of audio, realtime factor "
+              << realtimeFactor();
+    if (realtimeFactor() > 0)
+        std::cout << " (" << 1 / realtimeFactor() << "x real time)";
+    std::cout << std::endl;
+    for (int s=0; s<BATCH_NUM_STAGES; s++)
+        std::cout << "stage " << batch_pipeline::stageName(batch_stage(s)) << ": " << stageSeconds[s] << " seconds"
+                  << std::endl;
+}
+
+batch_pipeline::batch_pipeline(const batch_config& config, task_system& pool) : cfg(config), pool(pool) {
+    if (cfg.maxInFlight == 0)
+        cfg.maxInFlight = 2 * pool.size();
+
+    // One extractor and kernel are set up, the slots share their tables
+    mfcc_extractor<double> extractor(cfg.mfcc);
+    foote_segmenter<double> segmenter(cfg.novelty);
+
+    maxLag = size_t(cfg.maxLagSeconds * cfg.mfcc.fs / extractor.frameShiftLength());
+    if (maxLag > 0)
+        maxLag = std::max(maxLag, segmenter.minimumLag());
+
+    for (size_t i=0; i<cfg.maxInFlight; i++)
+        slots.push_back(std::make_unique<job>(extractor, segmenter));
+}
+
+batch_pipeline::~batch_pipeline() = default;
+
+const char* batch_pipeline::stageName(batch_stage stage) {
+    static const char* const names[BATCH_NUM_STAGES] = {"read", "decode", "mfcc", "similarity", "write"};
+    return stage < BATCH_NUM_STAGES ? names[stage] : "unknown";
+}
+
+int batch_pipeline::run(const std::vector<std::string>& paths, batch_report& report) {
+    typedef std::chrono::steady_clock clock;
+    const clock::time_point start = clock::now();
+    report = batch_report();
+    int result = 0;
+
+    // Files waiting in front of each stage, and files whose stage has finished, at most one per slot
+    std::vector<std::unique_ptr<bounded_queue<job*>>> waiting;
+    for (int s=0; s<BATCH_NUM_STAGES; s++)
+        waiting.push_back(std::make_unique<bounded_queue<job*>>(cfg.queueCapacity));
+    bounded_queue<job*> finished(slots.size());
+
+    std::vector<job*> idle;
+    for (auto& slot : slots)
+        idle.push_back(slot.get());
+    size_t active[BATCH_NUM_STAGES] = {};
+    size_t next = 0;
+
+    while (true) {
+        // Start stages and open files until neither can go on
+        bool progress = true;
+        while (progress) {
+            progress = false;
+
+            // Downstream first; a stage starts only if the queue behind it has room for every file it runs
+            for (int s=BATCH_NUM_STAGES-1; s>=0; s--) {
+                bounded_queue<job*>* behind = s + 1 < BATCH_NUM_STAGES ? waiting[s + 1].get() : nullptr;
+                job* j = nullptr;
+                while (active[s] < pool.size() && (!behind || behind->size() + active[s] < behind->capacity()) &&
+                       waiting[s]->try_pop(j)) {
+                    active[s]++;
+                    progress = true;
+                    j->stage = batch_stage(s);
+                    pool.async([this, j, &finished]() {
+                        const clock::time_point begin = clock::now();
+                        runStage(j->stage, *j);
+                        j->stageSeconds[j->stage] = std::chrono::duration<double>(clock::now() - begin).count();
+                        finished.push(j);
+                    });
+                }
+            }
+
+            // Open the next files while a slot is free and the first stage has room
+            while (next < paths.size() && !idle.empty() &&
+                   waiting[BATCH_READ]->size() < waiting[BATCH_READ]->capacity()) {
+                job* j = idle.back();
+                idle.pop_back();
+                j->path = paths[next++];
+                j->error.clear();
+                j->audioSeconds = 0;
+                std::fill(j->stageSeconds, j->stageSeconds + BATCH_NUM_STAGES, 0.0);
+                waiting[BATCH_READ]->try_push(j);
+                progress = true;
+            }
+        }
+
+        if (idle.size() == slots.size() && next == paths.size())
+            break;
+
+        // Move the next finished file on, room behind its stage was reserved when the stage started
+        job* j = nullptr;
+        finished.pop(j);
+        active[j->stage]--;
+        if (j->error.empty() && j->stage + 1 < BATCH_NUM_STAGES) {
+            waiting[j->stage + 1]->try_push(j);
+            continue;
+        }
+
+        if (j->error.empty()) {
+            report.numFiles++;
+            report.audioSeconds += j->audioSeconds;
+            std::cout << j->path << ": " << j->features.rows() << " frames, " << j->boundaries.size() + 1
+                      << " segments" << std::endl;
+        } else {
+            report.numFailed++;
+            result = 1;
+            std::cout << j->path << ": " << stageName(j->stage) << " failed, " << j->error << std::endl;
+        }
+        for (int s=0; s<BATCH_NUM_STAGES; s++)
+            report.stageSeconds[s] += j->stageSeconds[s];
+
+        // Unmap the audio, the other buffers stay for the next file of the slot
+        j->wav = wav_file();
+        j->samples = sample_span<int16_t>();
+        idle.push_back(j);
+    }
+
+    report.seconds = std::chrono::duration<double>(clock::now() - start).count();
+    return result;
+}
+
+// An exception, e.g. bad_alloc on a huge file, fails the file and not the worker that ran the stage
+int batch_pipeline::runStage(batch_stage stage, job& j) const {
+    try {
+        switch (stage) {
+        case BATCH_READ:
+            return read(j);
+        case BATCH_DECODE:
+            return decode(j);
+        case BATCH_MFCC:
+            return extract(j);
+        case BATCH_SIMILARITY:
+            return segment(j);
+        case BATCH_WRITE:
+            return write(j);
+        default:
+            j.error = "unknown stage";
+            return 1;
+        }
+    } catch (const std::exception& e) {
+        j.error = std::string("exception: ") + e.what();
+    } catch (...) {
+        j.error = "unknown exception";
+    }
+    return 1;
+}
+
+int batch_pipeline::read(job& j) const {
+    if (j.wav.open(j.path.c_str()) != 0) {
+        j.error = "unable to read WAV file";
+        return 1;
+    }
+    return 0;
+}
+
+int batch_pipeline::decode(job& j) const {
+    const wav_format& fmt = j.wav.format();
+    if (!j.wav.isPcm16() || fmt.numChannels == 0) {
+        j.error = "unsupported audio format, use 16 bit PCM Wave";
+        return 1;
+    }
+    if (fmt.sampleRate != cfg.mfcc.fs) {
+        j.error = "sampling rate mismatch: found " + std::to_string(fmt.sampleRate) + " instead of " +
+                  std::to_string(cfg.mfcc.fs);
+        return 1;
+    }
+
+    // Mono is analysed in place, other layouts are mixed down to the mean of their channels
+    const sample_span<int16_t> interleaved = j.wav.samples();
+    const size_t channels = fmt.numChannels;
+    if (channels == 1) {
+        j.samples = interleaved;
+    } else {
+        const size_t frames = interleaved.size / channels;
+        j.mono.resize(frames);
+        for (size_t i=0; i<frames; i++) {
+            int32_t sum = 0;
+            for (size_t c=0; c<channels; c++)
+                sum += interleaved[i * channels + c];
+            j.mono[i] = int16_t(sum / int32_t(channels));
+        }
+        j.samples.data = j.mono.data();
+        j.samples.size = frames;
+    }
+    j.audioSeconds = double(j.samples.size) / cfg.mfcc.fs;
+    return 0;
+}
+
+int batch_pipeline::extract(job& j) const {
+    j.extractor.reset();
+    j.features.reset(j.extractor.numCoefficients());
+    j.features.reserve(j.extractor.pendingFrames(j.samples.size));
+    feature_matrix<double>& features = j.features;
+    j.extractor.push(j.samples.data, j.samples.size, [&features](size_t, const double* coef) {
+        features.appendRow(coef);
+    });
+    return 0;
+}
+
+// Serial within the task, the workers are busy with the other files
+int batch_pipeline::segment(job& j) const {
+    if (maxLag > 0) {
+        j.ssm.clear();
+        j.similarity.compute(j.features, maxLag, j.bandedSsm);
+        j.segmenter.segment(j.bandedSsm, j.boundaries);
+    } else {
+        j.bandedSsm.clear();
+        j.similarity.compute(j.features, j.ssm);
+        j.segmenter.segment(j.ssm, j.boundaries);
+    }
+    return 0;
+}
+
+int batch_pipeline::write(job& j) const {
+    const feature_matrix<double>& features = j.features;
+    const std::string mfcPath = outputPath(j.path, ".mfc");
+    feature_file_writer writer;
+    if (writer.open(mfcPath.c_str(), cfg.mfcc, features.cols()) != 0) {
+        j.error = "unable to write " + mfcPath;
+        return 1;
+    }
+    for (size_t i=0; i<features.rows(); i++)
+        writer.append(features.row(i));
+    if (writer.close() != 0) {
+        j.error = "unable to write " + mfcPath;
+        return 1;
+    }
+
+    if (cfg.writeHtk) {
+        const std::string htkPath = outputPath(j.path, ".htk");
+        htk_writer htk;
+        if (htk.open(htkPath.c_str(), cfg.mfcc, features.cols()) != 0) {
+            j.error = "unable to write " + htkPath;
+            return 1;
+        }
+        for (size_t i=0; i<features.rows(); i++)
+            htk.append(features.row(i));
+        if (htk.close() != 0) {
+            j.error = "unable to write " + htkPath;
+            return 1;
+        }
+    }
+
+    // Segment boundaries, one time in seconds per line
+    const std::string segPath = outputPath(j.path, ".seg");
+    const double hop = double(j.extractor.frameShiftLength()) / cfg.mfcc.fs;
+    std::ofstream seg(segPath, std::ios::trunc);
+    for (size_t frame : j.boundaries)
+        seg << frame * hop << "\n";
+    seg.close();
+    if (seg.fail()) {
+        j.error = "unable to write " + segPath;
+        return 1;
+    }
+    return 0;
+}
+
+// Output file of the input at path: same name with the extension replaced, in the output directory if one is set
+std::string batch_pipeline::outputPath(const std::string& path, const char* extension) const {
+    const size_t slash = path.find_last_of("/\\");
+    std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+    const size_t dot = name.find_last_of('.');
+    if (dot != std::string::npos)
+        name.erase(dot);
+    std::string directory = cfg.outputDirectory;
+    if (directory.empty())
+        directory = slash == std::string::npos ? "." : path.substr(0, slash);
+    return directory + "/" + name + extension;
+}
+
+#ifdef _WIN32
+
+int batch_pipeline::listWavFiles(const std::string& directory, std::vector<std::string>& paths) {
+    paths.clear();
+    WIN32_FIND_DATAA data;
+    HANDLE find = FindFirstFileA((directory + "\\*").c_str(), &data);
+    if (find == INVALID_HANDLE_VALUE) {
+        std::cout << "Unable to open directory: " << directory << std::endl;
+        return 1;
+    }
+    do {
+        if (!(data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) && isWavName(data.cFileName))
+            paths.push_back(directory + "/" + data.cFileName);
+    } while (FindNextFileA(find, &data));
+    FindClose(find);
+    std::sort(paths.begin(), paths.end());
+    return 0;
+}
+
+#else
+
+int batch_pipeline::listWavFiles(const std::string& directory, std::vector<std::string>& paths) {
+    paths.clear();
+    DIR* dir = opendir(directory.c_str());
+    if (!dir) {
+        std::cout << "Unable to open directory: " << directory << std::endl;
+        return 1;
+    }
+    while (dirent* entry = readdir(dir)) {
+        if (isWavName(entry->d_name))
+            paths.push_back(directory + "/" + entry->d_name);
+    }
+    closedir(dir);
+    std::sort(paths.begin(), paths.end());
+    return 0;
+}
+
+#endif
@@ -0,0 +1,94 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "mfcc.h"
+#include "streamingsimilarity.h"
+#include "task.h"
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Stages of the batch pipeline, in the order a file goes through them
+enum batch_stage {
+    BATCH_READ,             // map the file and parse the RIFF chunks
+    BATCH_DECODE,           // check the format, mix multichannel audio down to mono
+    BATCH_MFCC,             // extract the MFCCs of all frames
+    BATCH_SIMILARITY,       // self-similarity matrix and segmentation
+    BATCH_WRITE,            // feature file and segment boundaries
+    BATCH_NUM_STAGES
+};
+
+struct batch_config {
+    mfcc_config mfcc;
+    novelty_config novelty;
+    double maxLagSeconds = 30;      // limit the self-similarity matrix to frames this far apart, 0 for the full matrix
+    size_t queueCapacity = 2;       // files waiting in front of each stage
+    size_t maxInFlight = 0;         // files opened and not yet written, 0 for twice the number of workers
+    std::string outputDirectory;    // empty to write next to the input files
+    bool writeHtk = false;          // an HTK parameter file besides the binary feature file
+};
+
+struct batch_report {
+    size_t numFiles = 0;            // files written
+    size_t numFailed = 0;
+    double seconds = 0;             // wall clock time of the run
+    double audioSeconds = 0;        // duration of the audio of the files written
+    double stageSeconds[BATCH_NUM_STAGES] = {};     // time spent in each stage, summed over the workers
+
+    double filesPerSecond() const { return seconds > 0 ? numFiles / seconds : 0; }
+    // Processing time over audio time, below 1 is faster than real time
+    double realtimeFactor() const { return audioSeconds > 0 ? seconds / audioSeconds : 0; }
+
+    void print() const;
+};
+
+/* Batch analysis of many files
+ * Every file goes through the stages read, decode, MFCC, self-similarity/segmentation and write. The stages of
+ * different files overlap: each stage runs on the workers of a shared task_system, and each has a bounded queue of
+ * files waiting in front of it. A coordinator, the thread that calls run(), moves the files along: it starts a stage on
+ * a file only if the queue behind that stage has room for the result, and opens the next file only while fewer than
+ * maxInFlight are open. A slow stage therefore fills the queues in front of it and stalls the stages before it, down to
+ * reading, so memory stays bounded whatever the number and length of the files. Stages downstream are served first, to
+ * finish files before starting new ones.
+ *
+ * A file that fails in any stage is reported and skipped; the others go on. The buffers of a file (MFCCs, matrices,
+ * extractor) are kept with its slot and reused by the next file, so a long run does not allocate per file once the
+ * slots have grown to the longest file. Tasks never block on a queue; stage work runs serially within a task, the
+ * parallelism is across files.
+ */
+class batch_pipeline {
+
+public:
+    explicit batch_pipeline(const batch_config& config = batch_config(), task_system& pool = default_task_system());
+    ~batch_pipeline();
+
+    // Analyse the files at paths and write the results, returns 0 if every file succeeded
+    int run(const std::vector<std::string>& paths, batch_report& report);
+
+    // Paths of the .wav files in directory, sorted, returns 0 on success
+    static int listWavFiles(const std::string& directory, std::vector<std::string>& paths);
+
+    static const char* stageName(batch_stage stage);
+
+private:
+    struct job;
+
+    batch_config cfg;
+    task_system& pool;
+    size_t maxLag = 0;
+    std::vector<std::unique_ptr<job>> slots;
+
+    // Run stage of the job, returns 0 on success and sets the error of the job otherwise
+    int runStage(batch_stage stage, job& j) const;
+    int read(job& j) const;
+    int decode(job& j) const;
+    int extract(job& j) const;
+    int segment(job& j) const;
+    int write(job& j) const;
+
+    std::string outputPath(const std::string& path, const char* extension) const;
+};
+
+#endif // BATCH_H
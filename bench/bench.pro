@@ -0,0 +1,35 @@
+# Benchmarks of the analysis and of the dispatch experiments, without Qt:
+# qmake bench.pro && make && ./bench --json results.json
+TEMPLATE = app
+TARGET = bench
+
+CONFIG += c++14 console
+CONFIG -= qt app_bundle
+
+INCLUDEPATH += ..
+
+# Count the calls of operator new, see function.h
+DEFINES += ALLOCATION_HOOK
+
+# Time the stages without the stage histograms of profiler.h, whose clock reads would be part of every timing
+DEFINES += NO_PIPELINE_PROFILING
+
+SOURCES += main.cpp \
+    benchmark.cpp \
+    ../function.cpp \
+    ../fft.cpp \
+    ../kernels.cpp \
+    ../melfilterbank.cpp \
+    ../mfcc.cpp \
+    ../mfccextractor.cpp \
+    ../similarity.cpp \
+    ../streamingsimilarity.cpp \
+    ../segmentation.cpp \
+    ../profiler.cpp \
+    ../task.cpp \
+    ../wavfile.cpp
+
+HEADERS += \
+    benchmark.h \
+    experiments.h \
+    fftreference.h
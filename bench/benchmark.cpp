@@ -0,0 +1,126 @@
+#include "benchmark.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iomanip>
+#include <thread>
+
+#if !defined(__GNUC__) && !defined(__clang__)
+void escape(const void* p) {
+    static const void* volatile sink;
+    sink = p;
+}
+#endif
+
+namespace {
+
+// Value at fraction q of the sorted values, nearest rank
+double quantile(const std::vector<double>& sorted, double q) {
+    if (sorted.empty())
+        return 0;
+    size_t rank = size_t(std::ceil(q * sorted.size()));
+    return sorted[std::min(sorted.size(), std::max<size_t>(rank, 1)) - 1];
+}
+
+double median(std::vector<double> values) {
+    std::sort(values.begin(), values.end());
+    const size_t n = values.size();
+    if (n == 0)
+        return 0;
+    return n % 2 ? values[n/2] : (values[n/2 - 1] + values[n/2]) / 2;
+}
+
+// Time with a unit that leaves three to four significant digits
+std::string formatSeconds(double seconds) {
+    char text[32];
+    if (seconds < 1e-6)
+        std::snprintf(text, sizeof(text), "%.2f ns", seconds * 1e9);
+    else if (seconds < 1e-3)
+        std::snprintf(text, sizeof(text), "%.2f us", seconds * 1e6);
+    else if (seconds < 1)
+        std::snprintf(text, sizeof(text), "%.2f ms", seconds * 1e3);
+    else
+        std::snprintf(text, sizeof(text), "%.3f s", seconds);
+    return text;
+}
+
+std::string jsonString(const std::string& s) {
+    std::string out = "\"";
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out += escaped;
+        } else {
+            out += c;
+        }
+    }
+    return out + "\"";
+}
+
+}
+
+void benchmark_result::summarise() {
+    std::vector<double> sorted(seconds);
+    std::sort(sorted.begin(), sorted.end());
+    median = ::median(sorted);
+    p95 = quantile(sorted, 0.95);
+    min = sorted.empty() ? 0 : sorted.front();
+    std::vector<double> deviations;
+    for (double s : sorted)
+        deviations.push_back(std::abs(s - median));
+    mad = ::median(deviations);
+}
+
+benchmark_runner::benchmark_runner(const benchmark_config& config, std::ostream* log) : cfg(config), log(log) {}
+
+bool benchmark_runner::selected(const std::string& name) const {
+    return nameFilter.empty() || name.find(nameFilter) != std::string::npos;
+}
+
+void benchmark_runner::add(benchmark_result result) {
+    result.summarise();
+    if (log) {
+        *log << std::left << std::setw(48) << result.name << std::right
+             << " median " << std::setw(10) << formatSeconds(result.median)
+             << "  p95 " << std::setw(10) << formatSeconds(result.p95)
+             << "  MAD " << std::setw(5) << std::fixed << std::setprecision(1)
+             << (result.median > 0 ? 100 * result.mad / result.median : 0) << "%"
+             << "  allocs " << std::setprecision(2) << result.allocations << std::defaultfloat << std::endl;
+    }
+    benchmarkResults.push_back(std::move(result));
+}
+
+void benchmark_runner::writeJson(std::ostream& out) const {
+    out << std::setprecision(6) << std::defaultfloat;
+    out << "{\n  \"context\": {\n";
+#if defined(__clang__)
+    out << "    \"compiler\": " << jsonString(std::string("clang ") + __clang_version__) << ",\n";
+#elif defined(__GNUC__)
+    out << "    \"compiler\": " << jsonString(std::string("gcc ") + __VERSION__) << ",\n";
+#elif defined(_MSC_VER)
+    out << "    \"compiler\": " << jsonString("msvc " + std::to_string(_MSC_VER)) << ",\n";
+#endif
+#ifdef NDEBUG
+    out << "    \"assertions\": false,\n";
+#else
+    out << "    \"assertions\": true,\n";
+#endif
+    out << "    \"hardware_threads\": " << std::thread::hardware_concurrency() << ",\n";
+    out << "    \"warmup_runs\": " << cfg.warmupRuns << ",\n";
+    out << "    \"min_run_seconds\": " << cfg.minRunSeconds << "\n";
+    out << "  },\n  \"benchmarks\": [";
+    for (size_t i=0; i<benchmarkResults.size(); i++) {
+        const benchmark_result& r = benchmarkResults[i];
+        out << (i ? "," : "") << "\n    {\"name\": " << jsonString(r.name)
+            << ", \"items\": " << r.items << ", \"iterations\": " << r.iterations << ", \"runs\": " << r.seconds.size()
+            << ", \"median_ns\": " << r.median * 1e9 << ", \"p95_ns\": " << r.p95 * 1e9
+            << ", \"mad_ns\": " << r.mad * 1e9 << ", \"min_ns\": " << r.min * 1e9
+            << ", \"allocations\": " << r.allocations << "}";
+    }
+    out << "\n  ]\n}\n";
+}
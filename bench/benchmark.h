@@ -0,0 +1,143 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include "function.h"
+
+#include <chrono>
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/* Keep the compiler from optimizing a computation away
+ * doNotOptimize(x) makes the compiler assume that x is read and may be modified, so the code that computes x runs and
+ * code that uses x cannot fold it to a constant; clobberMemory() makes it assume that all memory is read and written,
+ * so stores to buffers are not dropped. Neither emits an instruction.
+ */
+#if defined(__GNUC__) || defined(__clang__)
+template<typename T>
+inline void doNotOptimize(T& value) {
+    asm volatile("" : "+m"(value) : : "memory");
+}
+
+template<typename T>
+inline void doNotOptimize(const T& value) {
+    asm volatile("" : : "m"(value) : "memory");
+}
+
+inline void clobberMemory() {
+    asm volatile("" : : : "memory");
+}
+#else
+#include <atomic>
+
+void escape(const void* p);     // defined in benchmark.cpp, opaque to the caller
+
+template<typename T>
+inline void doNotOptimize(const T& value) {
+    escape(&value);
+}
+
+inline void clobberMemory() {
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+}
+#endif
+
+struct benchmark_config {
+    size_t warmupRuns = 2;          // runs after calibration that are not measured
+    size_t runs = 20;               // measured runs
+    double minRunSeconds = 0.005;   // a run calls the body until it took this long, the number of calls is calibrated
+};
+
+// Times per item of the runs of one benchmark and their statistics
+struct benchmark_result {
+    std::string name;
+    size_t items = 1;               // work items per call of the body, the times are per item
+    size_t iterations = 0;          // calls of the body per run
+    std::vector<double> seconds;    // per item, one value per run
+    double median = 0;
+    double p95 = 0;
+    double mad = 0;                 // median absolute deviation from the median
+    double min = 0;
+    double allocations = 0;         // calls of operator new per item
+
+    // Fill in the statistics from seconds
+    void summarise();
+};
+
+/* Micro-benchmark runner
+ * run() calls the body repeatedly on the calling thread: first with 1, 2, 4, ... calls per run until a run takes
+ * minRunSeconds, then for warmupRuns unmeasured runs with that number of calls, then for runs measured runs. Every run
+ * is timed with steady_clock as a whole, so the cost of reading the clock is spread over the calls, and gives one time
+ * per item; the report is the median, the 95th percentile and the MAD of these, robust against the occasional run that
+ * an interrupt or another process slowed down. The body must leave its state ready for the next call and should pass
+ * its results to doNotOptimize().
+ *
+ * Every result is printed as it completes; writeJson() writes all of them for comparison between builds.
+ */
+class benchmark_runner {
+
+public:
+    explicit benchmark_runner(const benchmark_config& config = benchmark_config(), std::ostream* log = nullptr);
+
+    // Run only the benchmarks whose name contains filter
+    void setFilter(const std::string& filter) { nameFilter = filter; }
+    bool selected(const std::string& name) const;
+
+    const benchmark_config& config() const { return cfg; }
+
+    template<typename F>
+    void run(const std::string& name, F&& body) { run(name, 1, cfg, body); }
+
+    template<typename F>
+    void run(const std::string& name, size_t items, F&& body) { run(name, items, cfg, body); }
+
+    template<typename F>
+    void run(const std::string& name, size_t items, const benchmark_config& config, F&& body);
+
+    const std::vector<benchmark_result>& results() const { return benchmarkResults; }
+
+    // Every result with its statistics, and the compiler and machine it was measured with
+    void writeJson(std::ostream& out) const;
+
+private:
+    benchmark_config cfg;
+    std::ostream* log;
+    std::string nameFilter;
+    std::vector<benchmark_result> benchmarkResults;
+
+    template<typename F>
+    static double timeCalls(F& body, size_t iterations) {
+        const auto start = std::chrono::steady_clock::now();
+        for (size_t i=0; i<iterations; i++)
+            body();
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    void add(benchmark_result result);
+};
+
+template<typename F>
+void benchmark_runner::run(const std::string& name, size_t items, const benchmark_config& config, F&& body) {
+    if (!selected(name))
+        return;
+
+    size_t iterations = 1;
+    while (timeCalls(body, iterations) < config.minRunSeconds && iterations < (size_t(1) << 30))
+        iterations *= 2;
+    for (size_t r=0; r<config.warmupRuns; r++)
+        timeCalls(body, iterations);
+
+    benchmark_result result;
+    result.name = name;
+    result.items = items;
+    result.iterations = iterations;
+    result.seconds.reserve(config.runs);
+    const size_t allocations = allocationCount();
+    for (size_t r=0; r<config.runs; r++)
+        result.seconds.push_back(timeCalls(body, iterations) / (double(iterations) * items));
+    result.allocations = double(allocationCount() - allocations) / (double(config.runs) * iterations * items);
+    add(std::move(result));
+}
+
+#endif // BENCHMARK_H
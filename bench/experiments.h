@@ -0,0 +1,420 @@
+#ifndef EXPERIMENTS_H
+#define EXPERIMENTS_H
+
+#include "polystorage.h"
+
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+/* The dispatch and type erasure experiments that used to run in the application, timed by the benchmarks in
+ * bench/main.cpp
+ */
+
+/* ## Type Erasure with Templates from jsmith cplusplus.com article (2010 jsmith)
+ * Instances of type Object can be created with arbitrary types because it has a generic constructor.
+ */
+class Wild {
+public:
+    std::string getName() const {
+        return "Wild";
+    }
+    double implementation(double param) const {
+        return (param * param) / 2.5;
+    }
+};
+
+class Running {
+public:
+    std::string getName() const {
+        return "Running";
+    }
+    double implementation(double param) const {
+        return (param * param) / 2.5;
+    }
+};
+
+class Homeless {
+public:
+    std::string getName() const {
+        return "Homeless";
+    }
+    double implementation(double param) const {
+        return (param * param) / 2.5;
+    }
+};
+
+class Object {
+public:
+    template<typename T>
+    Object(const T& obj) : object(std::make_shared<ObjectModel<T>>(std::move(obj))) {} // let's heap-allocate the ObjectModel...
+    /* Object(const T& obj) : object(new ObjectModel<T>(obj)) {}
+     * Object(const T& obj) : object(std::make_shared<ObjectModel<T>>(obj)) {}
+     */
+    std::string getName() const {
+        return object->getName();
+    }
+    double implementation(double param) const {
+        return object->implementation(param);
+    }
+
+    struct ObjectConcept {
+        virtual ~ObjectConcept() {}
+        virtual std::string getName() const = 0;
+        virtual double implementation(double param) const = 0;
+    };
+
+    template<typename T>
+    struct ObjectModel : ObjectConcept {
+        ObjectModel(const T& obj) : object(std::move(obj)) {}
+        virtual ~ObjectModel() {}
+        std::string getName() const override {
+            return object.getName();
+        }
+        double implementation(double param) const override {
+            return object.implementation(param);
+        }
+    private:
+        T object;
+    };
+
+private:
+    std::shared_ptr<const ObjectConcept> object;
+};
+
+/* The same interface with a manual vtable and the object stored inline: Wild, Running and Homeless fit in the 16 bytes,
+ * so an instance costs no allocation, and a copy copies the object instead of sharing it.
+ */
+struct object_table {
+    lifetime_table lifetime;
+    std::string (*getName)(const void* object);
+    double (*implementation)(const void* object, double param);
+};
+
+template<typename T>
+struct object_functions {
+    static std::string getName(const void* object) {
+        return static_cast<const T*>(object)->getName();
+    }
+    static double implementation(const void* object, double param) {
+        return static_cast<const T*>(object)->implementation(param);
+    }
+    static const object_table* table() {
+        static const object_table t = {lifetimeOf<T>(), &getName, &implementation};
+        return &t;
+    }
+};
+
+class SmallObject {
+public:
+    template<typename T>
+    SmallObject(const T& obj) : object(object_functions<T>::table(), obj) {}
+
+    std::string getName() const {
+        return object.table()->getName(object.get());
+    }
+    double implementation(double param) const {
+        return object.table()->implementation(object.get(), param);
+    }
+
+private:
+    small_value<16, object_table> object;
+};
+
+// Objects of any of the types one after the other in one buffer
+class ObjectVector {
+public:
+    template<typename T>
+    void push_back(const T& obj) {
+        objects.push_back(object_functions<T>::table(), obj);
+    }
+    size_t size() const {
+        return objects.size();
+    }
+    std::string getName(size_t i) const {
+        return objects.table(i).getName(objects.get(i));
+    }
+    double implementation(size_t i, double param) const {
+        return objects.table(i).implementation(objects.get(i), param);
+    }
+
+private:
+    poly_vector<object_table> objects;
+};
+// _________________________________________________________________________________________________________________
+
+/* ### What is Type Erasure? – Arthur O'Dwyer – Stuff mostly about C++
+ * We need to move the object into a region of storage where we can control its lifetime via explicit delete or
+ * placement-destruction syntax. The by-far easiest way to do that is to heap-allocate our WrappingCallback.
+ */
+struct AbstractCallback {
+    virtual int call(int) const = 0;
+    virtual ~AbstractCallback() = default;
+};
+
+template<class T>
+struct WrappingCallback : AbstractCallback {
+    explicit WrappingCallback(T&& cb) : cb_(std::move(cb)) {} // explicit move constructor...
+    int call(int x) const override {
+        return cb_(x);
+    }
+
+    T cb_;
+};
+
+struct Callback {
+    std::unique_ptr<AbstractCallback> ptr_;
+
+    template<class T>
+    Callback(T t) : ptr_(std::make_unique<WrappingCallback<T>>(std::move(t))) {} // let's heap-allocate the WrappingCallback...
+    /* Callback(T t) : ptr_(new WrappingCallback<T>(std::move(t))) {}
+     */
+
+    int operator()(int x) const { // call operator...
+        return ptr_->call(x);
+    }
+};
+
+// The callback stored inline with a manual vtable: a lambda that captures up to four pointers costs no allocation
+struct callback_table {
+    lifetime_table lifetime;
+    int (*call)(const void* callback, int x);
+};
+
+template<class T>
+struct callback_functions {
+    static int call(const void* callback, int x) {
+        return (*static_cast<const T*>(callback))(x);
+    }
+    static const callback_table* table() {
+        static const callback_table t = {lifetimeOf<T>(), &call};
+        return &t;
+    }
+};
+
+struct SmallCallback {
+    small_value<32, callback_table> self_;
+
+    template<class T>
+    SmallCallback(T t) : self_(callback_functions<T>::table(), std::move(t)) {}
+
+    int operator()(int x) const {
+        return self_.table()->call(self_.get(), x);
+    }
+};
+
+inline int run_once(const Callback& callback) {
+    std::cout << "is_abstract<AbstractCallback>: "
+              << std::is_abstract<AbstractCallback>::value
+              << '\n';
+    std::cout << "is_polymorphic<AbstractCallback>: "
+              << std::is_polymorphic<AbstractCallback>::value
+              << '\n';
+    std::cout << "is_member_function_pointer<&AbstractCallback::call>: "
+              << std::is_member_function_pointer<decltype(&AbstractCallback::call)>::value
+              << '\n';
+    std::cout << "is_copy_constructible<Callback>: "
+              << std::is_copy_constructible<Callback>::value
+              << '\n';
+    std::cout << "is_move_constructible<Callback>: "
+              << std::is_move_constructible<Callback>::value
+              << '\n';
+    std::cout << "is_reference<Callback&>: "
+              << std::is_reference<Callback&>::value
+              << '\n';
+
+    return callback(10);
+}
+// _________________________________________________________________________________________________________________
+
+/* #### Polymorphic types
+ * Runtime concept idiom allows polymorphism when needed, without inheritance. Polymorphic types are used like any
+ * other types, including built-in types. This code is as efficient as base class mechanism. I don't have to wrap
+ * integers, strings, ... into the objects.
+ * There is a piece of code within which I want to deal with a set of types that share a particular attribute (they
+ * might be drawable, ...). So I want to handle those objects as if they were the same. That's what we mean by
+ * polymorphic type.
+ */
+inline void draw(const std::string& x, std::ostream& out, size_t position) {
+    out << std::string(position, ' ') << x << std::endl;
+}
+
+inline void draw(const int& x, std::ostream& out, size_t position) {
+    out << std::string(position, ' ') << x << std::endl;
+}
+
+inline void draw(const Wild&, std::ostream& out, size_t position) {
+    out << std::string(position, ' ') << "Wild..." << std::endl;
+}
+
+class object_t {
+public:
+    object_t(std::string x) : self_(std::make_unique<string_model_t>(std::move(x))) {}
+    object_t(int x) : self_(std::make_unique<int_model_t>(std::move(x))) {}
+    object_t(Wild x) : self_(std::make_unique<wild_model_t>(std::move(x))) {}
+
+    object_t(const object_t& x) : self_(x.self_->copy_()) {}
+    object_t(object_t&&) noexcept = default;
+    object_t& operator=(const object_t& x) { // copy assignment operator
+        return *this = object_t(x);
+    }
+    object_t& operator=(object_t&&) noexcept = default; // move assignment operator
+
+    friend void draw(const object_t& x, std::ostream& out, size_t position) {
+        x.self_->draw_(out, position);
+    }
+
+private:
+    struct concept_t { // a base class for implementation goes here...
+        virtual ~concept_t() = default;
+        virtual std::unique_ptr<concept_t> copy_() const = 0; // virtual copy_ function...
+        virtual void draw_(std::ostream&, size_t) const = 0; // virtual draw_ function...
+    };
+    struct string_model_t final : concept_t {
+        string_model_t(std::string x) : data_(std::move(x)) {}
+        std::unique_ptr<concept_t> copy_() const override {
+            return std::make_unique<string_model_t>(*this);
+        }
+        void draw_(std::ostream& out, size_t position) const override {
+            draw(data_, out, position);
+        }
+        std::string data_;
+    };
+    struct int_model_t final : concept_t {
+        int_model_t(int x) : data_(std::move(x)) {}
+        std::unique_ptr<concept_t> copy_() const override {
+            return std::make_unique<int_model_t>(*this);
+        }
+        void draw_(std::ostream& out, size_t position) const override {
+            draw(data_, out, position);
+        }
+        int data_;
+    };
+    struct wild_model_t final : concept_t {
+        wild_model_t(Wild x) : data_(std::move(x)) {}
+        std::unique_ptr<concept_t> copy_() const override {
+            return std::make_unique<wild_model_t>(*this);
+        }
+        void draw_(std::ostream& out, size_t position) const override {
+            draw(data_, out, position);
+        }
+        Wild data_;
+    };
+
+    std::unique_ptr<concept_t> self_;
+};
+
+/* object_t with a manual vtable instead of concept_t, and the model inline instead of behind a unique_ptr: an int, a
+ * Wild and a std::string (32 bytes in libstdc++, its characters inline up to 15) need no allocation of their own.
+ */
+struct drawable_table {
+    lifetime_table lifetime;
+    void (*draw_)(const void* x, std::ostream& out, size_t position);
+};
+
+template<typename T>
+struct drawable_functions {
+    static void draw_(const void* x, std::ostream& out, size_t position) {
+        draw(*static_cast<const T*>(x), out, position);
+    }
+    static const drawable_table* table() {
+        static const drawable_table t = {lifetimeOf<T>(), &draw_};
+        return &t;
+    }
+};
+
+class small_object_t {
+public:
+    template<typename T>
+    small_object_t(T x) : self_(drawable_functions<T>::table(), std::move(x)) {}
+
+    friend void draw(const small_object_t& x, std::ostream& out, size_t position) {
+        x.self_.table()->draw_(x.self_.get(), out, position);
+    }
+
+private:
+    small_value<32, drawable_table> self_;
+};
+
+using document_t = std::vector<object_t>;
+using small_document_t = std::vector<small_object_t>;
+
+inline void draw(const document_t& x, std::ostream& out, size_t position) {
+    out << std::string(position, ' ') << "<document>" << std::endl;
+    for (const auto& e : x) draw(e, out, position);
+    out << std::string(position, ' ') << "</document>" << std::endl;
+}
+// _________________________________________________________________________________________________________________
+
+/* ##### Eli Bendersky - The cost of static (CRTP) dispatch in C++ (2013 Bendersky)
+ * CRTP can be used to achive static polymorphism which is an imitation of polymorphism in programming code.
+ */
+template<typename T>
+class Interface {
+public:
+    void tick(uint64_t n) {
+        impl().tick(n);
+    }
+    uint64_t getvalue() {
+        return impl().getvalue();
+    }
+    double calculate(double param) {
+        return impl().calculate(param);
+    }
+    /* to je ok...
+    double calculate(double param) {
+        return static_cast<T*>(this)->calculate(param);
+    } */
+
+private:
+    T& impl() {
+        return *static_cast<T*>(this);
+    }
+};
+
+class Implementation : public Interface<Implementation> {
+public:
+    Implementation() : counter(0) {}
+
+    void tick(uint64_t n) {
+        counter += n;
+    }
+    uint64_t getvalue() {
+        return counter;
+    }
+    double calculate(double param) {
+        return (param * param) / 2.5;
+    }
+
+private:
+    uint64_t counter;
+};
+// _________________________________________________________________________________________________________________
+
+/* ######
+ * Abstract base classes are classes that can only be used as base classes, and thus are allowed to have virtual
+ * member functions without definition (known as pure virtual functions).
+ */
+class BaseVirtual
+{
+public:
+    double interface(double param) {
+        return implementation(param);
+    }
+
+protected:
+    virtual double implementation(double param) const = 0; // pure virtual function
+};
+
+class DerivedVirtual : public BaseVirtual
+{
+protected:
+    double implementation(double param) const override {
+        return (param * param) / 2.5;
+    }
+};
+
+#endif // EXPERIMENTS_H
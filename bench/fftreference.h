@@ -0,0 +1,40 @@
+#ifndef FFTREFERENCE_H
+#define FFTREFERENCE_H
+
+#include <cmath>
+#include <complex>
+#include <vector>
+
+/* The recursive radix-2 Cooley-Tukey FFT that the widget used before the iterative engine, kept as the reference the
+ * checks of bench/main.cpp compare the engine with. It allocates at every level and computes its twiddles with exp(),
+ * which is slow but independent of the tables and the bit reversal of basic_fft_engine. N must be a power of two.
+ */
+inline std::vector<std::complex<double>> recursiveFft(std::vector<std::complex<double>> x) {
+    const double PI = 4 * std::atan(1.0);
+    size_t N = x.size();
+    if (N==1)
+        return x;
+
+    std::vector<std::complex<double>> xe(N/2,0), xo(N/2,0), Xjo, Xjo2;
+
+    // Construct arrays from even and odd indices
+    for (size_t i=0; i<N; i+=2)
+        xe[i/2] = x[i];
+    for (size_t i=1; i<N; i+=2)
+        xo[(i-1)/2] = x[i];
+
+    // Compute N/2-point FFT
+    Xjo = recursiveFft(xe);
+    Xjo2 = recursiveFft(xo);
+    Xjo.insert (Xjo.end(), Xjo2.begin(), Xjo2.end());
+
+    // Butterfly computations
+    for (size_t i=0; i<=N/2-1; i++) {
+        std::complex<double> t = Xjo[i], tw = std::polar(1.0, -2 * PI * double(i) / double(N));
+        Xjo[i] = t + tw * Xjo[i+N/2];
+        Xjo[i+N/2] = t - tw * Xjo[i+N/2];
+    }
+    return Xjo;
+}
+
+#endif // FFTREFERENCE_H
@@ -0,0 +1,1068 @@
+#include "benchmark.h"
+#include "experiments.h"
+#include "fftreference.h"
+
+#include "featurematrix.h"
+#include "fft.h"
+#include "function.h"
+#include "kernels.h"
+#include "mfccextractor.h"
+#include "segmentation.h"
+#include "similarity.h"
+#include "streamingsimilarity.h"
+#include "task.h"
+#include "wavfile.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <numeric>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+/* Benchmarks of the analysis and of the experiments that used to be timed once in main.cpp
+ * bench [--filter <text>] [--json <path>] [--runs <n>] [--warmup <n>] [--min-time <seconds>] [--no-checks]
+ * Before the timings, checks compare the optimized paths with their references (bitwise where the code promises it),
+ * so a regression in the results shows up next to one in the times; a failed check makes the exit status 1.
+ */
+
+namespace {
+
+// 10 s of 44.1 kHz mono: four tones that change every 2.5 s over a little noise, for the DSP stages. The tones cycle
+// through numTones notes of segmentSeconds each, scaled by level; the noise stays.
+std::vector<int16_t> testSignal(size_t fs = 44100, double seconds = 10, double segmentSeconds = 2.5, size_t numTones = 4,
+                                double level = 1) {
+    std::vector<int16_t> signal(size_t(fs * seconds));
+    const double PI = 4 * std::atan(1.0);
+    unsigned seed = 1;
+    for (size_t i=0; i<signal.size(); i++) {
+        const double t = double(i) / fs;
+        const double f0 = 220.0 * (1 + size_t(t / segmentSeconds) % numTones);
+        seed = seed * 1103515245 + 12345;
+        const double noise = double(int(seed >> 16) % 2001 - 1000) / 1000.0;
+        const double x = level * (0.4 * std::sin(2*PI*f0*t) + 0.2 * std::sin(2*PI*2.01*f0*t) +
+                                  0.1 * std::sin(2*PI*3.02*f0*t)) + 0.02 * noise;
+        signal[i] = int16_t(std::lround(x * 32767));
+    }
+    return signal;
+}
+
+// n frames of dim random features in [-10, 10]
+feature_matrix<double> randomFeatures(size_t n, size_t dim) {
+    feature_matrix<double> features(n, dim);
+    unsigned seed = 1;
+    for (size_t i=0; i<n; i++)
+        for (size_t k=0; k<dim; k++) {
+            seed = seed * 1103515245 + 12345;
+            features.at(i, k) = double(int(seed >> 16) % 2001 - 1000) / 100.0;
+        }
+    return features;
+}
+
+// The per-pair lambda of the original widget: two vector copies and three dot products per cell
+void lambdaSimilarity(const std::vector<std::vector<double>>& vecdmfcc, similarity_matrix<double>& out) {
+    const size_t n = vecdmfcc.size();
+    std::vector<double> veca, vecb;
+    for (size_t j=0; j<n; j++) {
+        veca = vecdmfcc[j];
+        for (size_t i=j; i<n; i++) {
+            vecb = vecdmfcc[i];
+            out.at(j, i) = 1 - [&veca, &vecb](){
+                double multiply = 0.0;
+                double d_a = 0.0;
+                double d_b = 0.0;
+                for (size_t k=0; k<veca.size(); k++) {
+                    multiply += veca[k] * vecb[k];
+                    d_a += veca[k] * veca[k];
+                    d_b += vecb[k] * vecb[k];
+                }
+                return multiply / (std::sqrt(d_a) * std::sqrt(d_b));
+            }();
+        }
+    }
+}
+
+std::vector<std::vector<double>> toVectors(const feature_matrix<double>& features) {
+    std::vector<std::vector<double>> vectors(features.rows());
+    for (size_t i=0; i<features.rows(); i++)
+        vectors[i].assign(features.row(i), features.row(i) + features.cols());
+    return vectors;
+}
+
+// MFCCs of the whole signal pushed frame by frame, the streaming path
+template<typename T>
+void pushFrames(mfcc_extractor<T>& extractor, const std::vector<int16_t>& signal,
+                feature_matrix<typename mfcc_extractor<T>::real_type>& out) {
+    typedef typename mfcc_extractor<T>::real_type R;
+    extractor.reset();
+    out.reset(extractor.numCoefficients());
+    out.reserve(extractor.pendingFrames(signal.size()));
+    extractor.push(signal.data(), signal.size(), [&out](size_t, const R* coef) { out.appendRow(coef); });
+}
+
+template<typename T>
+bool sameBits(const T* a, const T* b, size_t n) {
+    return std::memcmp(a, b, n * sizeof(T)) == 0;
+}
+
+bool report(const std::string& name, bool ok, const std::string& detail = std::string()) {
+    std::cout << "check " << name << ": " << (ok ? "ok" : "FAILED") << (detail.empty() ? "" : ", ") << detail
+              << std::endl;
+    return ok;
+}
+
+// _____________________________________________________________________________________________________________________
+
+template<typename T>
+bool checkExtraction(const char* type, const std::vector<int16_t>& signal) {
+    typedef typename mfcc_extractor<T>::real_type R;
+    mfcc_extractor<T> extractor((mfcc_config()));
+    feature_matrix<R> serial(0, 0), parallel;
+    pushFrames(extractor, signal, serial);
+    extractor.extract(signal.data(), signal.size(), parallel, default_task_system());
+    const bool ok = serial.rows() == parallel.rows() &&
+                    sameBits(serial.data(), parallel.data(), serial.rows() * serial.cols());
+    return report(std::string("mfcc/") + type + " parallel extract identical to push", ok);
+}
+
+// Values of the FFT types as complex doubles, fixed-point ones scaled back by 2^shifts
+template<typename T>
+std::complex<double> toComplex(const std::complex<T>& x, int) {
+    return std::complex<double>(x);
+}
+
+template<typename Q>
+std::complex<double> toComplex(const fixed_complex<Q>& x, int shifts) {
+    return std::complex<double>(std::ldexp(double(x.re), shifts - Q::fracBits),
+                                std::ldexp(double(x.im), shifts - Q::fracBits));
+}
+
+template<typename T>
+typename fft_types<T>::complex_type fromComplex(std::complex<double> x, std::complex<T>*) {
+    return typename fft_types<T>::complex_type(T(x.real()), T(x.imag()));
+}
+
+template<typename Q>
+fixed_complex<Q> fromComplex(std::complex<double> x, fixed_complex<Q>*) {
+    return {toFixed<Q>(x.real()), toFixed<Q>(x.imag())};
+}
+
+template<typename T>
+typename fft_types<T>::sample_type fromReal(double x, std::true_type) {
+    return typename fft_types<T>::sample_type(x);
+}
+
+template<typename T>
+typename fft_types<T>::sample_type fromReal(double x, std::false_type) {
+    return toFixed<T>(x);
+}
+
+template<typename T>
+double toReal(typename fft_types<T>::sample_type x, std::true_type) {
+    return double(x);
+}
+
+template<typename T>
+double toReal(typename fft_types<T>::sample_type x, std::false_type) {
+    return std::ldexp(double(x), -T::fracBits);
+}
+
+/* The complex and real transforms of every size from 2 to 8192 against the recursive FFT, on random input that the
+ * fixed-point types can represent (complex values below 1, real samples below 1/sqrt(2)). The error is the largest
+ * difference of a bin relative to the largest bin of the reference, about the rounding of the type times log2(N).
+ */
+template<typename T>
+bool checkFft(const char* type, double tolerance) {
+    typedef typename fft_types<T>::complex_type complex_type;
+    typedef typename fft_types<T>::sample_type sample_type;
+    typedef typename std::is_floating_point<T>::type isFloat;
+    unsigned seed = 1;
+    auto random = [&seed]() {
+        seed = seed * 1103515245 + 12345;
+        return double(int(seed >> 16) % 2001 - 1000) / 1000.0;
+    };
+    auto relativeError = [](const std::vector<std::complex<double>>& reference,
+                            const std::vector<std::complex<double>>& x) {
+        double maxError = 0, maxBin = 0;
+        for (size_t k=0; k<x.size(); k++) {
+            maxError = std::max(maxError, std::abs(x[k] - reference[k]));
+            maxBin = std::max(maxBin, std::abs(reference[k]));
+        }
+        return maxBin > 0 ? maxError / maxBin : maxError;
+    };
+
+    double complexError = 0, realError = 0;
+    for (size_t N=2; N<=8192; N*=2) {
+        std::vector<std::complex<double>> input(N);
+        std::vector<complex_type> x(N);
+        for (size_t i=0; i<N; i++) {
+            input[i] = std::complex<double>(0.7 * random(), 0.7 * random());
+            x[i] = fromComplex(input[i], static_cast<complex_type*>(nullptr));
+            input[i] = toComplex(x[i], 0);  // the reference sees the input as rounded to the type
+        }
+        basic_fft_engine<T> engine(N);
+        const int shifts = engine.transform(x.data());
+        std::vector<std::complex<double>> result(N);
+        for (size_t k=0; k<N; k++)
+            result[k] = toComplex(x[k], shifts);
+        complexError = std::max(complexError, relativeError(recursiveFft(input), result));
+
+        std::vector<sample_type> samples(N);
+        for (size_t i=0; i<N; i++) {
+            samples[i] = fromReal<T>(0.5 * random(), isFloat());
+            input[i] = toReal<T>(samples[i], isFloat());
+        }
+        basic_real_fft<T> real(N);
+        std::vector<complex_type> bins(N / 2 + 1);
+        const int realShifts = real.transform(samples.data(), bins.data());
+        std::vector<std::complex<double>> reference = recursiveFft(input), realResult(N / 2 + 1);
+        reference.resize(N / 2 + 1);
+        for (size_t k=0; k<=N/2; k++)
+            realResult[k] = toComplex(bins[k], realShifts);
+        realError = std::max(realError, relativeError(reference, realResult));
+    }
+    char detail[96];
+    std::snprintf(detail, sizeof(detail), "max relative error complex %.2e, real %.2e", complexError, realError);
+    return report(std::string("fft/") + type + " against recursive FFT, N = 2..8192",
+                  complexError < tolerance && realError < tolerance, detail);
+}
+
+/* Foote novelty evaluated cell by cell: every cell of the kernel around c weighted by the taper at the border of the
+ * smallest box that holds it, positive across the centre and negative within, the kernel clipped to the matrix
+ */
+template<typename M>
+std::vector<double> cellNovelty(const M& ssm, const novelty_config& config) {
+    const long n = long(ssm.size());
+    const long K = long(std::max<size_t>(1, config.kernelHalfWidth));
+    const double sigma = config.taperSigma * K;
+    auto taper = [sigma](double r) { return std::exp(-r * r / (2 * sigma * sigma)); };
+    double total = 0;
+    for (long k=1; k<=K; k++)
+        total += (taper(k - 0.5) - (k < K ? taper(k + 0.5) : 0.0)) * 2 * k * k;
+
+    std::vector<double> novelty(size_t(n), 0.0);
+    for (long c=0; c<n; c++) {
+        double value = 0;
+        for (long a=-K; a<K; a++)
+            for (long b=-K; b<K; b++) {
+                const long i = c + a, j = c + b;
+                if (i < 0 || j < 0 || i >= n || j >= n || i == j)
+                    continue;
+                const long box = std::max(a < 0 ? -a : a + 1, b < 0 ? -b : b + 1);
+                const double d = ssm.at(size_t(std::min(i, j)), size_t(std::max(i, j)));
+                value += ((a < 0) != (b < 0) ? 1 : -1) * taper(box - 0.5) * d;
+            }
+        novelty[size_t(c)] = value / total;
+    }
+    return novelty;
+}
+
+bool checkNovelty(const char* name, const std::vector<double>& novelty, const std::vector<double>& reference) {
+    double maxDiff = novelty.size() == reference.size() ? 0 : HUGE_VAL;
+    for (size_t i=0; i<novelty.size() && i<reference.size(); i++)
+        maxDiff = std::max(maxDiff, std::abs(novelty[i] - reference[i]));
+    char detail[48];
+    std::snprintf(detail, sizeof(detail), "max difference %.2e", maxDiff);
+    return report(std::string(name) + " against the kernel cell by cell", maxDiff < 1e-12, detail);
+}
+
+// Boundaries of three tones that change every 2 s, quiet and loud: within two frames of 2, 4, 6, 8 and 10 s
+bool checkSegments(double level) {
+    const mfcc_config config;
+    const std::vector<int16_t> signal = testSignal(config.fs, 12, 2, 3, level);
+    mfcc_extractor<double> extractor(config);
+    feature_matrix<double> features;
+    extractor.extract(signal.data(), signal.size(), features, default_task_system());
+    similarity_engine<double> engine;
+    similarity_matrix<double> ssm;
+    engine.compute(features, ssm);
+    foote_segmenter<double> segmenter;
+    std::vector<size_t> boundaries;
+    segmenter.segment(ssm, boundaries);
+
+    const double hop = double(extractor.frameShiftLength()) / config.fs;
+    bool ok = boundaries.size() == 5;
+    std::ostringstream detail;
+    detail << "boundaries (s):";
+    for (size_t b=0; b<boundaries.size(); b++) {
+        ok &= std::abs(boundaries[b] * hop - 2.0 * (b + 1)) <= 2 * hop;
+        detail << " " << boundaries[b] * hop;
+    }
+    return report("segments of tones at level " + std::to_string(level).substr(0, 3), ok, detail.str());
+}
+
+/* The streaming similarity against brute force over the whole stream, with a history of more than 2K frames that the
+ * ring wraps around many times: the rows against the cosine distances of the kept frames, and the novelty against the
+ * window sums of the full matrix of distances, with the steps of the kernel built as in init()
+ */
+template<typename T>
+bool checkStreaming(const char* type, double tolerance) {
+    novelty_config config;
+    config.kernelHalfWidth = 16;
+    config.history = 80;
+    config.peakRadius = 8;
+    const size_t n = 600, dim = 13;
+    const feature_matrix<double> features = randomFeatures(n, dim);
+    std::vector<T> frame(dim);
+
+    // Distances of all pairs, in double
+    std::vector<double> norms(n);
+    for (size_t i=0; i<n; i++)
+        norms[i] = std::sqrt(std::inner_product(features.row(i), features.row(i) + dim, features.row(i), 0.0));
+    auto D = [&features, &norms, dim](size_t i, size_t j) {
+        return 1 - std::inner_product(features.row(i), features.row(i) + dim, features.row(j), 0.0) / (norms[i] * norms[j]);
+    };
+
+    streaming_similarity<T> live;
+    live.init(dim, config);
+    std::vector<double> novelty(n, 0.0);
+    std::vector<bool> boundaries(n, false);
+    auto sink = [&novelty, &boundaries](uint64_t c, double value, bool boundary) {
+        novelty[c] = value;
+        boundaries[c] = boundary;
+    };
+    double rowDiff = 0;
+    for (size_t t=0; t<n; t++) {
+        std::copy(features.row(t), features.row(t) + dim, frame.begin());
+        live.push(frame.data(), sink);
+        for (size_t l=1; l<=live.history() && l<=t; l++)
+            rowDiff = std::max(rowDiff, std::abs(double(live.row(t)[l - 1]) - D(t, t - l)));
+    }
+    live.finish(sink);
+
+    // Q(s,e), the sum of D over [s,e) x [s,e) clipped to the stream, and the kernel as a sum of nested boxes
+    auto Q = [&D](long s, long e) {
+        double sum = 0;
+        for (long i=std::max(0L, s); i<e; i++)
+            for (long j=std::max(0L, s); j<e; j++)
+                sum += i == j ? 0.0 : D(size_t(i), size_t(j));
+        return sum;
+    };
+    const long K = long(config.kernelHalfWidth), steps = long(std::min<size_t>(config.kernelSteps, config.kernelHalfWidth));
+    const double sigma = config.taperSigma * K;
+    auto taper = [sigma](double r) { return std::exp(-r * r / (2 * sigma * sigma)); };
+    std::vector<long> widths;
+    std::vector<double> weights;
+    long previous = 0;
+    double total = 0;
+    for (long m=1; m<=steps; m++) {
+        const long k = (K * m + steps - 1) / steps, next = (K * (m + 1) + steps - 1) / steps;
+        widths.push_back(k);
+        weights.push_back(taper(0.5 * (previous + k)) - (m < steps ? taper(0.5 * (k + next)) : 0.0));
+        total += weights.back() * 2 * k * k;
+        previous = k;
+    }
+
+    double noveltyDiff = 0;
+    size_t mismatches = 0;
+    std::vector<double> reference(n, 0.0);
+    for (long c=0; c+K<=long(n); c++) {
+        for (size_t m=0; m<widths.size(); m++) {
+            const long k = widths[m];
+            reference[size_t(c)] += weights[m] / total * (Q(c - k, c + k) - 2 * Q(c - k, c) - 2 * Q(c, c + k));
+        }
+        noveltyDiff = std::max(noveltyDiff, std::abs(novelty[size_t(c)] - reference[size_t(c)]));
+    }
+    for (size_t c=0; c<n; c++) {
+        bool peak = reference[c] >= config.threshold;
+        for (size_t i=c > config.peakRadius ? c - config.peakRadius : 0; i<c && peak; i++)
+            peak = reference[i] < reference[c];
+        for (size_t i=c+1; i<=c+config.peakRadius && i<n && peak; i++)
+            peak = reference[i] <= reference[c];
+        mismatches += peak != boundaries[c];
+    }
+
+    char detail[96];
+    std::snprintf(detail, sizeof(detail), "max difference rows %.2e, novelty %.2e, %zu boundaries differ", rowDiff,
+                  noveltyDiff, mismatches);
+    return report(std::string("streaming similarity/") + type + " against brute force, history 5K", rowDiff < tolerance &&
+                  noveltyDiff < tolerance && mismatches == 0, detail);
+}
+
+// WAV images assembled chunk by chunk in memory, for the checks of the RIFF parser
+void appendLE(std::vector<uint8_t>& out, uint64_t value, int bytes) {
+    for (int i=0; i<bytes; i++)
+        out.push_back(uint8_t(value >> (8 * i)));
+}
+
+void appendChunk(std::vector<uint8_t>& out, const char* id, const std::vector<uint8_t>& body, uint32_t size) {
+    out.insert(out.end(), id, id + 4);
+    appendLE(out, size, 4);
+    out.insert(out.end(), body.begin(), body.end());
+    if (body.size() & 1)
+        out.push_back(0);
+}
+
+void appendChunk(std::vector<uint8_t>& out, const char* id, const std::vector<uint8_t>& body) {
+    appendChunk(out, id, body, uint32_t(body.size()));
+}
+
+std::vector<uint8_t> riffHeader(const char* id = "RIFF", uint32_t size = 0) {
+    std::vector<uint8_t> out(id, id + 4);
+    appendLE(out, size, 4);
+    out.insert(out.end(), {'W', 'A', 'V', 'E'});
+    return out;
+}
+
+// 16-bit PCM at 44.1 kHz, plain or WAVE_FORMAT_EXTENSIBLE with 12 valid bits and the front speakers
+std::vector<uint8_t> pcmFormat(uint16_t channels, bool extensible = false) {
+    std::vector<uint8_t> body;
+    appendLE(body, extensible ? 0xFFFE : 1, 2);
+    appendLE(body, channels, 2);
+    appendLE(body, 44100, 4);
+    appendLE(body, 44100 * 2 * channels, 4);
+    appendLE(body, 2 * channels, 2);
+    appendLE(body, 16, 2);
+    if (extensible) {
+        appendLE(body, 22, 2);
+        appendLE(body, 12, 2);
+        appendLE(body, 3, 4);
+        const uint8_t pcmGuid[16] = {1, 0, 0, 0, 0, 0, 0x10, 0, 0x80, 0, 0, 0xAA, 0, 0x38, 0x9B, 0x71};
+        body.insert(body.end(), pcmGuid, pcmGuid + 16);
+    }
+    return body;
+}
+
+// The wav_file parser on images with the layouts found in the wild, and on broken ones
+bool checkWavParser() {
+    std::vector<uint8_t> audio;
+    for (int i=0; i<100; i++)
+        appendLE(audio, uint16_t(i * 300 - 15000), 2);
+    auto samplesAre = [&audio](const wav_file& wav) {
+        const sample_span<int16_t> samples = wav.samples();
+        return samples.size * 2 == audio.size() && std::memcmp(samples.data, audio.data(), audio.size()) == 0;
+    };
+    bool ok = true;
+    wav_file wav;
+
+    // LIST with an odd size, padded, and fact before fmt
+    std::vector<uint8_t> image = riffHeader();
+    appendChunk(image, "LIST", {'I', 'N', 'F', 'O', 'x'});
+    appendChunk(image, "fact", {100, 0, 0, 0});
+    appendChunk(image, "fmt ", pcmFormat(1));
+    appendChunk(image, "data", audio);
+    ok &= report("wav/LIST, fact and an odd chunk before fmt", wav.parse(image.data(), image.size()) == 0 &&
+                 wav.isPcm16() && wav.format().numChannels == 1 && samplesAre(wav));
+
+    image = riffHeader();
+    appendChunk(image, "data", audio);
+    appendChunk(image, "fmt ", pcmFormat(1));
+    ok &= report("wav/data before fmt", wav.parse(image.data(), image.size()) == 0 && wav.isPcm16() && samplesAre(wav));
+
+    image = riffHeader();
+    appendChunk(image, "fmt ", pcmFormat(2, true));
+    appendChunk(image, "data", audio);
+    ok &= report("wav/WAVE_FORMAT_EXTENSIBLE", wav.parse(image.data(), image.size()) == 0 && wav.isPcm16() &&
+                 wav.format().extensible && wav.format().validBitsPerSample == 12 && wav.format().channelMask == 3 &&
+                 wav.numFrames() == 50 && samplesAre(wav));
+
+    // RF64: the RIFF and data sizes are 0xFFFFFFFF, the real ones in ds64
+    std::vector<uint8_t> ds64;
+    appendLE(ds64, 0, 8);
+    appendLE(ds64, audio.size(), 8);
+    appendLE(ds64, audio.size() / 2, 8);
+    appendLE(ds64, 0, 4);
+    image = riffHeader("RF64", 0xFFFFFFFF);
+    appendChunk(image, "ds64", ds64);
+    appendChunk(image, "fmt ", pcmFormat(1));
+    appendChunk(image, "data", audio, 0xFFFFFFFF);
+    ok &= report("wav/RF64 with ds64", wav.parse(image.data(), image.size()) == 0 && wav.isRF64() &&
+                 wav.dataSize() == audio.size() && samplesAre(wav));
+
+    // A recording cut off after 40 of 100 samples: the data is clamped to the bytes there
+    image = riffHeader();
+    appendChunk(image, "fmt ", pcmFormat(1));
+    appendChunk(image, "data", audio);
+    image.resize(image.size() - 120);
+    ok &= report("wav/truncated data", wav.parse(image.data(), image.size()) == 0 && wav.dataSize() == 80 &&
+                 wav.samples().size == 40 && std::memcmp(wav.samples().data, audio.data(), 80) == 0);
+
+    // Broken files fail; the reason the parser prints is taken into the report
+    auto fails = [&wav](const std::vector<uint8_t>& broken, std::string& reason) {
+        std::ostringstream messages;
+        std::streambuf* console = std::cout.rdbuf(messages.rdbuf());
+        const bool failed = wav.parse(broken.data(), broken.size()) != 0;
+        std::cout.rdbuf(console);
+        reason = messages.str().substr(0, messages.str().find('\n'));
+        return failed;
+    };
+    std::string reason;
+    image = riffHeader();
+    appendChunk(image, "data", audio);
+    bool failed = fails(image, reason);
+    ok &= report("wav/missing fmt fails", failed, reason);
+    image = riffHeader();
+    appendChunk(image, "fmt ", pcmFormat(1));
+    appendChunk(image, "LIST", {'I', 'N', 'F', 'O'});
+    failed = fails(image, reason);
+    ok &= report("wav/missing data fails", failed, reason);
+    return ok;
+}
+
+bool runChecks(const std::vector<int16_t>& signal) {
+    bool ok = true;
+
+    ok &= checkFft<double>("double", 1e-13);
+    ok &= checkFft<float>("float", 2e-6);
+    ok &= checkFft<q31>("q31", 1e-6);
+    ok &= checkFft<q15>("q15", 1e-2);
+
+    // the blocked engine against the per-pair lambda, and the tiles on the pool against the serial engine
+    const feature_matrix<double> features = randomFeatures(1000, 13);
+    similarity_matrix<double> reference(features.rows());
+    lambdaSimilarity(toVectors(features), reference);
+    for (const char* name : {"scalar", "sse2", "avx2", "neon"}) {
+        const dsp_kernels* simd = findKernels<double>(name);
+        if (!simd)
+            continue;
+        similarity_engine<double> engine(*simd);
+        similarity_matrix<double> ssm;
+        engine.compute(features, ssm);
+        double maxDiff = 0;
+        for (size_t i=0; i<ssm.storageSize(); i++)
+            maxDiff = std::max(maxDiff, std::abs(ssm.data()[i] - reference.data()[i]));
+        char detail[48];
+        std::snprintf(detail, sizeof(detail), "max difference %.2e", maxDiff);
+        ok &= report(std::string("similarity/") + name + " against lambda", maxDiff < 1e-12, detail);
+    }
+    similarity_engine<double> engine;
+    similarity_matrix<double> serial, parallel;
+    engine.compute(features, serial);
+    engine.compute(features, parallel, default_task_system());
+    ok &= report("similarity parallel identical to serial",
+                 sameBits(serial.data(), parallel.data(), serial.storageSize()));
+
+    // the O(N*K) novelty of the segmenter, full and banded, and the boundaries it finds
+    novelty_config config;
+    config.kernelHalfWidth = 24;
+    foote_segmenter<double> segmenter(config);
+    const feature_matrix<double> noveltyFeatures = randomFeatures(300, 13);
+    similarity_matrix<double> full;
+    banded_similarity_matrix<double> banded;
+    engine.compute(noveltyFeatures, full);
+    engine.compute(noveltyFeatures, segmenter.minimumLag(), banded);
+    std::vector<double> novelty;
+    segmenter.novelty(full, novelty);
+    ok &= checkNovelty("novelty", novelty, cellNovelty(full, config));
+    segmenter.novelty(banded, novelty);
+    ok &= checkNovelty("banded novelty", novelty, cellNovelty(banded, config));
+    ok &= checkSegments(0.1);
+    ok &= checkSegments(1.0);
+    ok &= checkStreaming<double>("double", 1e-12);
+    ok &= checkStreaming<float>("float", 1e-5);
+
+    ok &= checkWavParser();
+
+    ok &= checkExtraction<double>("double", signal);
+    ok &= checkExtraction<float>("float", signal);
+    ok &= checkExtraction<q15>("q15", signal);
+    ok &= checkExtraction<q31>("q31", signal);
+
+    // every variant of a type erasure design computes and draws the same
+    Object object((Wild()));
+    SmallObject smallObject((Wild()));
+    ObjectVector objects;
+    objects.push_back(Wild());
+    ok &= report("Object variants agree", object.getName() == smallObject.getName() &&
+                 object.getName() == objects.getName(0) && object.implementation(10.6) == smallObject.implementation(10.6) &&
+                 object.implementation(10.6) == objects.implementation(0, 10.6));
+    Callback callback([](int x){ return x + 1; });
+    SmallCallback smallCallback([](int x){ return x + 1; });
+    ok &= report("Callback variants agree", callback(10) == smallCallback(10));
+
+    document_t document;
+    small_document_t smallDocument;
+    document.emplace_back(0);
+    document.emplace_back(std::string("Hello!"));
+    document.emplace_back(2);
+    document.emplace_back(Wild());
+    smallDocument.emplace_back(0);
+    smallDocument.emplace_back(std::string("Hello!"));
+    smallDocument.emplace_back(2);
+    smallDocument.emplace_back(Wild());
+    std::ostringstream drawn, smallDrawn;
+    for (const auto& e : document) draw(e, drawn, 0);
+    for (const auto& e : smallDocument) draw(e, smallDrawn, 0);
+    ok &= report("object_t variants draw the same", drawn.str() == smallDrawn.str());
+    return ok;
+}
+
+// _____________________________________________________________________________________________________________________
+
+// 10000 objects made into a vector, then called: shared_ptr models, inline models, one contiguous buffer
+void benchmarkTypeErasure(benchmark_runner& runner) {
+    const size_t count = 10000;
+    runner.run("type erasure/make/Object", count, [count]() {
+        std::vector<Object> vec; // instances of type Object
+        for (size_t i=0; i<count; ++i)
+            vec.emplace_back(Object(Wild()));
+        doNotOptimize(vec);
+    });
+    runner.run("type erasure/make/SmallObject", count, [count]() {
+        std::vector<SmallObject> vec;
+        for (size_t i=0; i<count; ++i)
+            vec.emplace_back(SmallObject(Wild()));
+        doNotOptimize(vec);
+    });
+    runner.run("type erasure/make/poly_vector", count, [count]() {
+        ObjectVector vec;
+        for (size_t i=0; i<count; ++i)
+            vec.push_back(Wild());
+        doNotOptimize(vec);
+    });
+
+    // a mix of the three models, so the calls cannot be predicted from the first one
+    std::vector<Object> objects;
+    std::vector<SmallObject> smallObjects;
+    ObjectVector polyObjects;
+    for (size_t i=0; i<count; ++i) {
+        switch (i % 3) {
+        case 0: objects.emplace_back(Wild()); smallObjects.emplace_back(Wild()); polyObjects.push_back(Wild()); break;
+        case 1: objects.emplace_back(Running()); smallObjects.emplace_back(Running()); polyObjects.push_back(Running()); break;
+        default: objects.emplace_back(Homeless()); smallObjects.emplace_back(Homeless()); polyObjects.push_back(Homeless());
+        }
+    }
+    runner.run("type erasure/call/Object", count, [&objects]() {
+        double param = 10.6, sum = 0;
+        doNotOptimize(param);
+        for (const auto& v : objects) sum += v.implementation(param);
+        doNotOptimize(sum);
+    });
+    runner.run("type erasure/call/SmallObject", count, [&smallObjects]() {
+        double param = 10.6, sum = 0;
+        doNotOptimize(param);
+        for (const auto& v : smallObjects) sum += v.implementation(param);
+        doNotOptimize(sum);
+    });
+    runner.run("type erasure/call/poly_vector", count, [&polyObjects]() {
+        double param = 10.6, sum = 0;
+        doNotOptimize(param);
+        for (size_t i=0; i<polyObjects.size(); ++i) sum += polyObjects.implementation(i, param);
+        doNotOptimize(sum);
+    });
+
+    // a callback made and called, on the heap and inline, and a std::function of the same lambda
+    int offset = 3;
+    int k = 0;
+    runner.run("type erasure/callback/Callback", [&offset, &k]() {
+        Callback callback([&offset, k](int x){ return x + offset + k; });
+        int result = callback(1);
+        doNotOptimize(result);
+        ++k;
+    });
+    runner.run("type erasure/callback/SmallCallback", [&offset, &k]() {
+        SmallCallback callback([&offset, k](int x){ return x + offset + k; });
+        int result = callback(1);
+        doNotOptimize(result);
+        ++k;
+    });
+    runner.run("type erasure/callback/std::function", [&offset, &k]() {
+        std::function<int(int)> callback([&offset, k](int x){ return x + offset + k; });
+        int result = callback(1);
+        doNotOptimize(result);
+        ++k;
+    });
+
+    // the document of the polymorphic types reversed in place and copied
+    document_t document;
+    small_document_t smallDocument;
+    document.reserve(10);
+    document.emplace_back(0);
+    document.emplace_back(std::string("Hello!"));
+    document.emplace_back(2);
+    document.emplace_back(Wild()); // creates a temporary object...
+    smallDocument.reserve(10);
+    smallDocument.emplace_back(0);
+    smallDocument.emplace_back(std::string("Hello!"));
+    smallDocument.emplace_back(2);
+    smallDocument.emplace_back(Wild());
+    runner.run("type erasure/document reverse/object_t", [&document]() {
+        std::reverse(document.begin(), document.end());
+        doNotOptimize(document);
+    });
+    runner.run("type erasure/document reverse/small_object_t", [&smallDocument]() {
+        std::reverse(smallDocument.begin(), smallDocument.end());
+        doNotOptimize(smallDocument);
+    });
+    runner.run("type erasure/document copy/object_t", [&document]() {
+        document_t copy(document);
+        doNotOptimize(copy);
+    });
+    runner.run("type erasure/document copy/small_object_t", [&smallDocument]() {
+        small_document_t copy(smallDocument);
+        doNotOptimize(copy);
+    });
+}
+
+/* (param * param) / 2.5 added up inline, through CRTP and through a virtual call. The parameter passes through
+ * doNotOptimize, so the loops cannot be folded into a constant, and the pointer to the virtual object does too, so the
+ * call cannot be devirtualized. The additions depend on each other, as in the original loops.
+ */
+void benchmarkDispatch(benchmark_runner& runner) {
+    const size_t count = 1000;
+    runner.run("dispatch/inline", count, [count]() {
+        double param = 10.6, val = 0.0;
+        doNotOptimize(param);
+        for (size_t i=0; i<count; ++i)
+            val += param * param / 2.5;
+        doNotOptimize(val);
+    });
+
+    Implementation implementation;
+    Interface<Implementation>* object = &implementation;
+    runner.run("dispatch/CRTP", count, [count, object]() {
+        double param = 10.6, val = 0.0;
+        doNotOptimize(param);
+        for (size_t i=0; i<count; ++i)
+            val += object->calculate(param);
+        doNotOptimize(val);
+    });
+
+    std::unique_ptr<BaseVirtual> derived = std::make_unique<DerivedVirtual>();
+    BaseVirtual* baseVirtual = derived.get();
+    runner.run("dispatch/virtual", count, [count, &baseVirtual]() {
+        double param = 10.6, val = 0.0;
+        doNotOptimize(param);
+        doNotOptimize(baseVirtual);
+        for (size_t i=0; i<count; ++i)
+            val += baseVirtual->interface(param);
+        doNotOptimize(val);
+    });
+}
+
+// _____________________________________________________________________________________________________________________
+
+// The kernels of every kernel set the CPU supports, on frames of the default configuration
+template<typename T>
+void benchmarkKernels(benchmark_runner& runner, const char* type) {
+    const mfcc_config cfg;
+    const size_t L = cfg.fs * cfg.winWidth / 1000, bins = cfg.numFFT / 2 + 1, cepstra = cfg.numCepstral + 1;
+    std::vector<T> x(L), win(L), frame(L), power(bins), dct(cepstra * cfg.numFilters), lmfb(cfg.numFilters), mfcc(cepstra);
+    std::vector<std::complex<T>> spectrum(bins);
+    for (size_t i=0; i<L; i++) {
+        x[i] = T(std::sin(0.01 * i));
+        win[i] = T(0.54 - 0.46 * std::cos(0.001 * i));
+    }
+    for (size_t i=0; i<bins; i++)
+        spectrum[i] = std::complex<T>(T(std::cos(0.1 * i)), T(std::sin(0.3 * i)));
+    for (size_t i=0; i<dct.size(); i++)
+        dct[i] = T(std::cos(0.07 * i));
+    for (size_t i=0; i<lmfb.size(); i++)
+        lmfb[i] = T(i % 7);
+
+    for (const char* name : {"scalar", "sse2", "avx2", "neon"}) {
+        const basic_dsp_kernels<T>* simd = findKernels<T>(name);
+        if (!simd)
+            continue;
+        const std::string prefix = std::string("kernels/") + type + "/" + name + "/";
+        runner.run(prefix + "preEmphWindow", [&]() {
+            simd->preEmphWindow(x.data(), win.data(), T(0.97), frame.data(), L);
+            clobberMemory();
+        });
+        runner.run(prefix + "powerSpectrum", [&]() {
+            simd->powerSpectrum(spectrum.data(), power.data(), bins);
+            clobberMemory();
+        });
+        runner.run(prefix + "matVec (DCT)", [&]() {
+            simd->matVec(dct.data(), lmfb.data(), mfcc.data(), cepstra, cfg.numFilters);
+            clobberMemory();
+        });
+    }
+}
+
+// One stage or the whole frame of the pipeline of type T, frames taken in turn from the signal
+template<typename T>
+void benchmarkFrame(benchmark_runner& runner, const char* type, const std::vector<int16_t>& signal) {
+    typedef typename fft_types<T>::sample_type sample_type;
+    typedef typename fft_types<T>::complex_type complex_type;
+    const mfcc_config cfg;
+
+    basic_real_fft<T> fft(cfg.numFFT);
+    std::vector<sample_type> in(cfg.numFFT);
+    for (size_t i=0; i<in.size(); i++)
+        in[i] = sample_type(signal[i]);
+    std::vector<complex_type> out(cfg.numFFT / 2 + 1);
+    runner.run(std::string("fft/real ") + std::to_string(cfg.numFFT) + "/" + type, [&]() {
+        int shifts = fft.transform(in.data(), out.data());
+        doNotOptimize(shifts);
+        clobberMemory();
+    });
+
+    mfcc_pipeline<T> pipeline(cfg);
+    std::vector<typename mfcc_pipeline<T>::real_type> mfcc(pipeline.numCoefficients());
+    const size_t frames = (signal.size() - pipeline.frameLength()) / pipeline.frameShiftLength() + 1;
+    size_t k = 0;
+    runner.run(std::string("mfcc/frame/") + type, [&]() {
+        pipeline.compute(signal.data() + k * pipeline.frameShiftLength(), mfcc.data());
+        clobberMemory();
+        k = k + 1 < frames ? k + 1 : 0;
+    });
+}
+
+// The MFCCs of the whole signal, streamed and extracted on the pool; the time is per frame
+template<typename T>
+void benchmarkExtraction(benchmark_runner& runner, const char* type, const std::vector<int16_t>& signal,
+                         const benchmark_config& config) {
+    typedef typename mfcc_extractor<T>::real_type R;
+    mfcc_extractor<T> extractor((mfcc_config()));
+    feature_matrix<R> features(0, 0);
+    const size_t frames = extractor.pendingFrames(signal.size());
+    runner.run(std::string("mfcc/file/") + type + "/push", frames, config, [&]() {
+        pushFrames(extractor, signal, features);
+        clobberMemory();
+    });
+    runner.run(std::string("mfcc/file/") + type + "/extract, " + std::to_string(default_task_system().size()) +
+               " threads", frames, config, [&]() {
+        extractor.extract(signal.data(), signal.size(), features, default_task_system());
+        clobberMemory();
+    });
+}
+
+void benchmarkDsp(benchmark_runner& runner, const std::vector<int16_t>& signal) {
+    benchmarkKernels<double>(runner, "double");
+    benchmarkKernels<float>(runner, "float");
+
+    benchmarkFrame<double>(runner, "double", signal);
+    benchmarkFrame<float>(runner, "float", signal);
+    benchmarkFrame<q15>(runner, "q15", signal);
+    benchmarkFrame<q31>(runner, "q31", signal);
+
+    const mfcc_config cfg;
+    basic_mel_filterbank<double> fbank(cfg.fs, cfg.numFFT, cfg.numFilters, cfg.lowFreq, cfg.highFreq);
+    std::vector<double> power(cfg.numFFT / 2 + 1), energies(cfg.numFilters);
+    for (size_t i=0; i<power.size(); i++)
+        power[i] = 1 + std::abs(std::sin(0.2 * i));
+    runner.run("filterbank/double", [&]() {
+        fbank.apply(power.data(), energies.data());
+        clobberMemory();
+    });
+
+    benchmark_config heavy = runner.config();
+    heavy.runs = std::max<size_t>(5, heavy.runs / 4);
+    heavy.warmupRuns = 1;
+    benchmarkExtraction<double>(runner, "double", signal, heavy);
+    benchmarkExtraction<float>(runner, "float", signal, heavy);
+}
+
+// Self-similarity of n random frames, the time is per cell of the triangle (per cell of the band for banded)
+void benchmarkSimilarity(benchmark_runner& runner, size_t n, size_t dim) {
+    benchmark_config heavy = runner.config();
+    heavy.runs = std::max<size_t>(5, heavy.runs / 4);
+    heavy.warmupRuns = 1;
+    const feature_matrix<double> features = randomFeatures(n, dim);
+    const size_t cells = n * (n + 1) / 2;
+    const std::string size = std::to_string(n) + " x " + std::to_string(dim);
+
+    const std::vector<std::vector<double>> vecdmfcc = toVectors(features);
+    similarity_matrix<double> reference(n);
+    runner.run("similarity/" + size + "/lambda", cells, heavy, [&]() {
+        lambdaSimilarity(vecdmfcc, reference);
+        clobberMemory();
+    });
+    for (const char* name : {"scalar", "sse2", "avx2", "neon"}) {
+        const dsp_kernels* simd = findKernels<double>(name);
+        if (!simd)
+            continue;
+        similarity_engine<double> engine(*simd);
+        similarity_matrix<double> ssm;
+        runner.run("similarity/" + size + "/engine " + name, cells, heavy, [&]() {
+            engine.compute(features, ssm);
+            clobberMemory();
+        });
+    }
+    similarity_engine<double> engine;
+    similarity_matrix<double> ssm;
+    runner.run("similarity/" + size + "/engine, " + std::to_string(default_task_system().size()) + " threads", cells,
+               heavy, [&]() {
+        engine.compute(features, ssm, default_task_system());
+        clobberMemory();
+    });
+
+    const size_t maxLag = 300;
+    banded_similarity_matrix<double> banded;
+    runner.run("similarity/" + size + "/banded " + std::to_string(maxLag), n * (maxLag + 1), heavy, [&]() {
+        engine.compute(features, maxLag, banded);
+        clobberMemory();
+    });
+
+    foote_segmenter<double> segmenter;
+    std::vector<size_t> boundaries;
+    engine.compute(features, ssm);
+    runner.run("segmentation/" + std::to_string(n) + " frames", n, heavy, [&]() {
+        segmenter.segment(ssm, boundaries);
+        clobberMemory();
+    });
+}
+
+// _____________________________________________________________________________________________________________________
+
+/* Every 16th task is 64 times longer than the others, the imbalance that stalls a round-robin queue behind a slow task
+ * while other workers run dry; the time is per task.
+ */
+template<typename S>
+void timeImbalancedTasks(benchmark_runner& runner, const std::string& name, S& ts, size_t numTasks,
+                         const benchmark_config& config) {
+    std::vector<double> results(numTasks);
+    auto work = [&results](size_t k) {
+        const unsigned units = k % 16 == 0 ? 64 : 1;
+        double x = 0;
+        for (unsigned i=0; i<units*2000; i++)
+            x += std::sqrt(double(i + k));
+        results[k] = x;
+    };
+    runner.run(name, numTasks, config, [&]() {
+        for (size_t k=0; k<numTasks; k++)
+            ts.async([&work, k](){ work(k); });
+        ts.wait_idle();
+    });
+}
+
+/* Scheduler overhead: empty tasks submitted from outside (the mutex queues against the injection queue) and spawned
+ * by a task on a worker (the mutex queues against the worker's own deque), and the round trip from async() to the
+ * task running when the workers have nothing else to do. The allocations per task show the cost of the queues.
+ */
+template<typename S>
+void timeScheduler(benchmark_runner& runner, const std::string& name, S& ts, size_t numTasks) {
+    std::atomic<size_t> count{0};
+    runner.run("scheduler/" + name + "/submitted", numTasks, [&]() {
+        for (size_t k=0; k<numTasks; k++)
+            ts.async([&count](){ count++; });
+        ts.wait_idle();
+    });
+    runner.run("scheduler/" + name + "/spawned", numTasks, [&]() {
+        ts.async([&ts, &count, numTasks](){
+            for (size_t k=0; k<numTasks; k++)
+                ts.async([&count](){ count++; });
+        });
+        ts.wait_idle();
+    });
+    runner.run("scheduler/" + name + "/round trip", [&]() {
+        std::atomic<bool> ran{false};
+        ts.async([&ran](){ ran = true; });
+        while (!ran) std::this_thread::yield();
+        ts.wait_idle();
+    });
+}
+
+void benchmarkTasks(benchmark_runner& runner) {
+    benchmark_config heavy = runner.config();
+    heavy.runs = std::max<size_t>(5, heavy.runs / 4);
+    heavy.warmupRuns = 1;
+
+    const unsigned maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<unsigned> counts;
+    for (unsigned t=1; t<maxThreads; t*=2)
+        counts.push_back(t);
+    counts.push_back(maxThreads);
+    for (unsigned threads : counts) {
+        const std::string suffix = "/" + std::to_string(threads) + " threads";
+        const std::string names[3] = {"tasks/imbalanced/round robin" + suffix, "tasks/imbalanced/stealing" + suffix,
+                                      "tasks/imbalanced/lock-free" + suffix};
+        if (!runner.selected(names[0]) && !runner.selected(names[1]) && !runner.selected(names[2]))
+            continue; // no pools are started for benchmarks that the filter leaves out
+        mutex_task_system roundRobin(threads, 0), stealing(threads, 4);
+        task_system lockFree(threads);
+        timeImbalancedTasks(runner, names[0], roundRobin, 4096, heavy);
+        timeImbalancedTasks(runner, names[1], stealing, 4096, heavy);
+        timeImbalancedTasks(runner, names[2], lockFree, 4096, heavy);
+    }
+
+    if (runner.selected("scheduler/mutex queues/submitted") || runner.selected("scheduler/mutex queues/spawned") ||
+        runner.selected("scheduler/mutex queues/round trip")) {
+        mutex_task_system mutexQueues;
+        timeScheduler(runner, "mutex queues", mutexQueues, 10000);
+    }
+    timeScheduler(runner, "lock-free", default_task_system(), 10000);
+}
+
+// _____________________________________________________________________________________________________________________
+
+// Copy and move of the containers, timed once each by measurePerformance
+void measureContainers() {
+    {
+        std::vector<int> vec(1000000);
+        measurePerformance(vec, "std::vector<int>(1000000)");
+    }
+    {
+        std::list<int> lis(1000000);
+        measurePerformance(lis, "std::list<int>(1000000)");
+    }
+    {
+        std::forward_list<int> flis(1000000);
+        measurePerformance(flis, "std::forward_list<int>(1000000)");
+    }
+    {
+        std::map<int, int> map;
+        for (auto i=0; i<=1000000; ++i) map[i] = i;
+        measurePerformance(map, "std::map<int,int>");
+    }
+    {
+        std::unordered_map<int, int> unmap;
+        for (auto i=0; i<=1000000; ++i) unmap[i] = i;
+        measurePerformance(unmap, "std::unordered_map<int,int>");
+    }
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    benchmark_config config;
+    std::string filter, jsonPath;
+    bool checks = true;
+    for (int i=1; i<argc; i++) {
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (arg == "--filter" && hasValue) {
+            filter = argv[++i];
+        } else if (arg == "--json" && hasValue) {
+            jsonPath = argv[++i];
+        } else if (arg == "--runs" && hasValue) {
+            config.runs = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--warmup" && hasValue) {
+            config.warmupRuns = std::max(0, std::atoi(argv[++i]));
+        } else if (arg == "--min-time" && hasValue) {
+            config.minRunSeconds = std::atof(argv[++i]);
+        } else if (arg == "--no-checks") {
+            checks = false;
+        } else {
+            std::cout << "Usage: bench [--filter <text>] [--json <path>] [--runs <n>] [--warmup <n>] "
+                         "[--min-time <seconds>] [--no-checks]" << std::endl;
+            return 2;
+        }
+    }
+
+    const std::vector<int16_t> signal = testSignal();
+    bool ok = true;
+    if (checks)
+        ok = runChecks(signal);
+
+    benchmark_runner runner(config, &std::cout);
+    runner.setFilter(filter);
+    benchmarkTypeErasure(runner);
+    benchmarkDispatch(runner);
+    benchmarkDsp(runner, signal);
+    benchmarkSimilarity(runner, 2000, 13);
+    benchmarkSimilarity(runner, 2000, 64);
+    benchmarkTasks(runner);
+    if (runner.selected("containers"))
+        measureContainers();
+
+    if (!jsonPath.empty()) {
+        std::ofstream json(jsonPath);
+        runner.writeJson(json);
+        if (!json) {
+            std::cout << "Unable to write " << jsonPath << std::endl;
+            return 1;
+        }
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,48 @@
+#ifndef BYTEORDER_H
+#define BYTEORDER_H
+
+#include <cstdint>
+
+/* Fixed byte order fields of the file formats: RIFF/WAVE and the binary feature files are little endian, HTK parameter
+ * files big endian. Byte by byte, so the fields need no alignment and the host order does not matter; compilers turn
+ * the little-endian ones into single loads and stores on little-endian hosts.
+ */
+
+inline uint16_t readLE16(const uint8_t* p) {
+    return uint16_t(p[0] | p[1] << 8);
+}
+
+inline uint32_t readLE32(const uint8_t* p) {
+    return uint32_t(p[0]) | uint32_t(p[1]) << 8 | uint32_t(p[2]) << 16 | uint32_t(p[3]) << 24;
+}
+
+inline uint64_t readLE64(const uint8_t* p) {
+    return uint64_t(readLE32(p)) | uint64_t(readLE32(p + 4)) << 32;
+}
+
+inline void writeLE16(uint8_t* p, uint16_t v) {
+    p[0] = uint8_t(v);
+    p[1] = uint8_t(v >> 8);
+}
+
+inline void writeLE32(uint8_t* p, uint32_t v) {
+    for (int i=0; i<4; i++)
+        p[i] = uint8_t(v >> (8 * i));
+}
+
+inline void writeLE64(uint8_t* p, uint64_t v) {
+    for (int i=0; i<8; i++)
+        p[i] = uint8_t(v >> (8 * i));
+}
+
+inline void writeBE16(uint8_t* p, uint16_t v) {
+    p[0] = uint8_t(v >> 8);
+    p[1] = uint8_t(v);
+}
+
+inline void writeBE32(uint8_t* p, uint32_t v) {
+    for (int i=0; i<4; i++)
+        p[i] = uint8_t(v >> (24 - 8 * i));
+}
+
+#endif // BYTEORDER_H
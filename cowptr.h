@@ -0,0 +1,54 @@
+#ifndef COWPTR_H
+#define COWPTR_H
+
+#include <memory>
+#include <utility>
+
+/* Copy-on-write pointer to a value
+ * Copies of a cow_ptr share one immutable value, so copying an object that holds large results or tables costs a
+ * reference count increment instead of a deep copy. write() gives mutable access and copies the value first if it is
+ * shared; reset() starts over from a fresh value without copying the old one, for results that are recomputed from
+ * scratch anyway. share() hands the current value to another thread or to the QML layer as a shared_ptr<const T> that
+ * stays valid and unchanged whatever the owner does with its cow_ptr afterwards.
+ *
+ * write() decides by the use count. Holders of a share() can only release their reference, never add one to the
+ * cow_ptr's value, so a count of one means the value is not shared and a stale higher count only costs a copy. Like a
+ * shared_ptr, one cow_ptr must not be modified by two threads at once.
+ */
+template<typename T>
+class cow_ptr {
+
+public:
+    cow_ptr() : ptr(std::make_shared<T>()) {}
+    explicit cow_ptr(T value) : ptr(std::make_shared<T>(std::move(value))) {}
+
+    const T& operator*() const { return *ptr; }
+    const T* operator->() const { return ptr.get(); }
+    const T* get() const { return ptr.get(); }
+
+    // Mutable value, copied first if it is shared
+    T& write() {
+        if (ptr.use_count() > 1)
+            ptr = std::make_shared<T>(*ptr);
+        return *ptr;
+    }
+
+    // Mutable default value; the old one is released, or left to the copies that share it
+    T& reset() {
+        if (ptr.use_count() > 1)
+            ptr = std::make_shared<T>();
+        else
+            *ptr = T();
+        return *ptr;
+    }
+
+    // The current value, unaffected by later writes through this cow_ptr
+    std::shared_ptr<const T> share() const { return ptr; }
+
+    bool unique() const { return ptr.use_count() == 1; }
+
+private:
+    std::shared_ptr<T> ptr;
+};
+
+#endif // COWPTR_H
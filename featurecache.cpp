@@ -0,0 +1,306 @@
+#include "featurecache.h"
+#include "hash.h"
+#include "kernels.h"
+#include "wavfile.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <direct.h>
+#include <sys/utime.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utime.h>
+#endif
+
+namespace {
+
+const char ENTRY_SUFFIX[] = ".fcache";
+const uint16_t ENTRY_VERSION = 1;
+
+enum entry_kind : uint16_t {
+    ENTRY_FEATURES = 1,         // rows = frames, cols = coefficients
+    ENTRY_SIMILARITY = 2,       // rows = cols = frames, packed upper triangle
+    ENTRY_BANDED = 3            // rows = frames, cols = maximum lag, lag-major band
+};
+
+// Header of an entry, followed by count doubles
+struct entry_header {
+    char magic[4];
+    uint16_t version;
+    uint16_t kind;
+    uint64_t key;
+    uint64_t rows;
+    uint64_t cols;
+    uint64_t count;
+    uint64_t checksum;          // XXH64 of the values
+    uint64_t reserved[2];
+};
+static_assert(sizeof(entry_header) == 64, "entry header layout");
+
+struct entry_file {
+    std::string path;
+    uint64_t size;
+    int64_t modified;
+};
+
+#ifdef _WIN32
+
+void makeDirectory(const std::string& path) {
+    _mkdir(path.c_str());
+}
+
+void touch(const std::string& path) {
+    _utime(path.c_str(), nullptr);
+}
+
+unsigned long processId() {
+    return GetCurrentProcessId();
+}
+
+// Replace the entry at to, which may exist
+bool replaceFile(const std::string& from, const std::string& to) {
+    return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+}
+
+std::vector<entry_file> listEntries(const std::string& directory) {
+    std::vector<entry_file> entries;
+    WIN32_FIND_DATAA data;
+    HANDLE find = FindFirstFileA((directory + "\\*" + ENTRY_SUFFIX).c_str(), &data);
+    if (find == INVALID_HANDLE_VALUE)
+        return entries;
+    do {
+        ULARGE_INTEGER size, time;
+        size.LowPart = data.nFileSizeLow;
+        size.HighPart = data.nFileSizeHigh;
+        time.LowPart = data.ftLastWriteTime.dwLowDateTime;
+        time.HighPart = data.ftLastWriteTime.dwHighDateTime;
+        entries.push_back({directory + "/" + data.cFileName, size.QuadPart, int64_t(time.QuadPart)});
+    } while (FindNextFileA(find, &data));
+    FindClose(find);
+    return entries;
+}
+
+#else
+
+void makeDirectory(const std::string& path) {
+    mkdir(path.c_str(), 0755);
+}
+
+void touch(const std::string& path) {
+    utime(path.c_str(), nullptr);
+}
+
+unsigned long processId() {
+    return static_cast<unsigned long>(getpid());
+}
+
+bool replaceFile(const std::string& from, const std::string& to) {
+    return std::rename(from.c_str(), to.c_str()) == 0;
+}
+
+std::vector<entry_file> listEntries(const std::string& directory) {
+    std::vector<entry_file> entries;
+    DIR* dir = opendir(directory.c_str());
+    if (!dir)
+        return entries;
+    const size_t suffixLength = sizeof(ENTRY_SUFFIX) - 1;
+    while (dirent* entry = readdir(dir)) {
+        const size_t length = std::strlen(entry->d_name);
+        if (length <= suffixLength || std::strcmp(entry->d_name + length - suffixLength, ENTRY_SUFFIX) != 0)
+            continue;
+        std::string file = directory + "/" + entry->d_name;
+        struct stat st;
+        if (stat(file.c_str(), &st) == 0)
+            entries.push_back({file, uint64_t(st.st_size), int64_t(st.st_mtime)});
+    }
+    closedir(dir);
+    return entries;
+}
+
+#endif
+
+}
+
+feature_cache::feature_cache(const char* directory, uint64_t maxBytes) : path(directory), maxBytes(maxBytes) {
+    makeDirectory(path);
+}
+
+uint64_t feature_cache::key(const uint8_t* audio, size_t size, const mfcc_config& config) {
+    // Every analysis parameter, at a fixed width so the key does not depend on the platform
+    const double parameters[] = {
+        double(config.fs), double(config.numFFT), double(config.numFilters), double(config.numCepstral),
+        double(config.winWidth), double(config.frameShift), config.preEmphCoef, config.lowFreq, config.highFreq
+    };
+    uint64_t h = xxh64(parameters, sizeof(parameters), xxh64(audio, size));
+
+    // The code that computed the values: its version, and the kernel set, whose rounding differs between SIMD widths
+    const uint32_t version = ANALYSIS_VERSION;
+    h = xxh64(&version, sizeof(version), h);
+    const char* kernelSet = kernels<double>().name;
+    return xxh64(kernelSet, std::strlen(kernelSet), h);
+}
+
+uint64_t feature_cache::similarityKey(uint64_t featureKey, size_t maxLag) {
+    const uint64_t lag = maxLag;
+    return xxh64(&lag, sizeof(lag), featureKey);
+}
+
+std::string feature_cache::entryPath(uint64_t key) const {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(key));
+    return path + "/" + name + ENTRY_SUFFIX;
+}
+
+template<typename Fill>
+int feature_cache::loadEntry(uint64_t key, uint16_t kind, Fill&& fill) {
+    const std::string file = entryPath(key);
+    mapped_file map;
+    std::FILE* probe = std::fopen(file.c_str(), "rb");
+    if (!probe)
+        return 1;   // a plain miss, no message
+    std::fclose(probe);
+
+    entry_header header;
+    bool valid = map.open(file.c_str()) == 0 && map.size() >= sizeof(header);
+    if (valid) {
+        std::memcpy(&header, map.data(), sizeof(header));
+        const uint8_t* values = map.data() + sizeof(header);
+        // An entry of another kind is intact, just not the one asked for
+        if (std::memcmp(header.magic, "FCCH", 4) == 0 && header.version == ENTRY_VERSION && header.kind != kind)
+            return 1;
+        valid = std::memcmp(header.magic, "FCCH", 4) == 0 && header.version == ENTRY_VERSION && header.key == key &&
+                map.size() - sizeof(header) == header.count * sizeof(double) &&
+                xxh64(values, size_t(header.count * sizeof(double))) == header.checksum;
+    }
+    double* out = valid ? fill(header.rows, header.cols, header.count) : nullptr;
+    if (!out) {
+        std::cout << "Removing invalid cache entry: " << file << std::endl;
+        map.close();
+        std::remove(file.c_str());
+        return 1;
+    }
+    std::memcpy(out, map.data() + sizeof(header), size_t(header.count * sizeof(double)));
+    touch(file);
+    return 0;
+}
+
+int feature_cache::load(uint64_t key, feature_matrix<double>& features) {
+    return loadEntry(key, ENTRY_FEATURES, [&features](uint64_t rows, uint64_t cols, uint64_t count) -> double* {
+        if (rows * cols != count)
+            return nullptr;
+        features.resize(size_t(rows), size_t(cols));
+        return features.data();
+    });
+}
+
+int feature_cache::load(uint64_t key, similarity_matrix<double>& ssm) {
+    return loadEntry(key, ENTRY_SIMILARITY, [&ssm](uint64_t rows, uint64_t cols, uint64_t count) -> double* {
+        if (rows != cols || rows * (rows + 1) / 2 != count)
+            return nullptr;
+        ssm.resize(size_t(rows));
+        return ssm.data();
+    });
+}
+
+int feature_cache::load(uint64_t key, banded_similarity_matrix<double>& ssm) {
+    return loadEntry(key, ENTRY_BANDED, [&ssm](uint64_t rows, uint64_t cols, uint64_t count) -> double* {
+        /* The band of cols+1 lags of rows frames holds (cols+1) (2 rows - cols) / 2 values, cols below rows as stored;
+         * checked before resizing to it, and without overflow, as count is bounded by the size of the file
+         */
+        if (rows == 0 || cols >= rows || rows > count)
+            return nullptr;
+        const uint64_t lags = cols + 1, perLag = 2 * rows - cols;
+        if (perLag > 2 * count / lags || lags * perLag / 2 != count)
+            return nullptr;
+        ssm.resize(size_t(rows), size_t(cols));
+        return ssm.data();
+    });
+}
+
+int feature_cache::storeEntry(uint64_t key, uint16_t kind, uint64_t rows, uint64_t cols, const double* values,
+                              size_t count) {
+    // Nothing to save for empty input, which is cheaper to analyse than to look up
+    if (count == 0)
+        return 0;
+
+    entry_header header = {};
+    std::memcpy(header.magic, "FCCH", 4);
+    header.version = ENTRY_VERSION;
+    header.kind = kind;
+    header.key = key;
+    header.rows = rows;
+    header.cols = cols;
+    header.count = count;
+    header.checksum = xxh64(values, count * sizeof(double));
+
+    /* Unique per process and store, so concurrent writers of the same entry do not share a temporary file. It ends in
+     * the suffix of the entries, so one left behind by a writer that crashed counts toward the limit and is evicted.
+     */
+    static std::atomic<unsigned> sequence{0};
+    const std::string file = entryPath(key);
+    const std::string temporary = file.substr(0, file.size() - (sizeof(ENTRY_SUFFIX) - 1)) + ".tmp." +
+                                  std::to_string(processId()) + "." + std::to_string(sequence++) + ENTRY_SUFFIX;
+    {
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(values), std::streamsize(count * sizeof(double)));
+        out.close();
+        if (out.fail()) {
+            std::cout << "Unable to write cache entry: " << temporary << std::endl;
+            std::remove(temporary.c_str());
+            return 1;
+        }
+    }
+    if (!replaceFile(temporary, file)) {
+        std::cout << "Unable to store cache entry: " << file << std::endl;
+        std::remove(temporary.c_str());
+        return 1;
+    }
+    evict(file);
+    return 0;
+}
+
+int feature_cache::store(uint64_t key, const feature_matrix<double>& features) {
+    return storeEntry(key, ENTRY_FEATURES, features.rows(), features.cols(), features.data(),
+                      features.rows() * features.cols());
+}
+
+int feature_cache::store(uint64_t key, const similarity_matrix<double>& ssm) {
+    return storeEntry(key, ENTRY_SIMILARITY, ssm.size(), ssm.size(), ssm.data(), ssm.storageSize());
+}
+
+int feature_cache::store(uint64_t key, const banded_similarity_matrix<double>& ssm) {
+    return storeEntry(key, ENTRY_BANDED, ssm.size(), ssm.maxLag(), ssm.data(), ssm.storageSize());
+}
+
+void feature_cache::evict() {
+    evict(std::string());
+}
+
+void feature_cache::evict(const std::string& keep) {
+    std::vector<entry_file> entries = listEntries(path);
+    uint64_t total = 0;
+    for (const entry_file& entry : entries)
+        total += entry.size;
+    if (total <= maxBytes)
+        return;
+
+    // Oldest first; the entry to keep stays even when it alone exceeds the limit
+    std::sort(entries.begin(), entries.end(), [](const entry_file& a, const entry_file& b) {
+        return a.modified < b.modified;
+    });
+    for (size_t i=0; i<entries.size() && total>maxBytes; i++) {
+        if (entries[i].path != keep && std::remove(entries[i].path.c_str()) == 0)
+            total -= entries[i].size;
+    }
+}
@@ -0,0 +1,77 @@
+#ifndef FEATURECACHE_H
+#define FEATURECACHE_H
+
+#include "featurematrix.h"
+#include "mfcc.h"
+#include "similaritymatrix.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/* Persistent on-disk cache of MFCC and self-similarity matrices
+ * Entries are content addressed: the key of the MFCCs is the XXH64 of the audio data, chained with the XXH64 of every
+ * analysis parameter of mfcc_config, of ANALYSIS_VERSION and of the name of the DSP kernel set that computes the
+ * values, so a changed recording, configuration, analysis code or machine simply misses. The self-similarity matrix
+ * is keyed by the key of its MFCCs and its maximum lag (0 for the full matrix).
+ *
+ * Every entry is one file, <key>.fcache, with a header that repeats the key, the kind and the dimensions of the
+ * matrix, and the XXH64 of the values. A load maps the file and validates all of it, so a truncated, foreign or
+ * corrupted entry is a miss (and is removed) rather than wrong features. Values are stored in the byte order of the
+ * host; the cache is local to the machine. Stores write a temporary file and rename it over the entry, so readers in
+ * other processes see the old entry or the new one, never a partial one; temporary files left by a crash are evicted
+ * like entries.
+ *
+ * The cache is bounded by maxBytes and evicts least recently used entries first: loads touch the modification time of
+ * the entry, and after every store the oldest entries are removed until the cache fits.
+ */
+/* Version of the numeric output of the analysis, part of every key: bump it with any change to the MFCC pipeline, the
+ * kernels or the similarity engine that changes the values, so that entries computed by the old code are no longer hit
+ * (ENTRY_VERSION in featurecache.cpp describes only the layout of the files)
+ */
+const uint32_t ANALYSIS_VERSION = 1;
+
+class feature_cache {
+
+public:
+    explicit feature_cache(const char* directory = ".mfcccache", uint64_t maxBytes = uint64_t(1) << 30);
+
+    // Key of the MFCCs of size bytes of audio analysed with config
+    static uint64_t key(const uint8_t* audio, size_t size, const mfcc_config& config);
+
+    // Key of the self-similarity matrix of the MFCCs with key featureKey, limited to maxLag (0 for the full matrix)
+    static uint64_t similarityKey(uint64_t featureKey, size_t maxLag);
+
+    // Load an entry, returns 0 on a hit and 1 on a miss
+    int load(uint64_t key, feature_matrix<double>& features);
+    int load(uint64_t key, similarity_matrix<double>& ssm);
+    int load(uint64_t key, banded_similarity_matrix<double>& ssm);
+
+    // Store an entry and evict old entries beyond the size limit, returns 0 on success
+    int store(uint64_t key, const feature_matrix<double>& features);
+    int store(uint64_t key, const similarity_matrix<double>& ssm);
+    int store(uint64_t key, const banded_similarity_matrix<double>& ssm);
+
+    // Remove entries, least recently used first, until the cache holds at most maxBytes
+    void evict();
+
+    const std::string& directory() const { return path; }
+    uint64_t sizeLimit() const { return maxBytes; }
+
+private:
+    std::string path;
+    uint64_t maxBytes;
+
+    std::string entryPath(uint64_t key) const;
+    void evict(const std::string& keep);
+
+    /* Map and validate the entry of the given kind, then copy its values to fill(rows, cols, count), the destination
+     * sized for them or nullptr when the dimensions do not fit; returns 0 on a hit
+     */
+    template<typename Fill>
+    int loadEntry(uint64_t key, uint16_t kind, Fill&& fill);
+
+    int storeEntry(uint64_t key, uint16_t kind, uint64_t rows, uint64_t cols, const double* values, size_t count);
+};
+
+#endif // FEATURECACHE_H
@@ -0,0 +1,232 @@
+#include "featurefile.h"
+#include "byteorder.h"
+
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+const size_t HEADER_SIZE = 128;
+const uint16_t FORMAT_VERSION = 1;
+
+// HTK parameter kind MFCC with the qualifier _0 (c0 appended)
+const uint16_t HTK_MFCC = 6;
+const uint16_t HTK_ZEROTH = 0x2000;
+
+double readF64(const uint8_t* p) {
+    uint64_t bits = readLE64(p);
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+void writeF32(uint8_t* p, float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    writeLE32(p, bits);
+}
+
+void writeF64(uint8_t* p, double value) {
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    writeLE64(p, bits);
+}
+
+size_t valueSize(uint16_t valueType) {
+    return valueType == FEATURE_FLOAT32 ? 4 : valueType == FEATURE_FLOAT64 ? 8 : 0;
+}
+
+}
+
+int feature_file::open(const char* path) {
+    if (map.open(path) != 0)
+        return 1;
+    return parse(map.data(), map.size());
+}
+
+int feature_file::parse(const uint8_t* image, size_t size) {
+    hdr = feature_header();
+    frames = nullptr;
+
+    if (size < HEADER_SIZE || std::memcmp(image, "MFCF", 4) != 0) {
+        std::cout << "Not a feature file" << std::endl;
+        return 1;
+    }
+    hdr.version = readLE16(image + 4);
+    const size_t dataOffset = readLE16(image + 6);
+    hdr.valueType = readLE16(image + 8);
+    if (hdr.version != FORMAT_VERSION || dataOffset < HEADER_SIZE || valueSize(hdr.valueType) == 0) {
+        std::cout << "Unsupported feature file version " << hdr.version << std::endl;
+        return 1;
+    }
+    hdr.numCoefficients = readLE32(image + 12);
+    hdr.numFrames = readLE64(image + 16);
+
+    mfcc_config& config = hdr.config;
+    config.fs = readLE32(image + 24);
+    config.numCepstral = readLE32(image + 28);
+    config.numFilters = readLE32(image + 32);
+    config.numFFT = readLE32(image + 36);
+    config.winWidth = readLE32(image + 40);
+    config.frameShift = readLE32(image + 44);
+    config.preEmphCoef = readF64(image + 48);
+    config.lowFreq = readF64(image + 56);
+    config.highFreq = readF64(image + 64);
+
+    // A file whose writer did not finish holds fewer frames than the header says
+    const uint64_t frameBytes = uint64_t(hdr.numCoefficients) * valueSize(hdr.valueType);
+    const uint64_t available = size > dataOffset && frameBytes ? (size - dataOffset) / frameBytes : 0;
+    if (available < hdr.numFrames) {
+        std::cout << "Truncated feature file: " << available << " of " << hdr.numFrames << " frames" << std::endl;
+        hdr.numFrames = available;
+    }
+    frames = image + dataOffset;
+    return 0;
+}
+
+template<>
+sample_span<float> feature_file::values<float>() const {
+    sample_span<float> span;
+    if (hdr.valueType != FEATURE_FLOAT32 || reinterpret_cast<uintptr_t>(frames) % alignof(float) != 0)
+        return span;
+    span.data = reinterpret_cast<const float*>(frames);
+    span.size = size_t(hdr.numFrames) * hdr.numCoefficients;
+    return span;
+}
+
+template<>
+sample_span<double> feature_file::values<double>() const {
+    sample_span<double> span;
+    if (hdr.valueType != FEATURE_FLOAT64 || reinterpret_cast<uintptr_t>(frames) % alignof(double) != 0)
+        return span;
+    span.data = reinterpret_cast<const double*>(frames);
+    span.size = size_t(hdr.numFrames) * hdr.numCoefficients;
+    return span;
+}
+
+int feature_file_writer::open(const char* path, const mfcc_config& config, size_t numCoefficients,
+                              feature_value_type valueType) {
+    close();
+    out.open(path, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        std::cout << "Unable to open output file: " << path << std::endl;
+        return 1;
+    }
+    type = valueType;
+    this->numCoefficients = numCoefficients;
+    numFrames = 0;
+    buffer.assign(numCoefficients * valueSize(type), 0);
+
+    uint8_t header[HEADER_SIZE] = {};
+    std::memcpy(header, "MFCF", 4);
+    writeLE16(header + 4, FORMAT_VERSION);
+    writeLE16(header + 6, uint16_t(HEADER_SIZE));
+    writeLE16(header + 8, type);
+    writeLE32(header + 12, uint32_t(numCoefficients));
+    writeLE64(header + 16, 0);
+    writeLE32(header + 24, uint32_t(config.fs));
+    writeLE32(header + 28, uint32_t(config.numCepstral));
+    writeLE32(header + 32, uint32_t(config.numFilters));
+    writeLE32(header + 36, uint32_t(config.numFFT));
+    writeLE32(header + 40, uint32_t(config.winWidth));
+    writeLE32(header + 44, uint32_t(config.frameShift));
+    writeF64(header + 48, config.preEmphCoef);
+    writeF64(header + 56, config.lowFreq);
+    writeF64(header + 64, config.highFreq);
+    out.write(reinterpret_cast<const char*>(header), HEADER_SIZE);
+    return out.good() ? 0 : 1;
+}
+
+template<typename T>
+void feature_file_writer::encode(const T* frame) {
+    uint8_t* p = buffer.data();
+    if (type == FEATURE_FLOAT32) {
+        for (size_t i=0; i<numCoefficients; i++, p+=4)
+            writeF32(p, float(frame[i]));
+    } else {
+        for (size_t i=0; i<numCoefficients; i++, p+=8)
+            writeF64(p, double(frame[i]));
+    }
+    out.write(reinterpret_cast<const char*>(buffer.data()), std::streamsize(buffer.size()));
+    numFrames++;
+}
+
+void feature_file_writer::append(const float* frame) {
+    encode(frame);
+}
+
+void feature_file_writer::append(const double* frame) {
+    encode(frame);
+}
+
+int feature_file_writer::close() {
+    if (!out.is_open())
+        return 0;
+    uint8_t count[8];
+    writeLE64(count, numFrames);
+    out.seekp(16);
+    out.write(reinterpret_cast<const char*>(count), sizeof(count));
+    out.close();
+    if (out.fail()) {
+        std::cout << "Unable to write feature file" << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+int htk_writer::open(const char* path, const mfcc_config& config, size_t numCoefficients) {
+    close();
+    out.open(path, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        std::cout << "Unable to open output file: " << path << std::endl;
+        return 1;
+    }
+    this->numCoefficients = numCoefficients;
+    numFrames = 0;
+    buffer.assign(numCoefficients * 4, 0);
+
+    uint8_t header[12];
+    writeBE32(header, 0);
+    writeBE32(header + 4, uint32_t(config.frameShift * 10000));    // 100 ns units
+    writeBE16(header + 8, uint16_t(numCoefficients * 4));
+    writeBE16(header + 10, HTK_MFCC | HTK_ZEROTH);
+    out.write(reinterpret_cast<const char*>(header), sizeof(header));
+    return out.good() ? 0 : 1;
+}
+
+template<typename T>
+void htk_writer::encode(const T* frame) {
+    // c1 .. cN, then c0
+    uint8_t* p = buffer.data();
+    for (size_t i=1; i<=numCoefficients; i++, p+=4) {
+        float value = float(frame[i % numCoefficients]);
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        writeBE32(p, bits);
+    }
+    out.write(reinterpret_cast<const char*>(buffer.data()), std::streamsize(buffer.size()));
+    numFrames++;
+}
+
+void htk_writer::append(const float* frame) {
+    encode(frame);
+}
+
+void htk_writer::append(const double* frame) {
+    encode(frame);
+}
+
+int htk_writer::close() {
+    if (!out.is_open())
+        return 0;
+    uint8_t count[4];
+    writeBE32(count, uint32_t(numFrames));
+    out.seekp(0);
+    out.write(reinterpret_cast<const char*>(count), sizeof(count));
+    out.close();
+    if (out.fail() || numFrames > 0x7FFFFFFF) {
+        std::cout << "Unable to write HTK file" << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,138 @@
+#ifndef FEATUREFILE_H
+#define FEATUREFILE_H
+
+#include "mfcc.h"
+#include "wavfile.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <vector>
+
+// Numeric type of the values in a feature file
+enum feature_value_type : uint16_t {
+    FEATURE_FLOAT32 = 1,
+    FEATURE_FLOAT64 = 2
+};
+
+// Contents of the header of a feature file
+struct feature_header {
+    uint16_t version = 0;
+    uint16_t valueType = 0;             // feature_value_type
+    uint32_t numCoefficients = 0;       // values per frame
+    uint64_t numFrames = 0;
+    mfcc_config config;                 // analysis parameters the features were extracted with
+};
+
+/* Binary feature file
+ * A fixed 128-byte header followed by the frames, back to back, numCoefficients little-endian values of 32 or 64 bits
+ * each. All header fields are little endian:
+ *     0  "MFCF"                        36  numFFT (u32)
+ *     4  version (u16) = 1             40  winWidth, ms (u32)
+ *     6  data offset (u16) = 128       44  frameShift, ms (u32)
+ *     8  value type (u16)              48  preEmphCoef (f64)
+ *    12  numCoefficients (u32)         56  lowFreq (f64)
+ *    16  numFrames (u64)               64  highFreq (f64)
+ *    24  fs (u32)                      72  reserved, zero up to the data offset
+ *    28  numCepstral (u32)
+ *    32  numFilters (u32)
+ * The data offset keeps the frames of a page-aligned mapping aligned for vector loads, so a reader maps the file and
+ * uses values() in place, without parsing or copying; like wav_file, the zero-copy view assumes a little-endian host.
+ */
+class feature_file {
+
+public:
+    feature_file() = default;
+
+    // Map and parse the file at path, returns 0 on success
+    int open(const char* path);
+
+    // Parse a feature file image that stays owned by the caller, returns 0 on success
+    int parse(const uint8_t* image, size_t size);
+
+    const feature_header& header() const { return hdr; }
+    size_t numFrames() const { return size_t(hdr.numFrames); }
+    size_t numCoefficients() const { return hdr.numCoefficients; }
+
+    // All values, frame after frame, empty unless T is the value type of the file
+    template<typename T>
+    sample_span<T> values() const;
+
+    // The numCoefficients() values of frame i of a file whose value type is T
+    template<typename T>
+    const T* frame(size_t i) const { return values<T>().data + i * hdr.numCoefficients; }
+
+private:
+    mapped_file map;
+    feature_header hdr;
+    const uint8_t* frames = nullptr;
+};
+
+template<> sample_span<float> feature_file::values<float>() const;
+template<> sample_span<double> feature_file::values<double>() const;
+
+/* Streaming writer of binary feature files
+ * Frames are appended as they are extracted; close() writes the number of frames into the header.
+ */
+class feature_file_writer {
+
+public:
+    feature_file_writer() = default;
+    ~feature_file_writer() { close(); }
+
+    // Create the file at path and write the header, returns 0 on success
+    int open(const char* path, const mfcc_config& config, size_t numCoefficients,
+             feature_value_type valueType = FEATURE_FLOAT32);
+
+    // Append one frame of numCoefficients values, converted to the value type of the file
+    void append(const float* frame);
+    void append(const double* frame);
+
+    // Complete the header and close the file, returns 0 on success
+    int close();
+
+    uint64_t frameCount() const { return numFrames; }
+
+private:
+    std::ofstream out;
+    feature_value_type type = FEATURE_FLOAT32;
+    size_t numCoefficients = 0;
+    uint64_t numFrames = 0;
+    std::vector<uint8_t> buffer;        // one encoded frame
+
+    template<typename T>
+    void encode(const T* frame);
+};
+
+/* Streaming writer of HTK parameter files
+ * A 12-byte big-endian header (number of samples, sample period in 100 ns, bytes per sample, parameter kind) and
+ * big-endian 32-bit floats. The pipeline puts c0 first; HTK stores the cepstra c1 .. cN and then c0, of kind MFCC_0.
+ */
+class htk_writer {
+
+public:
+    htk_writer() = default;
+    ~htk_writer() { close(); }
+
+    // Create the file at path for frames of numCoefficients values (c0 first), returns 0 on success
+    int open(const char* path, const mfcc_config& config, size_t numCoefficients);
+
+    void append(const float* frame);
+    void append(const double* frame);
+
+    // Write the number of samples into the header and close the file, returns 0 on success
+    int close();
+
+    uint64_t frameCount() const { return numFrames; }
+
+private:
+    std::ofstream out;
+    size_t numCoefficients = 0;
+    uint64_t numFrames = 0;
+    std::vector<uint8_t> buffer;
+
+    template<typename T>
+    void encode(const T* frame);
+};
+
+#endif // FEATUREFILE_H
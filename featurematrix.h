@@ -0,0 +1,59 @@
+#ifndef FEATUREMATRIX_H
+#define FEATUREMATRIX_H
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+/* Feature vectors of consecutive frames in one contiguous row-major block
+ * Row i holds the cols() features of frame i. Keeping the frames back to back instead of one heap vector per frame
+ * lets the similarity engine stream them and removes a pointer chase and an allocation per frame.
+ */
+template<typename T>
+class feature_matrix {
+
+public:
+    feature_matrix() = default;
+    feature_matrix(size_t rows, size_t cols) { resize(rows, cols); }
+
+    // Resize to rows x cols, all elements zero
+    void resize(size_t rows, size_t cols) {
+        numRows = rows;
+        numCols = cols;
+        values.assign(rows * cols, T(0));
+    }
+
+    // Drop all rows and set the width of the following rows
+    void reset(size_t cols) {
+        numRows = 0;
+        numCols = cols;
+        values.clear();
+    }
+
+    void reserve(size_t rows) { values.reserve(rows * numCols); }
+
+    // Append one row of cols() values
+    void appendRow(const T* row) {
+        values.insert(values.end(), row, row + numCols);
+        numRows++;
+    }
+
+    size_t rows() const { return numRows; }
+    size_t cols() const { return numCols; }
+    bool empty() const { return numRows == 0; }
+
+    T* row(size_t i) { return values.data() + i * numCols; }
+    const T* row(size_t i) const { return values.data() + i * numCols; }
+
+    T& at(size_t i, size_t j) { return values[i * numCols + j]; }
+    T at(size_t i, size_t j) const { return values[i * numCols + j]; }
+
+    T* data() { return values.data(); }
+    const T* data() const { return values.data(); }
+
+private:
+    size_t numRows = 0, numCols = 0;
+    std::vector<T> values;
+};
+
+#endif // FEATUREMATRIX_H
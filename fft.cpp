@@ -0,0 +1,254 @@
+#include "fft.h"
+
+#include <algorithm>
+#include <math.h>
+
+namespace {
+
+const double PI = 4*atan(1.0);
+
+/* Butterfly arithmetic
+ * add/sub are the butterfly outputs shifted right by the block-floating-point shift of the stage (always zero in
+ * floating point), avg/avgDiff the halved sum and difference of the real-input split.
+ */
+
+// Complex multiplication without the C99 Annex G inf/nan recovery of std::complex operator*
+template<typename F>
+inline std::complex<F> cmul(const std::complex<F>& a, const std::complex<F>& b) {
+    return std::complex<F>(a.real()*b.real() - a.imag()*b.imag(), a.real()*b.imag() + a.imag()*b.real());
+}
+
+// Multiplication by -j
+template<typename F>
+inline std::complex<F> mulmj(const std::complex<F>& a) {
+    return std::complex<F>(a.imag(), -a.real());
+}
+
+template<typename F>
+inline std::complex<F> add(const std::complex<F>& a, const std::complex<F>& b, int) {
+    return a + b;
+}
+
+template<typename F>
+inline std::complex<F> sub(const std::complex<F>& a, const std::complex<F>& b, int) {
+    return a - b;
+}
+
+template<typename F>
+inline std::complex<F> avg(const std::complex<F>& a, const std::complex<F>& b) {
+    return F(0.5) * (a + b);
+}
+
+template<typename F>
+inline std::complex<F> avgDiff(const std::complex<F>& a, const std::complex<F>& b) {
+    return F(0.5) * (a - b);
+}
+
+template<typename F>
+inline std::complex<F> conjugate(const std::complex<F>& a) {
+    return std::conj(a);
+}
+
+template<typename F>
+inline void makeTwiddle(std::complex<F>& w, double phi) {
+    w = std::complex<F>(F(cos(phi)), F(sin(phi)));
+}
+
+// Floating point needs no block scaling
+template<typename F>
+inline int passShift(const std::complex<F>*, size_t, double) {
+    return 0;
+}
+
+template<typename Q>
+inline fixed_complex<Q> make(int64_t re, int64_t im) {
+    typedef typename Q::raw_type raw_type;
+    return fixed_complex<Q>{raw_type(re), raw_type(im)};
+}
+
+template<typename Q>
+inline fixed_complex<Q> cmul(const fixed_complex<Q>& a, const fixed_complex<Q>& b) {
+    return make<Q>(roundShift(int64_t(a.re)*b.re - int64_t(a.im)*b.im, Q::fracBits),
+                   roundShift(int64_t(a.re)*b.im + int64_t(a.im)*b.re, Q::fracBits));
+}
+
+template<typename Q>
+inline fixed_complex<Q> mulmj(const fixed_complex<Q>& a) {
+    return make<Q>(a.im, -int64_t(a.re));
+}
+
+template<typename Q>
+inline fixed_complex<Q> add(const fixed_complex<Q>& a, const fixed_complex<Q>& b, int shift) {
+    return make<Q>((int64_t(a.re) + b.re) >> shift, (int64_t(a.im) + b.im) >> shift);
+}
+
+template<typename Q>
+inline fixed_complex<Q> sub(const fixed_complex<Q>& a, const fixed_complex<Q>& b, int shift) {
+    return make<Q>((int64_t(a.re) - b.re) >> shift, (int64_t(a.im) - b.im) >> shift);
+}
+
+template<typename Q>
+inline fixed_complex<Q> avg(const fixed_complex<Q>& a, const fixed_complex<Q>& b) {
+    return add(a, b, 1);
+}
+
+template<typename Q>
+inline fixed_complex<Q> avgDiff(const fixed_complex<Q>& a, const fixed_complex<Q>& b) {
+    return sub(a, b, 1);
+}
+
+template<typename Q>
+inline fixed_complex<Q> conjugate(const fixed_complex<Q>& a) {
+    return make<Q>(a.re, -int64_t(a.im));
+}
+
+template<typename Q>
+inline void makeTwiddle(fixed_complex<Q>& w, double phi) {
+    w.re = toFixed<Q>(cos(phi));
+    w.im = toFixed<Q>(sin(phi));
+}
+
+// Smallest right shift that keeps a pass whose components can grow by the given factor inside the Qn range
+template<typename Q>
+inline int passShift(const fixed_complex<Q>* x, size_t N, double growth) {
+    int64_t m = 0;
+    for (size_t i=0; i<N; i++) {
+        int64_t re = x[i].re < 0 ? -int64_t(x[i].re) : x[i].re;
+        int64_t im = x[i].im < 0 ? -int64_t(x[i].im) : x[i].im;
+        m = std::max(m, std::max(re, im));
+    }
+    int shift = 0;
+    while (growth * (m + 2) >= std::ldexp(1.0, Q::fracBits + shift))
+        shift++;
+    return shift;
+}
+
+// Worst-case growth of a component: a +- b for unit twiddles, a +- w*b (|w| = 1) otherwise
+const double GROWTH_RADIX2 = 2.0;
+const double GROWTH_TWIDDLE = 1 + sqrt(2.0);
+
+}
+
+template<typename T>
+void basic_fft_engine<T>::init(size_t N) {
+    numPoints = N;
+    numStages = 0;
+    while ((size_t(1) << numStages) < N)
+        numStages++;
+
+    // Bit-reversal permutation
+    std::vector<uint32_t>& rev = bitrev.reset();
+    rev.assign(N, 0);
+    for (size_t i=0; i<N; i++) {
+        uint32_t r = 0;
+        for (size_t b=0; b<numStages; b++)
+            r |= ((i >> b) & 1) << (numStages-1-b);
+        rev[i] = r;
+    }
+
+    // Twiddle factors of all stages in one contiguous table, stage of size m at offset m/2-1
+    std::vector<c_d>& tw = twiddle.reset();
+    tw.assign(N > 1 ? N-1 : 0, c_d());
+    for (size_t m=2; m<=N; m*=2)
+        for (size_t k=0; k<m/2; k++)
+            makeTwiddle(tw[m/2-1+k], -2*PI*k/m);
+}
+
+template<typename T>
+int basic_fft_engine<T>::transform(c_d* x) const {
+    const size_t N = numPoints;
+    const uint32_t* rev = bitrev->data();
+    int shifts = 0;
+
+    for (size_t i=0; i<N; i++)
+        if (i < rev[i])
+            std::swap(x[i], x[rev[i]]);
+
+    // With an odd number of stages, the first one is a plain radix-2 pass (all twiddles equal 1)
+    size_t h = 1;
+    if (numStages % 2) {
+        int s = passShift(x, N, GROWTH_RADIX2);
+        for (size_t i=0; i<N; i+=2) {
+            c_d t = x[i+1];
+            x[i+1] = sub(x[i], t, s);
+            x[i] = add(x[i], t, s);
+        }
+        shifts += s;
+        h = 2;
+    }
+
+    // Radix-4 passes, each one fusing the radix-2 stages of size 2h and 4h
+    for (; h<N; h*=4) {
+        const c_d* w1 = twiddle->data() + h-1;
+        const c_d* w2 = twiddle->data() + 2*h-1;
+        int s = passShift(x, N, GROWTH_TWIDDLE * GROWTH_TWIDDLE);
+        int s1 = (s+1) / 2, s2 = s - s1;
+        for (size_t base=0; base<N; base+=4*h) {
+            c_d* x0 = x + base;
+            c_d* x1 = x0 + h;
+            c_d* x2 = x1 + h;
+            c_d* x3 = x2 + h;
+            for (size_t k=0; k<h; k++) {
+                c_d t1 = cmul(w1[k], x1[k]);
+                c_d t3 = cmul(w1[k], x3[k]);
+                c_d b0 = add(x0[k], t1, s1), b1 = sub(x0[k], t1, s1);
+                c_d b2 = add(x2[k], t3, s1), b3 = sub(x2[k], t3, s1);
+
+                c_d t2 = cmul(w2[k], b2);
+                c_d t4 = mulmj(cmul(w2[k], b3)); // twiddle of the second half is w2[k+h] = -j*w2[k]
+                x0[k] = add(b0, t2, s2);
+                x2[k] = sub(b0, t2, s2);
+                x1[k] = add(b1, t4, s2);
+                x3[k] = sub(b1, t4, s2);
+            }
+        }
+        shifts += s;
+    }
+    return shifts;
+}
+
+template<typename T>
+void basic_real_fft<T>::init(size_t N) {
+    numPoints = N;
+    half.init(N/2);
+
+    std::vector<c_d>& w = split.reset();
+    w.assign(N/2+1, c_d());
+    for (size_t k=0; k<=N/2; k++)
+        makeTwiddle(w[k], -2*PI*k/N);
+
+    work.assign(N/2, c_d());
+}
+
+template<typename T>
+int basic_real_fft<T>::transform(const sample_type* in, c_d* out) {
+    const size_t M = numPoints/2;
+
+    // Pack even samples into the real and odd samples into the imaginary part
+    for (size_t n=0; n<M; n++)
+        work[n] = c_d{in[2*n], in[2*n+1]};
+
+    int shifts = half.transform(work.data());
+
+    // Split the half-length spectrum into the spectrum of the real frame
+    int s = passShift(work.data(), M, GROWTH_TWIDDLE);
+    const c_d* w = split->data();
+    for (size_t k=0; k<=M; k++) {
+        c_d zk = work[k % M];
+        c_d zc = conjugate(work[(M-k) % M]);
+        c_d even = avg(zk, zc);
+        c_d odd = mulmj(avgDiff(zk, zc));
+        out[k] = add(even, cmul(w[k], odd), s);
+    }
+    return shifts + s;
+}
+
+template class basic_fft_engine<double>;
+template class basic_fft_engine<float>;
+template class basic_fft_engine<q15>;
+template class basic_fft_engine<q31>;
+
+template class basic_real_fft<double>;
+template class basic_real_fft<float>;
+template class basic_real_fft<q15>;
+template class basic_real_fft<q31>;
@@ -0,0 +1,102 @@
+#ifndef FFT_H
+#define FFT_H
+
+#include "cowptr.h"
+#include "fixedpoint.h"
+
+#include <complex>
+#include <cstdint>
+#include <vector>
+
+/* Data types of the FFT for each numeric type
+ * Floating-point transforms work on std::complex and are unscaled. Fixed-point transforms work on the raw integers in
+ * block floating point: before every pass the largest component is checked and the pass shifts its outputs right just
+ * enough that the worst-case butterfly growth cannot overflow. transform() returns the total number of shifts, so the
+ * result is X / 2^shifts; quiet frames keep their resolution instead of losing one bit per stage.
+ * Inputs must have a magnitude below 1 (|re + j*im| < 2^fracBits), which the real-input packing guarantees for real
+ * samples below 1/sqrt(2).
+ */
+template<typename T>
+struct fft_types {
+    typedef T sample_type;
+    typedef std::complex<T> complex_type;
+};
+
+template<>
+struct fft_types<q15> {
+    typedef q15::raw_type sample_type;
+    typedef fixed_complex<q15> complex_type;
+};
+
+template<>
+struct fft_types<q31> {
+    typedef q31::raw_type sample_type;
+    typedef fixed_complex<q31> complex_type;
+};
+
+/* Iterative in-place Cooley-Tukey FFT
+ * The input is permuted into bit-reversed order once and the butterflies are then computed stage by stage in place,
+ * so no memory is allocated per transform. Two radix-2 stages are fused into a single radix-4 pass wherever possible,
+ * which halves the number of passes over the data and replaces one twiddle multiplication by a multiplication with -j.
+ * Bit-reversal indices and twiddle factors are computed once by init() and stored contiguously: the twiddles for the
+ * stage of size m live at [m/2-1, m-1) in the table, so the butterfly loop reads them with unit stride.
+ */
+template<typename T>
+class basic_fft_engine {
+
+public:
+    typedef typename fft_types<T>::complex_type c_d;
+
+    basic_fft_engine() = default;
+    explicit basic_fft_engine(size_t N) { init(N); }
+
+    // Precompute bit-reversal permutation and twiddle factors for an N-point transform (N must be a power of two)
+    void init(size_t N);
+
+    // Forward N-point transform of x, computed in place; x holds X / 2^shifts on return
+    int transform(c_d* x) const;
+
+    size_t size() const { return numPoints; }
+
+private:
+    size_t numPoints = 0;
+    size_t numStages = 0;
+    cow_ptr<std::vector<uint32_t>> bitrev;     // shared by copies of the engine
+    cow_ptr<std::vector<c_d>> twiddle;
+};
+
+/* Real-input FFT
+ * A real frame of N samples is packed into N/2 complex values z[n] = x[2n] + j*x[2n+1], transformed with an N/2-point
+ * complex FFT and split into the N/2+1 non-redundant bins of the real spectrum:
+ * X[k] = (Z[k] + Z*[N/2-k])/2 - j*W[k]*(Z[k] - Z*[N/2-k])/2, where W[k] = exp(-2*pi*j*k/N).
+ * This does half the work of transforming the zero-imaginary frame with an N-point complex FFT.
+ */
+template<typename T>
+class basic_real_fft {
+
+public:
+    typedef typename fft_types<T>::sample_type sample_type;
+    typedef typename fft_types<T>::complex_type c_d;
+
+    basic_real_fft() = default;
+    explicit basic_real_fft(size_t N) { init(N); }
+
+    // Precompute tables for an N-point real transform (N must be a power of two, at least 2)
+    void init(size_t N);
+
+    // Transform N real samples into N/2+1 complex bins X / 2^shifts, and return shifts
+    int transform(const sample_type* in, c_d* out);
+
+    size_t size() const { return numPoints; }
+
+private:
+    size_t numPoints = 0;
+    basic_fft_engine<T> half;
+    cow_ptr<std::vector<c_d>> split;           // shared by copies of the engine
+    std::vector<c_d> work;
+};
+
+typedef basic_fft_engine<double> fft_engine;
+typedef basic_real_fft<double> real_fft;
+
+#endif // FFT_H
@@ -0,0 +1,46 @@
+#ifndef FIXEDPOINT_H
+#define FIXEDPOINT_H
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+/* Q15 and Q31 fixed-point formats
+ * A Qn number stores the value x as the signed integer round(x * 2^n), so Q15 covers [-1, 1) in an int16_t and Q31
+ * covers [-1, 1) in an int32_t. The tag types below only name a format for the templates of the pipeline, the data
+ * itself is kept in the raw integer type. Products are formed in int64_t and rounded back, which maps to a single
+ * SMULL on the Cortex-A9 for both formats.
+ */
+struct q15 {
+    typedef int16_t raw_type;
+    static const int fracBits = 15;
+};
+
+struct q31 {
+    typedef int32_t raw_type;
+    static const int fracBits = 31;
+};
+
+template<typename Q>
+struct fixed_complex {
+    typename Q::raw_type re, im;
+};
+
+// Convert a double to Qn with rounding and saturation
+template<typename Q>
+typename Q::raw_type toFixed(double x) {
+    typedef typename Q::raw_type raw_type;
+    double v = std::round(std::ldexp(x, Q::fracBits));
+    if (v >= double(std::numeric_limits<raw_type>::max()))
+        return std::numeric_limits<raw_type>::max();
+    if (v <= double(std::numeric_limits<raw_type>::min()))
+        return std::numeric_limits<raw_type>::min();
+    return raw_type(v);
+}
+
+// Round and shift a wide intermediate right by n bits
+inline int64_t roundShift(int64_t x, int n) {
+    return (x + (int64_t(1) << (n-1))) >> n;
+}
+
+#endif // FIXEDPOINT_H
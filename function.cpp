@@ -1,6 +1,190 @@
+#include "function.h"
+
 #include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <functional>
 #include <iostream>
+#include <new>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+#ifdef ALLOCATION_HOOK
+
+namespace {
+
+std::atomic<std::size_t> allocations{0};
+std::atomic<std::size_t> allocatedBytes{0};
+
+}
+
+/* Global operator new that counts its calls and the bytes requested, so a benchmark can tell how much a piece of code
+ * allocates. The array and nothrow forms of the library call these.
+ */
+void* operator new(std::size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+    while (true) {
+        if (void* p = std::malloc(size ? size : 1))
+            return p;
+        std::new_handler handler = std::get_new_handler();
+        if (!handler)
+            throw std::bad_alloc();
+        handler();
+    }
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+bool allocationCountingEnabled() {
+    return true;
+}
+
+std::size_t allocationCount() {
+    return allocations.load(std::memory_order_relaxed);
+}
+
+allocation_stats allocationStats() {
+    return {allocations.load(std::memory_order_relaxed), allocatedBytes.load(std::memory_order_relaxed)};
+}
+
+#else
+
+bool allocationCountingEnabled() {
+    return false;
+}
+
+std::size_t allocationCount() {
+    return 0;
+}
+
+allocation_stats allocationStats() {
+    return {0, 0};
+}
+
+#endif // ALLOCATION_HOOK
+
+std::size_t peakResidentBytes() {
+#if defined(__unix__) || defined(__APPLE__)
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+#ifdef __APPLE__
+    return std::size_t(usage.ru_maxrss);           // bytes
+#else
+    return std::size_t(usage.ru_maxrss) * 1024;    // kilobytes
+#endif
+#else
+    return 0;
+#endif
+}
+
+#ifdef __linux__
+
+namespace {
+
+int openCounter(std::uint64_t config, int groupLeader) {
+    struct perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = config;
+    attr.disabled = groupLeader < 0 ? 1 : 0;   // the group starts and stops with its leader
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return int(syscall(__NR_perf_event_open, &attr, 0, -1, groupLeader, 0)); // this thread, any CPU
+}
+
+}
+
+perf_counters::perf_counters() {
+    leader = openCounter(PERF_COUNT_HW_INSTRUCTIONS, -1);
+    if (leader < 0)
+        return;
+    misses = openCounter(PERF_COUNT_HW_CACHE_MISSES, leader);
+    if (misses < 0) {
+        close(leader);
+        leader = -1;
+    }
+}
+
+perf_counters::~perf_counters() {
+    if (misses >= 0)
+        close(misses);
+    if (leader >= 0)
+        close(leader);
+}
+
+void perf_counters::start() {
+    counts[0] = counts[1] = 0;
+    if (leader < 0)
+        return;
+    ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+void perf_counters::stop() {
+    if (leader < 0)
+        return;
+    ioctl(leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+    // nr, time enabled, time running, one value per counter of the group
+    std::uint64_t values[5] = {};
+    if (read(leader, values, sizeof(values)) != ssize_t(sizeof(values)) || values[0] != 2)
+        return;
+    const double scale = values[2] > 0 ? double(values[1]) / values[2] : 0;
+    counts[0] = std::uint64_t(values[3] * scale + 0.5);
+    counts[1] = std::uint64_t(values[4] * scale + 0.5);
+}
+
+#else
+
+perf_counters::perf_counters() {}
+perf_counters::~perf_counters() {}
+void perf_counters::start() {}
+void perf_counters::stop() {}
+
+#endif
+
+void printSample(std::ostream& out, const char* label, const performance_sample& sample) {
+    char text[256];
+    int n = std::snprintf(text, sizeof(text), " %s: %.10f sec", label, sample.seconds);
+    if (sample.hasAllocations) {
+        n += std::snprintf(text + n, sizeof(text) - n, ", %zu allocations (%zu bytes)", sample.allocations,
+                           sample.bytes);
+    } else {
+        n += std::snprintf(text + n, sizeof(text) - n, ", allocations n/a");
+    }
+    if (sample.hasPeakRss)
+        n += std::snprintf(text + n, sizeof(text) - n, ", peak RSS +%.2f MB", sample.peakRssGrowth / 1048576.0);
+    else
+        n += std::snprintf(text + n, sizeof(text) - n, ", peak RSS n/a");
+    if (sample.hasCounters) {
+        std::snprintf(text + n, sizeof(text) - n, ", %llu instructions, %llu cache misses",
+                      static_cast<unsigned long long>(sample.instructions),
+                      static_cast<unsigned long long>(sample.cacheMisses));
+    } else {
+        std::snprintf(text + n, sizeof(text) - n, ", hardware counters n/a");
+    }
+    out << text << std::endl;
+}
 
 // function object
 class GreaterLength {
@@ -2,32 +2,130 @@
 #define FUNCTION_H
 
 #include <chrono>
+#include <cstddef>
+#include <cstdint>
 #include <forward_list>
 #include <iomanip>
 #include <iostream>
 #include <list>
 #include <map>
+#include <new>
+#include <string>
 #include <type_traits>
 #include <unordered_map>
 #include <vector>
 
+/* Allocation counting hook
+ * Built with ALLOCATION_HOOK, function.cpp replaces the global operator new with one that counts the calls and the
+ * bytes requested. The counters are shared by all threads, so every allocation of the program pays for two atomic
+ * additions on one cache line: only the bench defines it, the application keeps the allocator of the library.
+ */
+struct allocation_stats {
+    std::size_t count;
+    std::size_t bytes;
+};
+
+// Whether the replacement operator new is built in, the counts stay zero otherwise
+bool allocationCountingEnabled();
+// Calls of the global operator new so far
+std::size_t allocationCount();
+// Calls and bytes requested so far
+allocation_stats allocationStats();
+
+// Peak resident set size of the process in bytes, 0 where the system does not report it
+std::size_t peakResidentBytes();
+
+/* Hardware counters of the calling thread, through Linux perf_event_open: instructions retired and last-level cache
+ * misses, in user space only. Where perf is not available (other systems, kernel.perf_event_paranoid, a container
+ * without the system call, a CPU without the events) available() is false and the counts read as zero. If the kernel
+ * had to multiplex the counters with other users, the counts are scaled to the whole time they were enabled.
+ */
+class perf_counters {
+
+public:
+    perf_counters();
+    ~perf_counters();
+    perf_counters(const perf_counters&) = delete;
+    perf_counters& operator=(const perf_counters&) = delete;
+
+    bool available() const { return leader >= 0; }
+
+    // Reset the counters and start counting
+    void start();
+    // Stop counting and read the counts since start()
+    void stop();
+
+    std::uint64_t instructions() const { return counts[0]; }
+    std::uint64_t cacheMisses() const { return counts[1]; }
+
+private:
+    int leader = -1;                // instructions, the group leader
+    int misses = -1;
+    std::uint64_t counts[2] = {};
+};
+
+// Cost of one operation; allocations, peak RSS and hardware counters only where they could be measured
+struct performance_sample {
+    double seconds = 0;
+    bool hasAllocations = false;
+    std::size_t allocations = 0;
+    std::size_t bytes = 0;              // requested from operator new
+    bool hasPeakRss = false;
+    std::size_t peakRssGrowth = 0;      // bytes the peak resident set size of the process grew by
+    bool hasCounters = false;
+    std::uint64_t instructions = 0;
+    std::uint64_t cacheMisses = 0;
+};
+
+// Time operation() and count what it allocates, the instructions it retires and its cache misses
+template<typename F>
+performance_sample measureOperation(F&& operation) {
+    performance_sample sample;
+    perf_counters counters;
+    const std::size_t peakBefore = peakResidentBytes();
+    const allocation_stats allocationsBefore = allocationStats();
+
+    counters.start();
+    const auto start = std::chrono::steady_clock::now();
+    operation();
+    const auto end = std::chrono::steady_clock::now();
+    counters.stop();
+
+    const allocation_stats allocationsAfter = allocationStats();
+    const std::size_t peakAfter = peakResidentBytes();
+    sample.seconds = std::chrono::duration<double>(end - start).count();
+    sample.hasAllocations = allocationCountingEnabled();
+    sample.allocations = allocationsAfter.count - allocationsBefore.count;
+    sample.bytes = allocationsAfter.bytes - allocationsBefore.bytes;
+    sample.hasPeakRss = peakAfter != 0;
+    sample.peakRssGrowth = peakAfter - peakBefore;
+    sample.hasCounters = counters.available();
+    sample.instructions = counters.instructions();
+    sample.cacheMisses = counters.cacheMisses();
+    return sample;
+}
+
+// One line: label, time and whatever else the sample holds
+void printSample(std::ostream& out, const char* label, const performance_sample& sample);
+
+/* measure performance template
+ * Copy of t, then move out of t, each reported with its time, the allocations and bytes it requested, how much it grew
+ * the peak resident set size of the process (zero when an earlier peak was higher), and the instructions and cache
+ * misses of the thread. The copy and the moved-to container are destroyed after both are measured.
+ */
 template<typename T>
 void measurePerformance(T& t, const std::string& cont) {
-    // measure performance template
-    std::cout << std::fixed << std::setprecision(10);
-
-    auto start = std::chrono::system_clock::now();
-    T t1(t);
-    auto end = std::chrono::system_clock::now() - start;
+    typename std::aligned_storage<sizeof(T), alignof(T)>::type copyStorage, moveStorage;
     std::cout << cont << std::endl;
-    auto copyTime = std::chrono::duration<double>(end).count();
-    std::cout <<  " Copy: " << copyTime << " sec" << std::endl;
-
-    start = std::chrono::system_clock::now();
-    T t2(std::move(t));
-    end = std::chrono::system_clock::now() - start;
-    auto moveTime = std::chrono::duration<double>(end).count();
-    std::cout <<  " Move: " << moveTime << " sec" << std::endl;
+
+    const performance_sample copy = measureOperation([&]() { new (&copyStorage) T(t); });
+    printSample(std::cout, "Copy", copy);
+
+    const performance_sample move = measureOperation([&]() { new (&moveStorage) T(std::move(t)); });
+    printSample(std::cout, "Move", move);
+
+    reinterpret_cast<T*>(&copyStorage)->~T();
+    reinterpret_cast<T*>(&moveStorage)->~T();
 }
 
 // The function can also be written in such a way that it will accept any time duration unit.
@@ -0,0 +1,12 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <cstddef>
+#include <cstdint>
+
+/* XXH64 (Yann Collet, xxHash), the 64-bit non-cryptographic hash of the reference implementation
+ * Hashes several GB/s per core, fast enough to key caches by the content of whole recordings.
+ */
+uint64_t xxh64(const void* data, size_t size, uint64_t seed = 0);
+
+#endif // HASH_H
@@ -0,0 +1,622 @@
+#include "kernels.h"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define KERNELS_X86
+#endif
+
+#if defined(__aarch64__) || defined(__arm__)
+#include <asm/hwcap.h>
+#include <sys/auxv.h>
+#define KERNELS_NEON
+#endif
+
+namespace {
+
+// _________________________________________________________________________________________________________________
+// Scalar reference kernels
+
+template<typename T>
+void preEmphWindowScalar(const T* x, const T* win, T coef, T* out, size_t n) {
+    if (n == 0)
+        return;
+    out[0] = win[0] * x[0];
+    for (size_t i=1; i<n; i++)
+        out[i] = win[i] * (x[i] - coef * x[i-1]);
+}
+
+template<typename T>
+void powerSpectrumScalar(const std::complex<T>* X, T* out, size_t n) {
+    for (size_t i=0; i<n; i++)
+        out[i] = X[i].real() * X[i].real() + X[i].imag() * X[i].imag();
+}
+
+template<typename T>
+T dotScalar(const T* a, const T* b, size_t n) {
+    T sum = 0;
+    for (size_t i=0; i<n; i++)
+        sum += a[i] * b[i];
+    return sum;
+}
+
+template<typename T>
+void matVecScalar(const T* A, const T* x, T* y, size_t rows, size_t cols) {
+    for (size_t r=0; r<rows; r++)
+        y[r] = dotScalar(A + r*cols, x, cols);
+}
+
+template<typename T>
+void gemmTileScalar(const T* a, const T* b, size_t k, T* c) {
+    T acc[4][4] = {};
+    for (size_t p=0; p<k; p++, a+=4, b+=4)
+        for (size_t r=0; r<4; r++)
+            for (size_t j=0; j<4; j++)
+                acc[r][j] += a[r] * b[j];
+    for (size_t r=0; r<4; r++)
+        for (size_t j=0; j<4; j++)
+            c[r*4 + j] = acc[r][j];
+}
+
+template<typename T>
+const basic_dsp_kernels<T> scalarKernels = {"scalar", preEmphWindowScalar<T>, powerSpectrumScalar<T>, dotScalar<T>, matVecScalar<T>,
+                                            4, 4, gemmTileScalar<T>};
+
+#ifdef KERNELS_X86
+// _________________________________________________________________________________________________________________
+// SSE2 kernels, two doubles or four floats per register
+
+__attribute__((target("sse2")))
+void preEmphWindowSse2(const double* x, const double* win, double coef, double* out, size_t n) {
+    if (n == 0)
+        return;
+    out[0] = win[0] * x[0];
+    const __m128d c = _mm_set1_pd(coef);
+    size_t i = 1;
+    for (; i+2<=n; i+=2) {
+        __m128d d = _mm_sub_pd(_mm_loadu_pd(x + i), _mm_mul_pd(c, _mm_loadu_pd(x + i - 1)));
+        _mm_storeu_pd(out + i, _mm_mul_pd(_mm_loadu_pd(win + i), d));
+    }
+    for (; i<n; i++)
+        out[i] = win[i] * (x[i] - coef * x[i-1]);
+}
+
+__attribute__((target("sse2")))
+void powerSpectrumSse2(const std::complex<double>* X, double* out, size_t n) {
+    const double* p = reinterpret_cast<const double*>(X);
+    size_t i = 0;
+    for (; i+2<=n; i+=2) {
+        __m128d a = _mm_loadu_pd(p + 2*i);
+        __m128d b = _mm_loadu_pd(p + 2*i + 2);
+        a = _mm_mul_pd(a, a);
+        b = _mm_mul_pd(b, b);
+        _mm_storeu_pd(out + i, _mm_add_pd(_mm_unpacklo_pd(a, b), _mm_unpackhi_pd(a, b)));
+    }
+    for (; i<n; i++)
+        out[i] = X[i].real() * X[i].real() + X[i].imag() * X[i].imag();
+}
+
+__attribute__((target("sse2")))
+double dotSse2(const double* a, const double* b, size_t n) {
+    __m128d acc0 = _mm_setzero_pd(), acc1 = _mm_setzero_pd();
+    size_t i = 0;
+    for (; i+4<=n; i+=4) {
+        acc0 = _mm_add_pd(acc0, _mm_mul_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+        acc1 = _mm_add_pd(acc1, _mm_mul_pd(_mm_loadu_pd(a + i + 2), _mm_loadu_pd(b + i + 2)));
+    }
+    acc0 = _mm_add_pd(acc0, acc1);
+    double sum = _mm_cvtsd_f64(_mm_add_sd(acc0, _mm_unpackhi_pd(acc0, acc0)));
+    for (; i<n; i++)
+        sum += a[i] * b[i];
+    return sum;
+}
+
+__attribute__((target("sse2")))
+void matVecSse2(const double* A, const double* x, double* y, size_t rows, size_t cols) {
+    for (size_t r=0; r<rows; r++)
+        y[r] = dotSse2(A + r*cols, x, cols);
+}
+
+__attribute__((target("sse2")))
+void preEmphWindowSse2(const float* x, const float* win, float coef, float* out, size_t n) {
+    if (n == 0)
+        return;
+    out[0] = win[0] * x[0];
+    const __m128 c = _mm_set1_ps(coef);
+    size_t i = 1;
+    for (; i+4<=n; i+=4) {
+        __m128 d = _mm_sub_ps(_mm_loadu_ps(x + i), _mm_mul_ps(c, _mm_loadu_ps(x + i - 1)));
+        _mm_storeu_ps(out + i, _mm_mul_ps(_mm_loadu_ps(win + i), d));
+    }
+    for (; i<n; i++)
+        out[i] = win[i] * (x[i] - coef * x[i-1]);
+}
+
+__attribute__((target("sse2")))
+void powerSpectrumSse2(const std::complex<float>* X, float* out, size_t n) {
+    const float* p = reinterpret_cast<const float*>(X);
+    size_t i = 0;
+    for (; i+4<=n; i+=4) {
+        __m128 a = _mm_loadu_ps(p + 2*i);
+        __m128 b = _mm_loadu_ps(p + 2*i + 4);
+        a = _mm_mul_ps(a, a);
+        b = _mm_mul_ps(b, b);
+        __m128 re = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+        __m128 im = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+        _mm_storeu_ps(out + i, _mm_add_ps(re, im));
+    }
+    for (; i<n; i++)
+        out[i] = X[i].real() * X[i].real() + X[i].imag() * X[i].imag();
+}
+
+__attribute__((target("sse2")))
+float dotSse2(const float* a, const float* b, size_t n) {
+    __m128 acc0 = _mm_setzero_ps(), acc1 = _mm_setzero_ps();
+    size_t i = 0;
+    for (; i+8<=n; i+=8) {
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+    }
+    acc0 = _mm_add_ps(acc0, acc1);
+    acc0 = _mm_add_ps(acc0, _mm_movehl_ps(acc0, acc0));
+    float sum = _mm_cvtss_f32(_mm_add_ss(acc0, _mm_shuffle_ps(acc0, acc0, 1)));
+    for (; i<n; i++)
+        sum += a[i] * b[i];
+    return sum;
+}
+
+__attribute__((target("sse2")))
+void matVecSse2(const float* A, const float* x, float* y, size_t rows, size_t cols) {
+    for (size_t r=0; r<rows; r++)
+        y[r] = dotSse2(A + r*cols, x, cols);
+}
+
+// 4x4 tile, row r accumulates columns 0-1 in c<r>0 and 2-3 in c<r>1
+__attribute__((target("sse2")))
+void gemmTileSse2(const double* a, const double* b, size_t k, double* c) {
+    __m128d c00 = _mm_setzero_pd(), c01 = _mm_setzero_pd(), c10 = _mm_setzero_pd(), c11 = _mm_setzero_pd();
+    __m128d c20 = _mm_setzero_pd(), c21 = _mm_setzero_pd(), c30 = _mm_setzero_pd(), c31 = _mm_setzero_pd();
+    for (size_t p=0; p<k; p++, a+=4, b+=4) {
+        __m128d b0 = _mm_loadu_pd(b), b1 = _mm_loadu_pd(b + 2);
+        __m128d a0 = _mm_set1_pd(a[0]), a1 = _mm_set1_pd(a[1]), a2 = _mm_set1_pd(a[2]), a3 = _mm_set1_pd(a[3]);
+        c00 = _mm_add_pd(c00, _mm_mul_pd(a0, b0)); c01 = _mm_add_pd(c01, _mm_mul_pd(a0, b1));
+        c10 = _mm_add_pd(c10, _mm_mul_pd(a1, b0)); c11 = _mm_add_pd(c11, _mm_mul_pd(a1, b1));
+        c20 = _mm_add_pd(c20, _mm_mul_pd(a2, b0)); c21 = _mm_add_pd(c21, _mm_mul_pd(a2, b1));
+        c30 = _mm_add_pd(c30, _mm_mul_pd(a3, b0)); c31 = _mm_add_pd(c31, _mm_mul_pd(a3, b1));
+    }
+    _mm_storeu_pd(c, c00); _mm_storeu_pd(c + 2, c01);
+    _mm_storeu_pd(c + 4, c10); _mm_storeu_pd(c + 6, c11);
+    _mm_storeu_pd(c + 8, c20); _mm_storeu_pd(c + 10, c21);
+    _mm_storeu_pd(c + 12, c30); _mm_storeu_pd(c + 14, c31);
+}
+
+// 4x8 tile
+__attribute__((target("sse2")))
+void gemmTileSse2(const float* a, const float* b, size_t k, float* c) {
+    __m128 c00 = _mm_setzero_ps(), c01 = _mm_setzero_ps(), c10 = _mm_setzero_ps(), c11 = _mm_setzero_ps();
+    __m128 c20 = _mm_setzero_ps(), c21 = _mm_setzero_ps(), c30 = _mm_setzero_ps(), c31 = _mm_setzero_ps();
+    for (size_t p=0; p<k; p++, a+=4, b+=8) {
+        __m128 b0 = _mm_loadu_ps(b), b1 = _mm_loadu_ps(b + 4);
+        __m128 a0 = _mm_set1_ps(a[0]), a1 = _mm_set1_ps(a[1]), a2 = _mm_set1_ps(a[2]), a3 = _mm_set1_ps(a[3]);
+        c00 = _mm_add_ps(c00, _mm_mul_ps(a0, b0)); c01 = _mm_add_ps(c01, _mm_mul_ps(a0, b1));
+        c10 = _mm_add_ps(c10, _mm_mul_ps(a1, b0)); c11 = _mm_add_ps(c11, _mm_mul_ps(a1, b1));
+        c20 = _mm_add_ps(c20, _mm_mul_ps(a2, b0)); c21 = _mm_add_ps(c21, _mm_mul_ps(a2, b1));
+        c30 = _mm_add_ps(c30, _mm_mul_ps(a3, b0)); c31 = _mm_add_ps(c31, _mm_mul_ps(a3, b1));
+    }
+    _mm_storeu_ps(c, c00); _mm_storeu_ps(c + 4, c01);
+    _mm_storeu_ps(c + 8, c10); _mm_storeu_ps(c + 12, c11);
+    _mm_storeu_ps(c + 16, c20); _mm_storeu_ps(c + 20, c21);
+    _mm_storeu_ps(c + 24, c30); _mm_storeu_ps(c + 28, c31);
+}
+
+template<typename T>
+const basic_dsp_kernels<T> sse2Kernels = {"sse2", preEmphWindowSse2, powerSpectrumSse2, dotSse2, matVecSse2,
+                                          4, 16 / sizeof(T) * 2, gemmTileSse2};
+
+// _________________________________________________________________________________________________________________
+// AVX2 kernels, four doubles or eight floats per register and fused multiply-add
+
+__attribute__((target("avx2,fma")))
+void preEmphWindowAvx2(const double* x, const double* win, double coef, double* out, size_t n) {
+    if (n == 0)
+        return;
+    out[0] = win[0] * x[0];
+    const __m256d c = _mm256_set1_pd(-coef);
+    size_t i = 1;
+    for (; i+4<=n; i+=4) {
+        __m256d d = _mm256_fmadd_pd(c, _mm256_loadu_pd(x + i - 1), _mm256_loadu_pd(x + i));
+        _mm256_storeu_pd(out + i, _mm256_mul_pd(_mm256_loadu_pd(win + i), d));
+    }
+    for (; i<n; i++)
+        out[i] = win[i] * (x[i] - coef * x[i-1]);
+}
+
+__attribute__((target("avx2,fma")))
+void powerSpectrumAvx2(const std::complex<double>* X, double* out, size_t n) {
+    const double* p = reinterpret_cast<const double*>(X);
+    size_t i = 0;
+    for (; i+4<=n; i+=4) {
+        __m256d a = _mm256_loadu_pd(p + 2*i);
+        __m256d b = _mm256_loadu_pd(p + 2*i + 4);
+        // hadd yields bins in the order 0, 2, 1, 3
+        __m256d s = _mm256_hadd_pd(_mm256_mul_pd(a, a), _mm256_mul_pd(b, b));
+        _mm256_storeu_pd(out + i, _mm256_permute4x64_pd(s, 0xD8));
+    }
+    for (; i<n; i++)
+        out[i] = X[i].real() * X[i].real() + X[i].imag() * X[i].imag();
+}
+
+__attribute__((target("avx2,fma")))
+double dotAvx2(const double* a, const double* b, size_t n) {
+    __m256d acc0 = _mm256_setzero_pd(), acc1 = _mm256_setzero_pd();
+    size_t i = 0;
+    for (; i+8<=n; i+=8) {
+        acc0 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i), acc0);
+        acc1 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i + 4), _mm256_loadu_pd(b + i + 4), acc1);
+    }
+    for (; i+4<=n; i+=4)
+        acc0 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i), acc0);
+    acc0 = _mm256_add_pd(acc0, acc1);
+    __m128d s = _mm_add_pd(_mm256_castpd256_pd128(acc0), _mm256_extractf128_pd(acc0, 1));
+    double sum = _mm_cvtsd_f64(_mm_add_sd(s, _mm_unpackhi_pd(s, s)));
+    for (; i<n; i++)
+        sum += a[i] * b[i];
+    return sum;
+}
+
+__attribute__((target("avx2,fma")))
+void matVecAvx2(const double* A, const double* x, double* y, size_t rows, size_t cols) {
+    for (size_t r=0; r<rows; r++)
+        y[r] = dotAvx2(A + r*cols, x, cols);
+}
+
+__attribute__((target("avx2,fma")))
+void preEmphWindowAvx2(const float* x, const float* win, float coef, float* out, size_t n) {
+    if (n == 0)
+        return;
+    out[0] = win[0] * x[0];
+    const __m256 c = _mm256_set1_ps(-coef);
+    size_t i = 1;
+    for (; i+8<=n; i+=8) {
+        __m256 d = _mm256_fmadd_ps(c, _mm256_loadu_ps(x + i - 1), _mm256_loadu_ps(x + i));
+        _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_loadu_ps(win + i), d));
+    }
+    for (; i<n; i++)
+        out[i] = win[i] * (x[i] - coef * x[i-1]);
+}
+
+__attribute__((target("avx2,fma")))
+void powerSpectrumAvx2(const std::complex<float>* X, float* out, size_t n) {
+    const float* p = reinterpret_cast<const float*>(X);
+    size_t i = 0;
+    for (; i+8<=n; i+=8) {
+        __m256 a = _mm256_loadu_ps(p + 2*i);
+        __m256 b = _mm256_loadu_ps(p + 2*i + 8);
+        a = _mm256_mul_ps(a, a);
+        b = _mm256_mul_ps(b, b);
+        // in-lane shuffles yield bins in the 64-bit order 0-1, 4-5, 2-3, 6-7
+        __m256 s = _mm256_add_ps(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)), _mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+        _mm256_storeu_ps(out + i, _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(s), 0xD8)));
+    }
+    for (; i<n; i++)
+        out[i] = X[i].real() * X[i].real() + X[i].imag() * X[i].imag();
+}
+
+__attribute__((target("avx2,fma")))
+float dotAvx2(const float* a, const float* b, size_t n) {
+    __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i+16<=n; i+=16) {
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+        acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), acc1);
+    }
+    for (; i+8<=n; i+=8)
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+    acc0 = _mm256_add_ps(acc0, acc1);
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(acc0), _mm256_extractf128_ps(acc0, 1));
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    float sum = _mm_cvtss_f32(_mm_add_ss(s, _mm_shuffle_ps(s, s, 1)));
+    for (; i<n; i++)
+        sum += a[i] * b[i];
+    return sum;
+}
+
+__attribute__((target("avx2,fma")))
+void matVecAvx2(const float* A, const float* x, float* y, size_t rows, size_t cols) {
+    for (size_t r=0; r<rows; r++)
+        y[r] = dotAvx2(A + r*cols, x, cols);
+}
+
+// 4x8 tile, row r accumulates columns 0-3 in c<r>0 and 4-7 in c<r>1
+__attribute__((target("avx2,fma")))
+void gemmTileAvx2(const double* a, const double* b, size_t k, double* c) {
+    __m256d c00 = _mm256_setzero_pd(), c01 = _mm256_setzero_pd(), c10 = _mm256_setzero_pd(), c11 = _mm256_setzero_pd();
+    __m256d c20 = _mm256_setzero_pd(), c21 = _mm256_setzero_pd(), c30 = _mm256_setzero_pd(), c31 = _mm256_setzero_pd();
+    for (size_t p=0; p<k; p++, a+=4, b+=8) {
+        __m256d b0 = _mm256_loadu_pd(b), b1 = _mm256_loadu_pd(b + 4);
+        __m256d a0 = _mm256_broadcast_sd(a), a1 = _mm256_broadcast_sd(a + 1);
+        c00 = _mm256_fmadd_pd(a0, b0, c00); c01 = _mm256_fmadd_pd(a0, b1, c01);
+        c10 = _mm256_fmadd_pd(a1, b0, c10); c11 = _mm256_fmadd_pd(a1, b1, c11);
+        __m256d a2 = _mm256_broadcast_sd(a + 2), a3 = _mm256_broadcast_sd(a + 3);
+        c20 = _mm256_fmadd_pd(a2, b0, c20); c21 = _mm256_fmadd_pd(a2, b1, c21);
+        c30 = _mm256_fmadd_pd(a3, b0, c30); c31 = _mm256_fmadd_pd(a3, b1, c31);
+    }
+    _mm256_storeu_pd(c, c00); _mm256_storeu_pd(c + 4, c01);
+    _mm256_storeu_pd(c + 8, c10); _mm256_storeu_pd(c + 12, c11);
+    _mm256_storeu_pd(c + 16, c20); _mm256_storeu_pd(c + 20, c21);
+    _mm256_storeu_pd(c + 24, c30); _mm256_storeu_pd(c + 28, c31);
+}
+
+// 4x16 tile
+__attribute__((target("avx2,fma")))
+void gemmTileAvx2(const float* a, const float* b, size_t k, float* c) {
+    __m256 c00 = _mm256_setzero_ps(), c01 = _mm256_setzero_ps(), c10 = _mm256_setzero_ps(), c11 = _mm256_setzero_ps();
+    __m256 c20 = _mm256_setzero_ps(), c21 = _mm256_setzero_ps(), c30 = _mm256_setzero_ps(), c31 = _mm256_setzero_ps();
+    for (size_t p=0; p<k; p++, a+=4, b+=16) {
+        __m256 b0 = _mm256_loadu_ps(b), b1 = _mm256_loadu_ps(b + 8);
+        __m256 a0 = _mm256_broadcast_ss(a), a1 = _mm256_broadcast_ss(a + 1);
+        c00 = _mm256_fmadd_ps(a0, b0, c00); c01 = _mm256_fmadd_ps(a0, b1, c01);
+        c10 = _mm256_fmadd_ps(a1, b0, c10); c11 = _mm256_fmadd_ps(a1, b1, c11);
+        __m256 a2 = _mm256_broadcast_ss(a + 2), a3 = _mm256_broadcast_ss(a + 3);
+        c20 = _mm256_fmadd_ps(a2, b0, c20); c21 = _mm256_fmadd_ps(a2, b1, c21);
+        c30 = _mm256_fmadd_ps(a3, b0, c30); c31 = _mm256_fmadd_ps(a3, b1, c31);
+    }
+    _mm256_storeu_ps(c, c00); _mm256_storeu_ps(c + 8, c01);
+    _mm256_storeu_ps(c + 16, c10); _mm256_storeu_ps(c + 24, c11);
+    _mm256_storeu_ps(c + 32, c20); _mm256_storeu_ps(c + 40, c21);
+    _mm256_storeu_ps(c + 48, c30); _mm256_storeu_ps(c + 56, c31);
+}
+
+template<typename T>
+const basic_dsp_kernels<T> avx2Kernels = {"avx2", preEmphWindowAvx2, powerSpectrumAvx2, dotAvx2, matVecAvx2,
+                                          4, 32 / sizeof(T) * 2, gemmTileAvx2};
+
+bool hasSse2() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse2");
+}
+
+bool hasAvx2() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+}
+#endif // KERNELS_X86
+
+#ifdef KERNELS_NEON
+}
+
+/* ARMv7 builds for a VFP-only baseline: NEON is enabled for the intrinsics and the kernels below only, so that the
+ * scalar kernels and the dispatch stay free of NEON instructions and run on CPUs without it
+ */
+#if defined(__arm__)
+#pragma GCC push_options
+#pragma GCC target("fpu=neon")
+#endif
+#include <arm_neon.h>
+
+namespace {
+
+// _________________________________________________________________________________________________________________
+// NEON kernels, four floats per register (ARMv7 and AArch64) or two doubles per register (AArch64 only)
+
+void preEmphWindowNeon(const float* x, const float* win, float coef, float* out, size_t n) {
+    if (n == 0)
+        return;
+    out[0] = win[0] * x[0];
+    const float32x4_t c = vdupq_n_f32(coef);
+    size_t i = 1;
+    for (; i+4<=n; i+=4) {
+        float32x4_t d = vmlsq_f32(vld1q_f32(x + i), c, vld1q_f32(x + i - 1));
+        vst1q_f32(out + i, vmulq_f32(vld1q_f32(win + i), d));
+    }
+    for (; i<n; i++)
+        out[i] = win[i] * (x[i] - coef * x[i-1]);
+}
+
+void powerSpectrumNeon(const std::complex<float>* X, float* out, size_t n) {
+    const float* p = reinterpret_cast<const float*>(X);
+    size_t i = 0;
+    for (; i+4<=n; i+=4) {
+        float32x4x2_t c = vld2q_f32(p + 2*i); // de-interleave real and imaginary parts
+        vst1q_f32(out + i, vmlaq_f32(vmulq_f32(c.val[0], c.val[0]), c.val[1], c.val[1]));
+    }
+    for (; i<n; i++)
+        out[i] = X[i].real() * X[i].real() + X[i].imag() * X[i].imag();
+}
+
+float dotNeon(const float* a, const float* b, size_t n) {
+    float32x4_t acc0 = vdupq_n_f32(0.0f), acc1 = vdupq_n_f32(0.0f);
+    size_t i = 0;
+    for (; i+8<=n; i+=8) {
+        acc0 = vmlaq_f32(acc0, vld1q_f32(a + i), vld1q_f32(b + i));
+        acc1 = vmlaq_f32(acc1, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+    }
+    acc0 = vaddq_f32(acc0, acc1);
+    float32x2_t s = vadd_f32(vget_low_f32(acc0), vget_high_f32(acc0));
+    s = vpadd_f32(s, s);
+    float sum = vget_lane_f32(s, 0);
+    for (; i<n; i++)
+        sum += a[i] * b[i];
+    return sum;
+}
+
+void matVecNeon(const float* A, const float* x, float* y, size_t rows, size_t cols) {
+    for (size_t r=0; r<rows; r++)
+        y[r] = dotNeon(A + r*cols, x, cols);
+}
+
+// 4x8 tile, row r accumulates columns 0-3 in c<r>0 and 4-7 in c<r>1
+void gemmTileNeon(const float* a, const float* b, size_t k, float* c) {
+    float32x4_t c00 = vdupq_n_f32(0.0f), c01 = c00, c10 = c00, c11 = c00, c20 = c00, c21 = c00, c30 = c00, c31 = c00;
+    for (size_t p=0; p<k; p++, a+=4, b+=8) {
+        float32x4_t b0 = vld1q_f32(b), b1 = vld1q_f32(b + 4);
+        float32x4_t av = vld1q_f32(a);
+        float32x2_t alo = vget_low_f32(av), ahi = vget_high_f32(av);
+        c00 = vmlaq_lane_f32(c00, b0, alo, 0); c01 = vmlaq_lane_f32(c01, b1, alo, 0);
+        c10 = vmlaq_lane_f32(c10, b0, alo, 1); c11 = vmlaq_lane_f32(c11, b1, alo, 1);
+        c20 = vmlaq_lane_f32(c20, b0, ahi, 0); c21 = vmlaq_lane_f32(c21, b1, ahi, 0);
+        c30 = vmlaq_lane_f32(c30, b0, ahi, 1); c31 = vmlaq_lane_f32(c31, b1, ahi, 1);
+    }
+    vst1q_f32(c, c00); vst1q_f32(c + 4, c01);
+    vst1q_f32(c + 8, c10); vst1q_f32(c + 12, c11);
+    vst1q_f32(c + 16, c20); vst1q_f32(c + 20, c21);
+    vst1q_f32(c + 24, c30); vst1q_f32(c + 28, c31);
+}
+
+const basic_dsp_kernels<float> neonKernelsFloat = {"neon", preEmphWindowNeon, powerSpectrumNeon, dotNeon, matVecNeon,
+                                                   4, 8, gemmTileNeon};
+
+#if defined(__aarch64__)
+void preEmphWindowNeon(const double* x, const double* win, double coef, double* out, size_t n) {
+    if (n == 0)
+        return;
+    out[0] = win[0] * x[0];
+    const float64x2_t c = vdupq_n_f64(-coef);
+    size_t i = 1;
+    for (; i+2<=n; i+=2) {
+        float64x2_t d = vfmaq_f64(vld1q_f64(x + i), c, vld1q_f64(x + i - 1));
+        vst1q_f64(out + i, vmulq_f64(vld1q_f64(win + i), d));
+    }
+    for (; i<n; i++)
+        out[i] = win[i] * (x[i] - coef * x[i-1]);
+}
+
+void powerSpectrumNeon(const std::complex<double>* X, double* out, size_t n) {
+    const double* p = reinterpret_cast<const double*>(X);
+    size_t i = 0;
+    for (; i+2<=n; i+=2) {
+        float64x2x2_t c = vld2q_f64(p + 2*i); // de-interleave real and imaginary parts
+        vst1q_f64(out + i, vfmaq_f64(vmulq_f64(c.val[0], c.val[0]), c.val[1], c.val[1]));
+    }
+    for (; i<n; i++)
+        out[i] = X[i].real() * X[i].real() + X[i].imag() * X[i].imag();
+}
+
+double dotNeon(const double* a, const double* b, size_t n) {
+    float64x2_t acc0 = vdupq_n_f64(0.0), acc1 = vdupq_n_f64(0.0);
+    size_t i = 0;
+    for (; i+4<=n; i+=4) {
+        acc0 = vfmaq_f64(acc0, vld1q_f64(a + i), vld1q_f64(b + i));
+        acc1 = vfmaq_f64(acc1, vld1q_f64(a + i + 2), vld1q_f64(b + i + 2));
+    }
+    double sum = vaddvq_f64(vaddq_f64(acc0, acc1));
+    for (; i<n; i++)
+        sum += a[i] * b[i];
+    return sum;
+}
+
+void matVecNeon(const double* A, const double* x, double* y, size_t rows, size_t cols) {
+    for (size_t r=0; r<rows; r++)
+        y[r] = dotNeon(A + r*cols, x, cols);
+}
+
+// 4x4 tile
+void gemmTileNeon(const double* a, const double* b, size_t k, double* c) {
+    float64x2_t c00 = vdupq_n_f64(0.0), c01 = c00, c10 = c00, c11 = c00, c20 = c00, c21 = c00, c30 = c00, c31 = c00;
+    for (size_t p=0; p<k; p++, a+=4, b+=4) {
+        float64x2_t b0 = vld1q_f64(b), b1 = vld1q_f64(b + 2);
+        float64x2_t a01 = vld1q_f64(a), a23 = vld1q_f64(a + 2);
+        c00 = vfmaq_laneq_f64(c00, b0, a01, 0); c01 = vfmaq_laneq_f64(c01, b1, a01, 0);
+        c10 = vfmaq_laneq_f64(c10, b0, a01, 1); c11 = vfmaq_laneq_f64(c11, b1, a01, 1);
+        c20 = vfmaq_laneq_f64(c20, b0, a23, 0); c21 = vfmaq_laneq_f64(c21, b1, a23, 0);
+        c30 = vfmaq_laneq_f64(c30, b0, a23, 1); c31 = vfmaq_laneq_f64(c31, b1, a23, 1);
+    }
+    vst1q_f64(c, c00); vst1q_f64(c + 2, c01);
+    vst1q_f64(c + 4, c10); vst1q_f64(c + 6, c11);
+    vst1q_f64(c + 8, c20); vst1q_f64(c + 10, c21);
+    vst1q_f64(c + 12, c30); vst1q_f64(c + 14, c31);
+}
+
+const basic_dsp_kernels<double> neonKernelsDouble = {"neon", preEmphWindowNeon, powerSpectrumNeon, dotNeon, matVecNeon,
+                                                     4, 4, gemmTileNeon};
+#endif // __aarch64__
+}
+
+#if defined(__arm__)
+#pragma GCC pop_options
+#endif
+
+namespace {
+
+bool hasNeon() {
+#if defined(__aarch64__)
+    return getauxval(AT_HWCAP) & HWCAP_ASIMD;
+#else
+    return getauxval(AT_HWCAP) & HWCAP_NEON;
+#endif
+}
+#endif // KERNELS_NEON
+
+template<typename T>
+const basic_dsp_kernels<T>* neonKernels();
+
+template<>
+const basic_dsp_kernels<float>* neonKernels<float>() {
+#ifdef KERNELS_NEON
+    if (hasNeon())
+        return &neonKernelsFloat;
+#endif
+    return nullptr;
+}
+
+template<>
+const basic_dsp_kernels<double>* neonKernels<double>() {
+#if defined(KERNELS_NEON) && defined(__aarch64__)
+    if (hasNeon())
+        return &neonKernelsDouble;
+#endif
+    return nullptr;
+}
+
+template<typename T>
+const basic_dsp_kernels<T>& selectKernels() {
+#ifdef KERNELS_X86
+    if (hasAvx2())
+        return avx2Kernels<T>;
+    if (hasSse2())
+        return sse2Kernels<T>;
+#endif
+    if (const basic_dsp_kernels<T>* neon = neonKernels<T>())
+        return *neon;
+    return scalarKernels<T>;
+}
+
+template<typename T>
+const basic_dsp_kernels<T>* findKernelsByName(const char* name) {
+    if (std::strcmp(name, "scalar") == 0)
+        return &scalarKernels<T>;
+#ifdef KERNELS_X86
+    if (std::strcmp(name, "sse2") == 0 && hasSse2())
+        return &sse2Kernels<T>;
+    if (std::strcmp(name, "avx2") == 0 && hasAvx2())
+        return &avx2Kernels<T>;
+#endif
+    if (std::strcmp(name, "neon") == 0)
+        return neonKernels<T>();
+    return nullptr;
+}
+
+}
+
+template<>
+const basic_dsp_kernels<double>& kernels<double>() {
+    static const basic_dsp_kernels<double>& selected = selectKernels<double>(); // thread-safe initialisation on first use
+    return selected;
+}
+
+template<>
+const basic_dsp_kernels<float>& kernels<float>() {
+    static const basic_dsp_kernels<float>& selected = selectKernels<float>();
+    return selected;
+}
+
+template<>
+const basic_dsp_kernels<double>* findKernels<double>(const char* name) {
+    return findKernelsByName<double>(name);
+}
+
+template<>
+const basic_dsp_kernels<float>* findKernels<float>(const char* name) {
+    return findKernelsByName<float>(name);
+}
@@ -0,0 +1,53 @@
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include <complex>
+#include <cstddef>
+
+/* Per-frame DSP kernels with runtime dispatch
+ * Every stage of the MFCC pipeline is available as a scalar reference kernel and as vectorized variants for the
+ * instruction sets we deploy on (SSE2 and AVX2+FMA on x86, NEON on ARM). The vectorized variants are compiled with
+ * per-function target attributes, so the binary runs on any CPU of its architecture and the best supported table
+ * is picked once, on first use, from the features the CPU reports at runtime. Tables exist for double and float;
+ * ARMv7 NEON has no double-precision lanes, so on the Cortex-A9 only the float table is vectorized.
+ */
+template<typename T>
+struct basic_dsp_kernels {
+    const char* name;
+
+    // Pre-emphasis and window: out[0] = win[0]*x[0], out[i] = win[i]*(x[i] - coef*x[i-1])
+    void (*preEmphWindow)(const T* x, const T* win, T coef, T* out, size_t n);
+
+    // Power spectrum: out[i] = re(X[i])^2 + im(X[i])^2
+    void (*powerSpectrum)(const std::complex<T>* X, T* out, size_t n);
+
+    // Dot product of two vectors of length n
+    T (*dot)(const T* a, const T* b, size_t n);
+
+    // Matrix-vector product y = A*x, A is row-major with rows x cols elements
+    void (*matVec)(const T* A, const T* x, T* y, size_t rows, size_t cols);
+
+    /* Register tile of a matrix product: c[r*tileCols + j] = sum over p<k of a[p*tileRows + r] * b[p*tileCols + j].
+     * a and b are panels packed k-major (tileRows and tileCols values per step), c is overwritten. The tile is sized
+     * to keep all accumulators in registers: two vectors per row of tileRows = 4 rows.
+     */
+    size_t tileRows, tileCols;
+    void (*gemmTile)(const T* a, const T* b, size_t k, T* c);
+};
+
+typedef basic_dsp_kernels<double> dsp_kernels;
+
+// Kernels selected for the running CPU
+template<typename T = double>
+const basic_dsp_kernels<T>& kernels();
+
+// Kernels by name ("scalar", "sse2", "avx2", "neon"), or nullptr if they are not supported by the running CPU
+template<typename T = double>
+const basic_dsp_kernels<T>* findKernels(const char* name);
+
+template<> const basic_dsp_kernels<double>& kernels<double>();
+template<> const basic_dsp_kernels<float>& kernels<float>();
+template<> const basic_dsp_kernels<double>* findKernels<double>(const char* name);
+template<> const basic_dsp_kernels<float>* findKernels<float>(const char* name);
+
+#endif // KERNELS_H
@@ -0,0 +1,144 @@
+#include "melfilterbank.h"
+#include "kernels.h"
+
+#include <cmath>
+
+namespace {
+
+template<typename P>
+typename mel_types<P>::weight_type toWeight(double w) {
+    return typename mel_types<P>::weight_type(std::round(std::ldexp(w, mel_types<P>::weightFracBits)));
+}
+
+template<>
+double toWeight<double>(double w) {
+    return w;
+}
+
+template<>
+float toWeight<float>(double w) {
+    return float(w);
+}
+
+}
+
+template<typename P>
+double basic_mel_filterbank<P>::Hz2Mel(double f) {
+    return 2595*std::log10(1 + f/700);
+}
+
+template<typename P>
+double basic_mel_filterbank<P>::Mel2Hz(double m) {
+    return 700*(std::pow(10, m/2595) - 1);
+}
+
+template<typename P>
+void basic_mel_filterbank<P>::init(size_t fs, size_t numFFT, size_t numFilters, double lowFreq, double highFreq) {
+    numFFTBins = numFFT / 2 + 1;
+
+    // Convert low and high frequencies to Mel scale
+    double lowFreqMel = Hz2Mel(lowFreq);
+    double highFreqMel = Hz2Mel(highFreq);
+
+    // Calculate filter centre-frequencies
+    std::vector<double> filterCentreFreq;
+    filterCentreFreq.reserve(numFilters+2);
+    for (size_t i=0; i<numFilters+2; i++)
+        filterCentreFreq.push_back(Mel2Hz(lowFreqMel + (highFreqMel-lowFreqMel)/(numFilters+1)*i));
+
+    // Calculate FFT bin frequencies
+    std::vector<double> fftBinFreq;
+    fftBinFreq.reserve(numFFTBins);
+    for (size_t i=0; i<numFFTBins; i++)
+        fftBinFreq.push_back(fs/2.0/(numFFTBins-1)*i);
+
+    // A new table, copies of the filterbank keep sharing the old one
+    filter_table& table = filters.reset();
+    std::vector<band>& bands = table.bands;
+    std::vector<weight_type>& weights = table.weights;
+    bands.reserve(numFilters);
+
+    // Populate the filters, keeping only the weights between the first and the last non-zero bin
+    std::vector<double> ftemp(numFFTBins);
+    for (size_t filt=1; filt<=numFilters; filt++) {
+        for (size_t bin=0; bin<numFFTBins; bin++) {
+            double weight;
+            if (fftBinFreq[bin] < filterCentreFreq[filt-1])
+                weight = 0;
+            else if (fftBinFreq[bin] <= filterCentreFreq[filt])
+                weight = (fftBinFreq[bin] - filterCentreFreq[filt-1]) / (filterCentreFreq[filt] - filterCentreFreq[filt-1]);
+            else if (fftBinFreq[bin] <= filterCentreFreq[filt+1])
+                weight = (filterCentreFreq[filt+1] - fftBinFreq[bin]) / (filterCentreFreq[filt+1] - filterCentreFreq[filt]);
+            else
+                weight = 0;
+            ftemp[bin] = weight;
+        }
+
+        size_t first = 0, last = numFFTBins;
+        while (first < numFFTBins && ftemp[first] == 0)
+            first++;
+        while (last > first && ftemp[last-1] == 0)
+            last--;
+
+        // A filter narrower than the bin spacing may have no non-zero weight at all, keep a single zero weight
+        if (first == last) {
+            size_t bin = first < numFFTBins ? first : numFFTBins-1;
+            bands.push_back({bin, bin, weights.size()});
+            weights.push_back(0);
+            continue;
+        }
+
+        bands.push_back({first, last-1, weights.size()});
+        for (size_t bin=first; bin<last; bin++)
+            weights.push_back(toWeight<P>(ftemp[bin]));
+    }
+}
+
+template<typename P>
+void basic_mel_filterbank<P>::apply(const P* spectrum, acc_type* out) const {
+    const std::vector<band>& bands = filters->bands;
+    const std::vector<weight_type>& weights = filters->weights;
+    for (size_t i=0; i<bands.size(); i++) {
+        const band& b = bands[i];
+        const weight_type* w = weights.data() + b.offset;
+        acc_type sum = 0;
+        for (size_t k=b.first; k<=b.last; k++)
+            sum += acc_type(spectrum[k] >> mel_types<P>::shift) * *w++;
+        out[i] = sum;
+    }
+}
+
+template<>
+void basic_mel_filterbank<double>::apply(const double* spectrum, double* out) const {
+    const basic_dsp_kernels<double>& simd = kernels<double>();
+    const std::vector<band>& bands = filters->bands;
+    const std::vector<weight_type>& weights = filters->weights;
+    for (size_t i=0; i<bands.size(); i++) {
+        const band& b = bands[i];
+        out[i] = simd.dot(weights.data() + b.offset, spectrum + b.first, b.last - b.first + 1);
+    }
+}
+
+template<>
+void basic_mel_filterbank<float>::apply(const float* spectrum, float* out) const {
+    const basic_dsp_kernels<float>& simd = kernels<float>();
+    const std::vector<band>& bands = filters->bands;
+    const std::vector<weight_type>& weights = filters->weights;
+    for (size_t i=0; i<bands.size(); i++) {
+        const band& b = bands[i];
+        out[i] = simd.dot(weights.data() + b.offset, spectrum + b.first, b.last - b.first + 1);
+    }
+}
+
+template<typename P>
+double basic_mel_filterbank<P>::weight(size_t i, size_t k) const {
+    const band& b = filters->bands[i];
+    if (k < b.first || k > b.last)
+        return 0;
+    return std::ldexp(double(filters->weights[b.offset + k - b.first]), -mel_types<P>::weightFracBits);
+}
+
+template class basic_mel_filterbank<double>;
+template class basic_mel_filterbank<float>;
+template class basic_mel_filterbank<uint32_t>;
+template class basic_mel_filterbank<uint64_t>;
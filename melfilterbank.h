@@ -0,0 +1,101 @@
+#ifndef MELFILTERBANK_H
+#define MELFILTERBANK_H
+
+#include "cowptr.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/* Data types of the filterbank for each spectrum type
+ * Floating-point spectra are weighted in their own type. Fixed-point power spectra (uint32_t from the Q15 pipeline,
+ * uint64_t from the Q31 pipeline) are weighted with Q15 weights and accumulated in uint64_t; the Q31 power is shifted
+ * right by 16 bits first so that the accumulator cannot overflow.
+ */
+template<typename P>
+struct mel_types {
+    typedef P weight_type;
+    typedef P acc_type;
+    static const int weightFracBits = 0;
+    static const int shift = 0;
+};
+
+template<>
+struct mel_types<uint32_t> {
+    typedef uint16_t weight_type;
+    typedef uint64_t acc_type;
+    static const int weightFracBits = 15;
+    static const int shift = 0;
+};
+
+template<>
+struct mel_types<uint64_t> {
+    typedef uint16_t weight_type;
+    typedef uint64_t acc_type;
+    static const int weightFracBits = 15;
+    static const int shift = 16;
+};
+
+/* Banded Mel filterbank
+ * Each triangular filter is non-zero only between the centre frequencies of its two neighbours, which is a handful of
+ * FFT bins out of numFFT/2+1. Instead of a dense numFilters x numFFTBins matrix, every filter keeps its first and last
+ * non-zero bin and its weights packed back to back in one array, and apply() multiplies only that band of the power
+ * spectrum. The filterbank does not depend on the rest of the MFCC pipeline and can be used on any power or magnitude
+ * spectrum with numFFT/2+1 bins.
+ */
+template<typename P>
+class basic_mel_filterbank {
+
+public:
+    typedef typename mel_types<P>::weight_type weight_type;
+    typedef typename mel_types<P>::acc_type acc_type;
+
+    // Non-zero bins [first, last] of one filter, with weights stored at [offset, offset + last - first]
+    struct band {
+        size_t first;
+        size_t last;
+        size_t offset;
+    };
+
+    basic_mel_filterbank() = default;
+    basic_mel_filterbank(size_t fs, size_t numFFT, size_t numFilters, double lowFreq, double highFreq) {
+        init(fs, numFFT, numFilters, lowFreq, highFreq);
+    }
+
+    // Build numFilters triangular filters equally spaced on the Mel scale between lowFreq and highFreq (Hertz)
+    void init(size_t fs, size_t numFFT, size_t numFilters, double lowFreq, double highFreq);
+
+    // Filter energies: out[i] = sum of weights of filter i times the spectrum bins of its band
+    void apply(const P* spectrum, acc_type* out) const;
+
+    // Weight of filter i at bin k (zero outside the band)
+    double weight(size_t i, size_t k) const;
+
+    size_t numFilters() const { return filters->bands.size(); }
+    size_t numBins() const { return numFFTBins; }
+    size_t numWeights() const { return filters->weights.size(); }
+    const band& filter(size_t i) const { return filters->bands[i]; }
+    const weight_type* filterWeights(size_t i) const { return filters->weights.data() + filters->bands[i].offset; }
+
+    // Hertz to Mel conversion
+    static double Hz2Mel(double f);
+
+    // Mel to Hertz conversion
+    static double Mel2Hz(double m);
+
+private:
+    struct filter_table {
+        std::vector<band> bands;
+        std::vector<weight_type> weights;
+    };
+
+    size_t numFFTBins = 0;
+    cow_ptr<filter_table> filters;      // immutable once built, shared by copies of the filterbank
+};
+
+template<> void basic_mel_filterbank<double>::apply(const double* spectrum, double* out) const;
+template<> void basic_mel_filterbank<float>::apply(const float* spectrum, float* out) const;
+
+typedef basic_mel_filterbank<double> mel_filterbank;
+
+#endif // MELFILTERBANK_H
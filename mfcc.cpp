@@ -0,0 +1,222 @@
+#include "mfcc.h"
+#include "kernels.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <type_traits>
+
+namespace {
+
+// Conversion of window and pre-emphasis coefficients into the sample type
+template<typename T>
+struct coefficient {
+    static typename mfcc_types<T>::sample_type from(double x) { return typename mfcc_types<T>::sample_type(x); }
+};
+
+template<>
+struct coefficient<q15> {
+    static int16_t from(double x) { return toFixed<q15>(x); }
+};
+
+template<>
+struct coefficient<q31> {
+    static int32_t from(double x) { return toFixed<q31>(x); }
+};
+
+/* Pre-emphasis and Hamming window
+ * Floating-point frames take the PCM values as they are and run the vectorized kernel, and return 0. Fixed-point
+ * frames are normalized first: the samples are shifted left by the returned number of bits so that the peak of the
+ * frame uses the full 16-bit range, then y = w*(x - c*x')/4 is computed with x = s/2^15 in int64_t. The two bits of
+ * headroom keep |y| < 1/2, which the real-input FFT needs to stay in range.
+ */
+template<typename T>
+int preEmphWindow(const int16_t* samples, T* frame, const T* win, T coef, T* out, size_t n, std::true_type) {
+    for (size_t i=0; i<n; i++)
+        frame[i] = samples[i];
+    kernels<T>().preEmphWindow(frame, win, coef, out, n);
+    return 0;
+}
+
+template<typename R>
+int preEmphWindow(const int16_t* samples, R*, const R* win, R coef, R* out, size_t n, std::false_type) {
+    const int F = std::is_same<R, int16_t>::value ? q15::fracBits : q31::fracBits;
+
+    int peak = 0;
+    for (size_t i=0; i<n; i++)
+        peak = std::max(peak, std::abs(int(samples[i])));
+    int norm = 0;
+    while (peak != 0 && (peak << (norm+1)) <= 32767)
+        norm++;
+
+    for (size_t i=0; i<n; i++) {
+        // Scaled by multiplication, a left shift of a negative value is undefined
+        int64_t diff = int64_t(samples[i]) * (int64_t(1) << (F + norm));    // Q(F+15)
+        if (i > 0)
+            diff -= int64_t(coef) * samples[i-1] * (int64_t(1) << norm);
+        int64_t d = roundShift(diff, 17);                   // QF of the quartered difference
+        out[i] = R(roundShift(int64_t(win[i]) * d, F));
+    }
+    return norm;
+}
+
+// Power spectrum computation
+template<typename T>
+void powerSpectrum(const std::complex<T>* X, T* out, size_t n) {
+    kernels<T>().powerSpectrum(X, out, n);
+}
+
+template<typename Q, typename P>
+void powerSpectrum(const fixed_complex<Q>* X, P* out, size_t n) {
+    for (size_t i=0; i<n; i++)
+        out[i] = P(int64_t(X[i].re) * X[i].re + int64_t(X[i].im) * X[i].im);
+}
+
+}
+
+template<typename T>
+void mfcc_pipeline<T>::init(const mfcc_config& config) {
+    cfg = config;
+    winWidthSamples = cfg.winWidth * cfg.fs / 1000;
+    frameShiftSamples = cfg.frameShift * cfg.fs / 1000;
+    numFFTBins = cfg.numFFT / 2 + 1;
+
+    // The frame is cut (or zero-padded) to numFFT samples for the FFT, so only that part is windowed
+    numWindowed = std::min(winWidthSamples, cfg.numFFT);
+    frame.assign(numWindowed, 0);
+    procFrame.assign(cfg.numFFT, 0);
+    powerSpectralCoef.assign(numFFTBins, 0);
+    fbEnergy.assign(cfg.numFilters, 0);
+    lmfbCoef.assign(cfg.numFilters, 0);
+    preEmphCoef = coefficient<T>::from(cfg.preEmphCoef);
+
+    initFilterbank();
+    initHammingDct();
+    compTwiddle();
+}
+
+template<typename T>
+void mfcc_pipeline<T>::compute(const int16_t* samples, real_type* mfcc) {
+    stage_timer timer;
+    preEmphHamming(samples);
+    timer.lap(pipeline_stage::preEmphHamming);
+    compPowerSpec(timer);
+    applyLogMelFilterbank();
+    timer.lap(pipeline_stage::filterbank);
+    applyDct(mfcc);
+    timer.lap(pipeline_stage::dct);
+}
+
+/* Pre-emphasis and Hamming window
+ * The first step is to apply a pre-emphasis filter on the signal to amplify the high frequencies.
+ * A pre-emphasis filter is useful in several ways: (1) balance the frequency spectrum since high frequencies
+ * usually have smaller magnitudes compared to lower frequencies, (2) avoid numerical problems during the
+ * Fourier transform operation and (3) may also improve the Signal-to-Noise Ratio (SNR).
+ * The pre-emphasis filter can be applied to a signal x using the first order filter in the following equation: y(t)=x(t)−αx(t−1).
+ */
+template<typename T>
+void mfcc_pipeline<T>::preEmphHamming(const int16_t* samples) {
+    frameNorm = preEmphWindow(samples, frame.data(), hamming->data(), preEmphCoef, procFrame.data(), numWindowed,
+                              typename std::is_floating_point<T>::type());
+}
+
+/* Power spectrum computation
+ * After pre-emphasis, we need to split the signal into short-time frames. We can safely assume that frequencies in a signal
+ * are stationary over a very short period of time. Therefore, by doing a Fourier transform over this short-time frame,
+ * we can obtain a good approximation of the frequency contours of the signal by concatenating adjacent frames.
+ *
+ * We can now do an N-point FFT on each frame to calculate the frequency spectrum, which is also called Short-Time
+ * Fourier-Transform, where N is typically 256 or 512, numFFT = 512 in this case; and then compute the power spectrum (periodogram)
+ * using the following equation: P=|FFT(xi)|^2 where, xi is the ith frame of signal x.
+ */
+template<typename T>
+void mfcc_pipeline<T>::compPowerSpec(stage_timer& timer) {
+    int fftShifts = fftEngine.transform(procFrame.data(), spectrum.data()); // procFrame stays zero past numWindowed
+    timer.lap(pipeline_stage::fft);
+    powerSpectrum(spectrum.data(), powerSpectralCoef.data(), numFFTBins);
+
+    // Fixed-point spectra are X * 2^(norm - 17 - fftShifts) of the PCM spectrum, undo it on the filterbank energies
+    if (!std::is_floating_point<T>::value)
+        energyScale = real_type(std::ldexp(1.0, energyBits + 2 * (fftShifts - frameNorm)));
+    timer.lap(pipeline_stage::powerSpectrum);
+}
+
+/* Applying log Mel filterbank
+ * The final step to computing filter banks is applying triangular filters, typically 40 filters, numFilters = 40 on a Mel-scale
+ * to the power spectrum to extract frequency bands. The Mel-scale aims to mimic the non-linear human ear perception of sound,
+ * by being more discriminative at lower frequencies and less discriminative at higher frequencies.
+ */
+template<typename T>
+void mfcc_pipeline<T>::applyLogMelFilterbank(void) {
+    // Multiply the band of the power spectrum under each filter
+    fbank.apply(powerSpectralCoef.data(), fbEnergy.data());
+
+    for (size_t i=0; i<cfg.numFilters; i++) {
+        // Undo the fixed-point scaling of this frame and apply Mel-flooring
+        real_type e = real_type(fbEnergy[i]) * energyScale;
+        if (e < 1)
+            e = 1;
+        // Applying log on amplitude
+        lmfbCoef[i] = std::log(e);
+    }
+}
+
+/* Computing discrete cosine transform
+ * It turns out that filter bank coefficients computed in the previous step are highly correlated, which could be
+ * problematic in some machine learning algorithms. Therefore, we can apply Discrete Cosine Transform (DCT)
+ * to decorrelate the filter bank coefficients and yield a compressed representation of the filter banks. Typically,
+ * for Automatic Speech Recognition (ASR), the resulting cepstral coefficients 2-13 are retained and the rest are discarded.
+ */
+template<typename T>
+void mfcc_pipeline<T>::applyDct(real_type* mfcc) {
+    kernels<real_type>().matVec(dct->data(), lmfbCoef.data(), mfcc, cfg.numCepstral+1, cfg.numFilters);
+}
+
+// Precompute filterbank
+template<typename T>
+void mfcc_pipeline<T>::initFilterbank(void) {
+    fbank.init(cfg.fs, cfg.numFFT, cfg.numFilters, cfg.lowFreq, cfg.highFreq);
+}
+
+// Precompute Hamming window and dct matrix
+template<typename T>
+void mfcc_pipeline<T>::initHammingDct(void) {
+    size_t i, j;
+
+    // After slicing the signal into frames, we apply a window function such as the Hamming window to each frame.
+    std::vector<sample_type>& hamming = this->hamming.reset();
+    hamming.assign(numWindowed, 0);
+    for (i=0; i<numWindowed; i++)
+        hamming[i] = coefficient<T>::from(0.54 - 0.46 * cos(2 * PI * i / (winWidthSamples-1)));
+
+    std::vector<double> v1(cfg.numCepstral+1,0), v2(cfg.numFilters,0);
+    for (i=0; i <= cfg.numCepstral; i++)
+        v1[i] = i;
+    for (i=0; i < cfg.numFilters; i++)
+        v2[i] = i + 0.5;
+
+    std::vector<real_type>& dct = this->dct.reset();
+    dct.reserve(cfg.numFilters*(cfg.numCepstral+1));
+    double c = sqrt(2.0/cfg.numFilters);
+    for (i=0; i<=cfg.numCepstral; i++)
+        for (j=0; j<cfg.numFilters; j++)
+            dct.push_back(real_type(c * cos(PI / cfg.numFilters * v1[i] * v2[j])));
+}
+
+// Twiddle factor and bit-reversal computation for the real-input FFT
+template<typename T>
+void mfcc_pipeline<T>::compTwiddle(void) {
+    fftEngine.init(cfg.numFFT);
+    spectrum.assign(numFFTBins, complex_type());
+
+    // Fixed-point energies are in units of 2^-(2F - shift + weightFracBits) of a power spectrum that was scaled by
+    // 2^-17 (15 bits for the PCM range and two bits of headroom), before the per-frame normalization and FFT shifts
+    if (!std::is_floating_point<T>::value) {
+        const int F = std::is_same<sample_type, int16_t>::value ? q15::fracBits : q31::fracBits;
+        energyBits = 2 * 17 - (2*F - mel_types<power_type>::shift + mel_types<power_type>::weightFracBits);
+    }
+}
+
+template class mfcc_pipeline<double>;
+template class mfcc_pipeline<float>;
+template class mfcc_pipeline<q15>;
+template class mfcc_pipeline<q31>;
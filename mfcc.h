@@ -0,0 +1,135 @@
+#ifndef MFCC_H
+#define MFCC_H
+
+#include "cowptr.h"
+#include "fft.h"
+#include "fixedpoint.h"
+#include "melfilterbank.h"
+#include "profiler.h"
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// Analysis parameters of the MFCC pipeline
+struct mfcc_config {
+    size_t fs = 44100;                 // Sampling rate in Hertz (default=16000)
+    size_t numCepstral = 12;           // Number of output cepstra, excluding log-energy (default=12)
+    size_t numFilters = 40;            // Number of Mel warped filters in filterbank (default=40)
+    double preEmphCoef = 0.97;         // Pre-emphasis coefficient
+    double lowFreq = 50;               // Filterbank low frequency cutoff in Hertz (default=50)
+    double highFreq = 4000;            // Filterbank high freqency cutoff in Hertz (default=fs/2)
+    size_t numFFT = 512;               // N-point FFT on each frame
+    size_t winWidth = 25;              // Width of analysis window in milliseconds (default=25)
+    size_t frameShift = 10;            // Frame shift in milliseconds (default=10)
+};
+
+/* Data types of the pipeline stages for each numeric type
+ * sample_type: windowed frame and FFT, power_type: power spectrum and filterbank, real_type: log filterbank energies,
+ * DCT and MFCCs. The fixed-point pipelines run the front end up to the filterbank in integers and switch to float for
+ * the logarithm and everything after it, which the VFP of the Cortex-A9 handles at full speed.
+ */
+template<typename T>
+struct mfcc_types {
+    typedef T sample_type;
+    typedef T power_type;
+    typedef T real_type;
+};
+
+template<>
+struct mfcc_types<q15> {
+    typedef int16_t sample_type;
+    typedef uint32_t power_type;
+    typedef float real_type;
+};
+
+template<>
+struct mfcc_types<q31> {
+    typedef int32_t sample_type;
+    typedef uint64_t power_type;
+    typedef float real_type;
+};
+
+/* MFCC pipeline templated on its numeric type
+ * mfcc_pipeline<double> is the reference. mfcc_pipeline<float> runs every stage in single precision, which doubles the
+ * SIMD width on x86 and is the only type NEON vectorizes on the Cortex-A9. mfcc_pipeline<q15> and mfcc_pipeline<q31>
+ * normalize every frame to its peak, take it into Q15/Q31 with two bits of headroom and run a block-floating-point FFT
+ * that only scales the passes that could overflow; the scaling is undone exactly, as a power of two, before the
+ * Mel-flooring and the logarithm.
+ *
+ * Error against mfcc_pipeline<double>, measured on 10 s of 44.1 kHz music and on white noise at 0, -20 and -40 dBFS
+ * (maximum absolute error over all frames and coefficients, MFCC values range over roughly +-200):
+ *   float  MFCC < 2e-4     cosine distance < 1e-6
+ *   q31    MFCC < 2e-4     cosine distance < 5e-7
+ *   q15    MFCC < 2        cosine distance < 5e-3 (about 0.1 and 1e-4 on the music)
+ * Q15 keeps a 16-bit spectrum, so on broadband input the quiet bands next to loud ones lose most of their resolution;
+ * use Q31 for a fixed-point deployment that has to match the reference closely.
+ */
+template<typename T>
+class mfcc_pipeline {
+
+public:
+    typedef typename mfcc_types<T>::sample_type sample_type;
+    typedef typename mfcc_types<T>::power_type power_type;
+    typedef typename mfcc_types<T>::real_type real_type;
+    typedef typename fft_types<T>::complex_type complex_type;
+    typedef typename basic_mel_filterbank<power_type>::acc_type acc_type;
+
+    mfcc_pipeline() = default;
+    explicit mfcc_pipeline(const mfcc_config& config) { init(config); }
+
+    // Precompute window, filterbank, DCT matrix and FFT tables
+    void init(const mfcc_config& config);
+
+    // Compute numCoefficients() MFCCs of one frame of frameLength() PCM samples
+    void compute(const int16_t* samples, real_type* mfcc);
+
+    const mfcc_config& config() const { return cfg; }
+    size_t frameLength() const { return winWidthSamples; }
+    size_t frameShiftLength() const { return frameShiftSamples; }
+    size_t numCoefficients() const { return cfg.numCepstral + 1; }
+
+private:
+    const double PI = 4*atan(1.0);
+    mfcc_config cfg;
+    size_t winWidthSamples = 0, frameShiftSamples = 0, numFFTBins = 0, numWindowed = 0;
+    std::vector<sample_type> frame, procFrame;
+    cow_ptr<std::vector<sample_type>> hamming;     // tables shared by copies of the pipeline
+    std::vector<complex_type> spectrum;
+    std::vector<power_type> powerSpectralCoef;
+    std::vector<acc_type> fbEnergy;
+    std::vector<real_type> lmfbCoef;
+    cow_ptr<std::vector<real_type>> dct;
+    sample_type preEmphCoef = 0;
+    real_type energyScale = 1;
+    int energyBits = 0, frameNorm = 0;
+    basic_real_fft<T> fftEngine;
+    basic_mel_filterbank<power_type> fbank;
+
+    void preEmphHamming(const int16_t* samples);
+    void compPowerSpec(stage_timer& timer);
+    void applyLogMelFilterbank(void);
+    void applyDct(real_type* mfcc);
+
+    void initFilterbank(void);
+    void initHammingDct(void);
+    void compTwiddle(void);
+};
+
+// Calculate cosine similarity between two vectors of length n
+template<typename R>
+R cosine_similarity(const R* a, const R* b, size_t n) {
+    R multiply = 0;
+    R d_a = 0;
+    R d_b = 0;
+
+    for (size_t i=0; i<n; i++) {
+        multiply += a[i] * b[i];
+        d_a += a[i] * a[i];
+        d_b += b[i] * b[i];
+    }
+
+    return multiply / (std::sqrt(d_a) * std::sqrt(d_b));
+}
+
+#endif // MFCC_H
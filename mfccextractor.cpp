@@ -0,0 +1,64 @@
+#include "mfccextractor.h"
+
+namespace {
+
+// Frames per task of the offline extraction
+const size_t CHUNK_FRAMES = 64;
+
+}
+
+template<typename T>
+void mfcc_extractor<T>::init(const mfcc_config& config) {
+    pipeline.init(config);
+    ring.assign(2 * pipeline.frameLength(), 0);
+    mfcc.assign(pipeline.numCoefficients(), 0);
+    reset();
+}
+
+template<typename T>
+void mfcc_extractor<T>::reset() {
+    std::fill(ring.begin(), ring.end(), 0);
+    writePos = 0;
+    needed = pipeline.frameLength();
+    numFrames = 0;
+}
+
+template<typename T>
+size_t mfcc_extractor<T>::push(const int16_t* samples, size_t n, real_type* out) {
+    const size_t numCoef = pipeline.numCoefficients();
+    size_t count = 0;
+    push(samples, n, [out, numCoef, &count](size_t, const real_type* c) {
+        std::copy(c, c + numCoef, out + count * numCoef);
+        count++;
+    });
+    return count;
+}
+
+template<typename T>
+size_t mfcc_extractor<T>::pendingFrames(size_t n) const {
+    if (n < needed)
+        return 0;
+    return 1 + (n - needed) / pipeline.frameShiftLength();
+}
+
+template<typename T>
+void mfcc_extractor<T>::extract(const int16_t* samples, size_t n, feature_matrix<real_type>& out,
+                                task_system& pool) const {
+    const size_t L = pipeline.frameLength(), shift = pipeline.frameShiftLength();
+    const size_t frames = n < L ? 0 : 1 + (n - L) / shift;
+    out.resize(frames, pipeline.numCoefficients());
+
+    // Frame k covers samples [k*shift, k*shift + L), chunks overlap by L - shift samples but write disjoint rows
+    const mfcc_pipeline<T>& prototype = pipeline;
+    parallel_for(pool, (frames + CHUNK_FRAMES - 1) / CHUNK_FRAMES, [&prototype]() { return prototype; },
+                 [samples, frames, shift, &out](size_t chunk, mfcc_pipeline<T>& stages) {
+        const size_t end = std::min(frames, (chunk + 1) * CHUNK_FRAMES);
+        for (size_t k=chunk*CHUNK_FRAMES; k<end; k++)
+            stages.compute(samples + k * shift, out.row(k));
+    });
+}
+
+template class mfcc_extractor<double>;
+template class mfcc_extractor<float>;
+template class mfcc_extractor<q15>;
+template class mfcc_extractor<q31>;
@@ -0,0 +1,107 @@
+#ifndef MFCCEXTRACTOR_H
+#define MFCCEXTRACTOR_H
+
+#include "featurematrix.h"
+#include "mfcc.h"
+#include "task.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+/* Streaming MFCC extractor
+ * Accepts 16-bit PCM in blocks of any length and emits one vector of MFCCs every frame shift, as soon as the frame
+ * that ends there is complete. Frame k covers samples [k*frameShiftLength(), k*frameShiftLength() + frameLength()).
+ *
+ * The last frameLength() samples are kept in a ring buffer whose storage is mirrored: every sample is written at
+ * position p and p + frameLength(), so the frame that starts at the oldest sample is always contiguous and is handed
+ * to the pipeline in place. All buffers are sized by init(); push() does not allocate.
+ */
+template<typename T>
+class mfcc_extractor {
+
+public:
+    typedef typename mfcc_pipeline<T>::real_type real_type;
+
+    mfcc_extractor() = default;
+    explicit mfcc_extractor(const mfcc_config& config) { init(config); }
+
+    // Set up the pipeline and the ring buffer, and start a new stream
+    void init(const mfcc_config& config);
+
+    // Drop buffered samples and start a new stream with the same configuration
+    void reset();
+
+    /* Push n samples and call sink(frameIndex, mfcc) for every completed frame, where mfcc points to
+     * numCoefficients() values that are only valid during the call.
+     */
+    template<typename Sink>
+    void push(const int16_t* samples, size_t n, Sink&& sink) {
+        while (n > 0) {
+            size_t chunk = std::min(n, needed);
+            stage_timer timer;
+            write(samples, chunk);
+            timer.lap(pipeline_stage::framing);
+            samples += chunk;
+            n -= chunk;
+            needed -= chunk;
+            if (needed == 0) {
+                pipeline.compute(ring.data() + writePos, mfcc.data());
+                sink(static_cast<size_t>(numFrames), static_cast<const real_type*>(mfcc.data()));
+                numFrames++;
+                needed = pipeline.frameShiftLength();
+            }
+        }
+    }
+
+    /* Push n samples and write the completed frames to out, numCoefficients() values per frame. out must have room for
+     * pendingFrames(n) frames; returns the number of frames written.
+     */
+    size_t push(const int16_t* samples, size_t n, real_type* out);
+
+    // Number of frames that pushing n more samples will complete
+    size_t pendingFrames(size_t n) const;
+
+    /* Offline analysis of a whole signal: out gets the MFCCs of every frame of the n samples, bitwise identical to
+     * pushing them after reset(). A frame depends on nothing but its own samples, so chunks of frames are computed on
+     * the workers of pool and on the calling thread, each with a copy of the pipeline for its scratch buffers (the
+     * tables are shared), straight from samples into out. The stream of push() is left alone.
+     */
+    void extract(const int16_t* samples, size_t n, feature_matrix<real_type>& out, task_system& pool) const;
+
+    size_t numCoefficients() const { return pipeline.numCoefficients(); }
+    size_t frameLength() const { return pipeline.frameLength(); }
+    size_t frameShiftLength() const { return pipeline.frameShiftLength(); }
+    uint64_t frameCount() const { return numFrames; }
+    const mfcc_pipeline<T>& stages() const { return pipeline; }
+
+private:
+    mfcc_pipeline<T> pipeline;
+    std::vector<int16_t> ring;      // 2 * frameLength(), second half mirrors the first
+    std::vector<real_type> mfcc;
+    size_t writePos = 0;            // next write position, also the oldest sample of the frame
+    size_t needed = 0;              // samples still missing to complete the next frame
+    uint64_t numFrames = 0;
+
+    // Append n samples to the ring buffer (both halves)
+    void write(const int16_t* samples, size_t n) {
+        const size_t L = pipeline.frameLength();
+        // Only the last L samples of a long block can be part of a frame
+        if (n > L) {
+            samples += n - L;
+            writePos = (writePos + n - L) % L;
+            n = L;
+        }
+        while (n > 0) {
+            size_t chunk = std::min(n, L - writePos);
+            std::memcpy(&ring[writePos], samples, chunk * sizeof(int16_t));
+            std::memcpy(&ring[writePos + L], samples, chunk * sizeof(int16_t));
+            samples += chunk;
+            n -= chunk;
+            writePos = (writePos + chunk) % L;
+        }
+    }
+};
+
+#endif // MFCCEXTRACTOR_H
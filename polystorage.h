@@ -0,0 +1,288 @@
+#ifndef POLYSTORAGE_H
+#define POLYSTORAGE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/* Storage for type-erased values without virtual functions
+ * A type-erased wrapper keeps a pointer to a table of functions for the type it holds, a manual vtable, and calls them
+ * with a pointer to the object. Every table starts with the lifetime_table of the type, the functions to copy, move and
+ * destroy an object of it; the wrapper adds the functions of its interface. One table exists per type and interface,
+ * and the object carries no vptr of its own.
+ *
+ * small_value keeps the object in Size bytes of its own when it fits and moves without throwing, and on the heap
+ * otherwise, so wrapping a small type costs no allocation. poly_vector keeps objects of different types one after the
+ * other in one buffer, each at its own alignment, so a loop over them walks memory in order instead of chasing a
+ * pointer per element.
+ *
+ * The price of inline storage is paid when values move: moving a small_value moves the object through its table,
+ * where a wrapper around a pointer swaps the pointer. Containers that reorder a lot (reverse, sort, rotate) get slower,
+ * reversing a document of small_values took about 9x as long as one of shared_ptr models in the bench (33 ns against
+ * 3.7 ns per element). Use small_value where values are made and called much more often than they are moved.
+ */
+
+// Lifetime functions of a type, the common first member of every manual vtable
+struct lifetime_table {
+    std::size_t size;
+    std::size_t alignment;
+    bool nothrowMove;
+    void (*copy)(const void* from, void* to);   // copy-construct at to
+    void (*move)(void* from, void* to);         // move-construct at to
+    void (*destroy)(void* object);
+};
+
+template<typename T>
+struct lifetime_functions {
+    static void copy(const void* from, void* to) { new (to) T(*static_cast<const T*>(from)); }
+    static void move(void* from, void* to) { new (to) T(std::move(*static_cast<T*>(from))); }
+    static void destroy(void* object) { static_cast<T*>(object)->~T(); }
+};
+
+template<typename T>
+constexpr lifetime_table lifetimeOf() {
+    static_assert(alignof(T) <= alignof(std::max_align_t), "over-aligned types are not supported");
+    return {sizeof(T), alignof(T), std::is_nothrow_move_constructible<T>::value,
+            &lifetime_functions<T>::copy, &lifetime_functions<T>::move, &lifetime_functions<T>::destroy};
+}
+
+/* Type-erased value with Size bytes of inline storage
+ * Table is the manual vtable of the interface, a struct whose first member lifetime is the lifetime_table of the type.
+ * Copies copy the object, like a value; a moved-from small_value is empty.
+ */
+template<std::size_t Size, typename Table>
+class small_value {
+    union {
+        typename std::aligned_storage<Size, alignof(std::max_align_t)>::type _storage;
+        void* _heap{nullptr};       // the object, if it is not inline
+    };
+    const Table* _table{nullptr};
+
+    bool isInline() const {
+        const lifetime_table& l = _table->lifetime;
+        return l.size <= Size && l.nothrowMove;
+    }
+
+    // Room for an object of the table's type: the inline storage, or a new heap block pointed to from it
+    void* allocate() {
+        if (isInline())
+            return &_storage;
+        _heap = ::operator new(_table->lifetime.size);
+        return _heap;
+    }
+
+    void copyFrom(const small_value& other) {
+        _table = other._table;
+        if (!_table)
+            return;
+        void* p = allocate();
+        try {
+            _table->lifetime.copy(other.get(), p);
+        } catch (...) {
+            if (!isInline())
+                ::operator delete(p);
+            _table = nullptr;
+            throw;
+        }
+    }
+
+    void moveFrom(small_value& other) noexcept {
+        _table = other._table;
+        if (!_table)
+            return;
+        if (isInline()) {
+            _table->lifetime.move(&other._storage, &_storage);
+            _table->lifetime.destroy(&other._storage);
+        } else {
+            _heap = other._heap;
+        }
+        other._table = nullptr;
+    }
+
+public:
+    // Whether an object of type T is stored without an allocation
+    template<typename T>
+    static constexpr bool stored_inline() {
+        return sizeof(T) <= Size && std::is_nothrow_move_constructible<T>::value;
+    }
+
+    small_value() noexcept {}
+
+    // Takes the object of type T that value decays to, table must be the table of T
+    template<typename T>
+    small_value(const Table* table, T&& value) : _table(table) {
+        typedef typename std::decay<T>::type U;
+        void* p = allocate();
+        try {
+            new (p) U(std::forward<T>(value));
+        } catch (...) {
+            if (!isInline())
+                ::operator delete(p);
+            _table = nullptr;
+            throw;
+        }
+    }
+
+    small_value(const small_value& other) { copyFrom(other); }
+    small_value(small_value&& other) noexcept { moveFrom(other); }
+
+    small_value& operator=(const small_value& other) {
+        if (this != &other) {
+            small_value copy(other);
+            reset();
+            moveFrom(copy);
+        }
+        return *this;
+    }
+
+    small_value& operator=(small_value&& other) noexcept {
+        if (this != &other) {
+            reset();
+            moveFrom(other);
+        }
+        return *this;
+    }
+
+    ~small_value() { reset(); }
+
+    void reset() noexcept {
+        if (!_table)
+            return;
+        if (isInline()) {
+            _table->lifetime.destroy(&_storage);
+        } else {
+            _table->lifetime.destroy(_heap);
+            ::operator delete(_heap);
+        }
+        _table = nullptr;
+    }
+
+    bool empty() const { return _table == nullptr; }
+    const Table* table() const { return _table; }
+    const void* get() const { return isInline() ? &_storage : _heap; }
+    void* get() { return isInline() ? &_storage : _heap; }
+};
+
+/* Vector of objects of different types behind one interface
+ * The objects lie one after the other in one growing buffer, each aligned for its type, and an index of table and
+ * offset per element finds them. Growing moves every object to the new buffer with the move function of its table, so
+ * the types should move without throwing. Elements are reached as the table and a pointer to the object; for_each()
+ * visits them in order.
+ */
+template<typename Table>
+class poly_vector {
+    struct entry {
+        const Table* table;
+        std::size_t offset;
+    };
+
+    std::vector<entry> _entries;
+    unsigned char* _data{nullptr};
+    std::size_t _used{0};           // bytes
+    std::size_t _capacity{0};       // bytes
+
+    static std::size_t alignUp(std::size_t n, std::size_t alignment) {
+        return (n + alignment - 1) / alignment * alignment;
+    }
+
+    // Move the objects to a buffer of at least bytes
+    void grow(std::size_t bytes) {
+        std::size_t capacity = std::max<std::size_t>(2 * _capacity, 256);
+        while (capacity < bytes) capacity *= 2;
+        unsigned char* data = static_cast<unsigned char*>(::operator new(capacity));
+        for (const entry& e : _entries) {
+            e.table->lifetime.move(_data + e.offset, data + e.offset);
+            e.table->lifetime.destroy(_data + e.offset);
+        }
+        ::operator delete(_data);
+        _data = data;
+        _capacity = capacity;
+    }
+
+public:
+    poly_vector() = default;
+
+    poly_vector(const poly_vector& other) {
+        try {
+            reserve(other._used, other._entries.size());
+            for (const entry& e : other._entries) {
+                e.table->lifetime.copy(other._data + e.offset, _data + e.offset);
+                _entries.push_back(e);  // reserved, does not throw
+                _used = e.offset + e.table->lifetime.size;
+            }
+        } catch (...) {
+            // The destructor does not run for a constructor that throws
+            clear();
+            ::operator delete(_data);
+            throw;
+        }
+    }
+
+    poly_vector(poly_vector&& other) noexcept
+        : _entries(std::move(other._entries)), _data(other._data), _used(other._used), _capacity(other._capacity) {
+        other._entries.clear();
+        other._data = nullptr;
+        other._used = other._capacity = 0;
+    }
+
+    poly_vector& operator=(poly_vector other) noexcept {
+        std::swap(_entries, other._entries);
+        std::swap(_data, other._data);
+        std::swap(_used, other._used);
+        std::swap(_capacity, other._capacity);
+        return *this;
+    }
+
+    ~poly_vector() {
+        clear();
+        ::operator delete(_data);
+    }
+
+    // Room for bytes of objects and count elements
+    void reserve(std::size_t bytes, std::size_t count) {
+        if (bytes > _capacity)
+            grow(bytes);
+        _entries.reserve(count);
+    }
+
+    // Append the object of type T that value decays to, table must be the table of T
+    template<typename T>
+    void push_back(const Table* table, T&& value) {
+        typedef typename std::decay<T>::type U;
+        const std::size_t offset = alignUp(_used, alignof(U));
+        if (offset + sizeof(U) > _capacity)
+            grow(offset + sizeof(U));
+        if (_entries.size() == _entries.capacity())
+            _entries.reserve(std::max<std::size_t>(16, 2 * _entries.capacity())); // before the object is constructed
+        new (_data + offset) U(std::forward<T>(value));
+        _entries.push_back({table, offset});
+        _used = offset + sizeof(U);
+    }
+
+    void clear() {
+        for (const entry& e : _entries)
+            e.table->lifetime.destroy(_data + e.offset);
+        _entries.clear();
+        _used = 0;
+    }
+
+    std::size_t size() const { return _entries.size(); }
+    bool empty() const { return _entries.empty(); }
+    std::size_t bytes() const { return _used; }
+
+    const Table& table(std::size_t i) const { return *_entries[i].table; }
+    const void* get(std::size_t i) const { return _data + _entries[i].offset; }
+    void* get(std::size_t i) { return _data + _entries[i].offset; }
+
+    // f(table, object) for every element, in order
+    template<typename F>
+    void for_each(F f) const {
+        for (const entry& e : _entries)
+            f(*e.table, static_cast<const void*>(_data + e.offset));
+    }
+};
+
+#endif // POLYSTORAGE_H
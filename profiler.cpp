@@ -0,0 +1,200 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iomanip>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace {
+
+const char* const STAGE_NAMES[NUM_PIPELINE_STAGES] = {
+    "WAV read", "framing", "preEmphHamming", "FFT", "power spectrum", "filterbank", "DCT", "similarity",
+    "streaming similarity"
+};
+
+// The histograms of one thread, kept after the thread ends so that the report still counts its work
+struct thread_profile {
+    latency_histogram stages[NUM_PIPELINE_STAGES];
+};
+
+struct profile_registry {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<thread_profile>> threads;
+};
+
+profile_registry& registry() {
+    static profile_registry instance;
+    return instance;
+}
+
+#ifndef NO_PIPELINE_PROFILING
+
+thread_local thread_profile* currentProfile = nullptr;
+
+thread_profile& threadProfile() {
+    if (!currentProfile) {
+        profile_registry& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        r.threads.emplace_back(new thread_profile());
+        currentProfile = r.threads.back().get();
+    }
+    return *currentProfile;
+}
+
+#endif
+
+// Time with a unit that leaves three to four significant digits
+std::string formatNanoseconds(double ns) {
+    char text[32];
+    if (ns < 1e3)
+        std::snprintf(text, sizeof(text), "%.0f ns", ns);
+    else if (ns < 1e6)
+        std::snprintf(text, sizeof(text), "%.2f us", ns * 1e-3);
+    else if (ns < 1e9)
+        std::snprintf(text, sizeof(text), "%.2f ms", ns * 1e-6);
+    else
+        std::snprintf(text, sizeof(text), "%.3f s", ns * 1e-9);
+    return text;
+}
+
+}
+
+const char* stageName(pipeline_stage stage) {
+    return STAGE_NAMES[size_t(stage)];
+}
+
+latency_histogram::latency_histogram() {
+    reset();
+}
+
+latency_histogram::latency_histogram(const latency_histogram& other) {
+    reset();
+    merge(other);
+}
+
+latency_histogram& latency_histogram::operator=(const latency_histogram& other) {
+    if (this != &other) {
+        reset();
+        merge(other);
+    }
+    return *this;
+}
+
+void latency_histogram::merge(const latency_histogram& other) {
+    for (size_t i=0; i<NUM_BUCKETS; i++) {
+        const uint64_t n = other.counts[i].load(std::memory_order_relaxed);
+        if (n)
+            bump(counts[i], n);
+    }
+    bump(numValues, other.numValues.load(std::memory_order_relaxed));
+    bump(sum, other.sum.load(std::memory_order_relaxed));
+    minimum.store(std::min(minimum.load(std::memory_order_relaxed), other.minimum.load(std::memory_order_relaxed)),
+                  std::memory_order_relaxed);
+    maximum.store(std::max(maximum.load(std::memory_order_relaxed), other.maximum.load(std::memory_order_relaxed)),
+                  std::memory_order_relaxed);
+}
+
+void latency_histogram::reset() {
+    for (std::atomic<uint64_t>& n : counts)
+        n.store(0, std::memory_order_relaxed);
+    numValues.store(0, std::memory_order_relaxed);
+    sum.store(0, std::memory_order_relaxed);
+    minimum.store(std::numeric_limits<uint64_t>::max(), std::memory_order_relaxed);
+    maximum.store(0, std::memory_order_relaxed);
+}
+
+uint64_t latency_histogram::min() const {
+    return count() ? minimum.load(std::memory_order_relaxed) : 0;
+}
+
+double latency_histogram::mean() const {
+    const uint64_t n = count();
+    return n ? double(total()) / n : 0;
+}
+
+uint64_t latency_histogram::bucketHigh(size_t i) {
+    if (i < 2 * HALF)
+        return i;
+    const size_t shift = i / HALF - 1;
+    return (uint64_t(i - shift * HALF) << shift) + (uint64_t(1) << shift) - 1;
+}
+
+uint64_t latency_histogram::percentile(double p) const {
+    const uint64_t n = count();
+    if (n == 0)
+        return 0;
+    // Nearest rank, as the bench reports its quantiles
+    const uint64_t rank = std::max<uint64_t>(1, uint64_t(std::ceil(p / 100 * n)));
+    uint64_t seen = 0;
+    for (size_t i=0; i<NUM_BUCKETS; i++) {
+        seen += counts[i].load(std::memory_order_relaxed);
+        if (seen >= rank)
+            return i + 1 < NUM_BUCKETS ? std::min(bucketHigh(i), max()) : max();   // the last bucket is open
+    }
+    return max();
+}
+
+#ifndef NO_PIPELINE_PROFILING
+
+bool stageProfilingEnabled() {
+    return true;
+}
+
+void recordStage(pipeline_stage stage, uint64_t nanoseconds) {
+    threadProfile().stages[size_t(stage)].record(nanoseconds);
+}
+
+#else
+
+bool stageProfilingEnabled() {
+    return false;
+}
+
+void recordStage(pipeline_stage, uint64_t) {}
+
+#endif // NO_PIPELINE_PROFILING
+
+latency_histogram stageLatency(pipeline_stage stage) {
+    latency_histogram merged;
+    profile_registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    for (const std::unique_ptr<thread_profile>& thread : r.threads)
+        merged.merge(thread->stages[size_t(stage)]);
+    return merged;
+}
+
+void resetStageLatencies() {
+    profile_registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    for (const std::unique_ptr<thread_profile>& thread : r.threads)
+        for (latency_histogram& h : thread->stages)
+            h.reset();
+}
+
+void printStageReport(std::ostream& out) {
+    if (!stageProfilingEnabled()) {
+        out << "Stage profiling is compiled out (NO_PIPELINE_PROFILING)" << std::endl;
+        return;
+    }
+
+    out << std::left << std::setw(22) << "stage" << std::right << std::setw(10) << "count" << std::setw(12) << "p50"
+        << std::setw(12) << "p99" << std::setw(12) << "max" << std::setw(12) << "mean" << std::setw(12) << "total"
+        << std::endl;
+    for (size_t s=0; s<NUM_PIPELINE_STAGES; s++) {
+        const pipeline_stage stage = pipeline_stage(s);
+        const latency_histogram h = stageLatency(stage);
+        if (h.count() == 0)
+            continue;
+        out << std::left << std::setw(22) << stageName(stage) << std::right << std::setw(10) << h.count()
+            << std::setw(12) << formatNanoseconds(double(h.percentile(50)))
+            << std::setw(12) << formatNanoseconds(double(h.percentile(99)))
+            << std::setw(12) << formatNanoseconds(double(h.max()))
+            << std::setw(12) << formatNanoseconds(h.mean())
+            << std::setw(12) << formatNanoseconds(double(h.total())) << std::endl;
+    }
+}
@@ -0,0 +1,184 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+/* Per-stage latency profiling of the analysis pipeline
+ * The stages time themselves with stage_timer and stage_probe, which read steady_clock and record the nanoseconds
+ * between two reads in a latency histogram of the stage. Every thread records into histograms of its own, found through
+ * a thread_local pointer, so the workers of a parallel extraction never share a cache line; stageLatency() merges the
+ * histograms of all threads and printStageReport() prints count, p50, p99, max, mean and total per stage.
+ *
+ * What one sample is depends on the stage:
+ *   wavRead              one open() or read() of a file (a mapped file is paged in by the first stage that reads it)
+ *   framing              one copy of samples into the ring buffer of the streaming extractor, about one per frame;
+ *                        the offline extraction reads its frames in place and has no framing
+ *   preEmphHamming .. dct one frame
+ *   similarity           one block of tiles of the offline self-similarity matrix, as scheduled
+ *   streamingSimilarity  one frame pushed to the streaming similarity
+ *
+ * A lap costs one clock read and a record() into a histogram of the thread, together about 0.1 us on x86 Linux, or
+ * 0.5 us on a frame of five stages that takes 5 us. Built with NO_PIPELINE_PROFILING the timers are empty classes that
+ * the compiler removes, the histograms stay empty and the report says so.
+ */
+enum class pipeline_stage {
+    wavRead,
+    framing,
+    preEmphHamming,
+    fft,
+    powerSpectrum,
+    filterbank,
+    dct,
+    similarity,
+    streamingSimilarity
+};
+
+const size_t NUM_PIPELINE_STAGES = 9;
+
+const char* stageName(pipeline_stage stage);
+
+/* Histogram of latencies in nanoseconds with HDR-style buckets
+ * Values below 64 ns have a bucket each; above, every power of two is split into 32 buckets, so a value is known to
+ * within 1/32 (about 3%) over the whole range up to 2^40 ns, in a fixed 9 KB and with a record() of a few instructions.
+ * Larger values are counted in the last bucket; min, max and the total are exact.
+ *
+ * record() and merge() may be called by one thread at a time, the owner, while any thread reads the histogram or copies
+ * it: every counter is an atomic that only the owner writes.
+ */
+class latency_histogram {
+
+public:
+    latency_histogram();
+    latency_histogram(const latency_histogram& other);
+    latency_histogram& operator=(const latency_histogram& other);
+
+    void record(uint64_t nanoseconds) {
+        bump(counts[bucketOf(nanoseconds)], 1);
+        bump(numValues, 1);
+        bump(sum, nanoseconds);
+        if (nanoseconds < minimum.load(std::memory_order_relaxed))
+            minimum.store(nanoseconds, std::memory_order_relaxed);
+        if (nanoseconds > maximum.load(std::memory_order_relaxed))
+            maximum.store(nanoseconds, std::memory_order_relaxed);
+    }
+
+    // Add the values of other
+    void merge(const latency_histogram& other);
+    void reset();
+
+    uint64_t count() const { return numValues.load(std::memory_order_relaxed); }
+    uint64_t total() const { return sum.load(std::memory_order_relaxed); }
+    uint64_t min() const;
+    uint64_t max() const { return maximum.load(std::memory_order_relaxed); }
+    double mean() const;
+
+    // Smallest bucket bound that at least p percent of the values do not exceed, clamped to max()
+    uint64_t percentile(double p) const;
+
+private:
+    static const int SUB_BITS = 6;
+    static const int MAX_BITS = 40;
+    static const size_t HALF = size_t(1) << (SUB_BITS - 1);
+    static const size_t NUM_BUCKETS = (MAX_BITS - SUB_BITS + 2) * HALF;
+
+    std::array<std::atomic<uint64_t>, NUM_BUCKETS> counts;
+    std::atomic<uint64_t> numValues, sum, minimum, maximum;
+
+    // Add to a counter that only this thread writes, without a locked instruction
+    static void bump(std::atomic<uint64_t>& counter, uint64_t value) {
+        counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+
+    static size_t bucketOf(uint64_t value) {
+        if (value >= (uint64_t(1) << MAX_BITS))
+            value = (uint64_t(1) << MAX_BITS) - 1;
+        if (value < 2 * HALF)
+            return size_t(value);
+#if defined(__GNUC__) || defined(__clang__)
+        const int msb = 63 - __builtin_clzll(value);
+#else
+        int msb = 63;
+        while (!(value >> msb))
+            msb--;
+#endif
+        const int shift = msb - SUB_BITS + 1;
+        return size_t(shift) * HALF + size_t(value >> shift);
+    }
+
+    // Largest value that falls into bucket i
+    static uint64_t bucketHigh(size_t i);
+};
+
+// Whether the stages record their latencies, false in a build with NO_PIPELINE_PROFILING
+bool stageProfilingEnabled();
+
+// Record a latency of stage in the histograms of the calling thread
+void recordStage(pipeline_stage stage, uint64_t nanoseconds);
+
+// Latencies of stage recorded so far by all threads
+latency_histogram stageLatency(pipeline_stage stage);
+
+// Clear the histograms of all threads, while no stage is running
+void resetStageLatencies();
+
+// Table of the stages that recorded latencies, with count, p50, p99, max, mean and total
+void printStageReport(std::ostream& out);
+
+#ifndef NO_PIPELINE_PROFILING
+
+/* Times consecutive stages with one clock read per stage: lap(stage) records the time since construction or the
+ * previous lap as a latency of stage
+ */
+class stage_timer {
+
+public:
+    stage_timer() : last(clock::now()) {}
+
+    void lap(pipeline_stage stage) {
+        const clock::time_point now = clock::now();
+        recordStage(stage, uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(now - last).count()));
+        last = now;
+    }
+
+private:
+    typedef std::chrono::steady_clock clock;
+    clock::time_point last;
+};
+
+// Records the lifetime of the scope it is declared in as a latency of stage
+class stage_probe {
+
+public:
+    explicit stage_probe(pipeline_stage stage) : stage(stage) {}
+    ~stage_probe() { timer.lap(stage); }
+
+    stage_probe(const stage_probe&) = delete;
+    stage_probe& operator=(const stage_probe&) = delete;
+
+private:
+    pipeline_stage stage;
+    stage_timer timer;
+};
+
+#else
+
+class stage_timer {
+
+public:
+    void lap(pipeline_stage) {}
+};
+
+class stage_probe {
+
+public:
+    explicit stage_probe(pipeline_stage) {}
+};
+
+#endif // NO_PIPELINE_PROFILING
+
+#endif // PROFILER_H
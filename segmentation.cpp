@@ -0,0 +1,137 @@
+#include "segmentation.h"
+
+#include <algorithm>
+#include <cmath>
+
+template<typename T>
+void foote_segmenter<T>::init(const novelty_config& config) {
+    K = std::max<size_t>(1, config.kernelHalfWidth);
+    peakRadius = config.peakRadius;
+    threshold = config.threshold;
+    relativeThreshold = config.relativeThreshold;
+    noiseFloor = config.noiseFloor;
+
+    /* The border of box k, at Chebyshev distance k-1/2 from the centre, is in the boxes k .. K, so box k gets the taper
+     * there minus the taper on the next border. Normalized so that distance 1 across the kernel and 0 within gives 1.
+     */
+    const double sigma = config.taperSigma * K;
+    auto taper = [sigma](double r) { return std::exp(-r * r / (2 * sigma * sigma)); };
+    weights.assign(K + 1, 0.0);
+    double total = 0;
+    for (size_t k=1; k<=K; k++) {
+        weights[k] = taper(k - 0.5) - (k < K ? taper(k + 0.5) : 0.0);
+        total += weights[k] * 2 * k * k;
+    }
+    for (double& weight : weights)
+        weight /= total;
+}
+
+/* With the windows L = [c-k,c), R = [c,c+k) and F = [c-k,c+k), box k contributes Q(F) - 2 Q(L) - 2 Q(R), Q being the
+ * sum of D over the square of a window. Going from box k-1 to box k, L gains the row c-k against the rest of L, R the
+ * row c+k-1 against the rest of R, and F both rows against the rest of F plus the pair of the two; each of these is a
+ * prefix of the lag sums of one row, counted twice for D(i,j) and D(j,i).
+ */
+template<typename T>
+template<typename M>
+void foote_segmenter<T>::computeNovelty(const M& ssm, std::vector<T>& out) {
+    const size_t n = ssm.size();
+    const size_t rowLength = 2 * K - 1;     // lag sums for w = 0 .. 2K-2
+    const size_t ringSize = 2 * K;
+    forward.assign(ringSize * rowLength, 0.0);
+    backward.assign(ringSize * rowLength, 0.0);
+    out.assign(n, T(0));
+
+    // Lag sums of row i, built when the row enters the ring
+    auto buildRow = [this, &ssm, n, rowLength, ringSize](size_t i) {
+        double* f = forward.data() + i % ringSize * rowLength;
+        double* b = backward.data() + i % ringSize * rowLength;
+        f[0] = b[0] = 0;
+        for (size_t w=1; w<rowLength; w++) {
+            f[w] = f[w - 1] + (i + w < n ? double(ssm.at(i, i + w)) : 0.0);
+            b[w] = b[w - 1] + (w <= i ? double(ssm.at(i - w, i)) : 0.0);
+        }
+    };
+    auto rowSum = [rowLength, ringSize](const std::vector<double>& sums, size_t i, size_t w) {
+        return sums[i % ringSize * rowLength + w];
+    };
+
+    size_t built = 0;
+    for (size_t c=0; c<n; c++) {
+        // Rows c-K .. c+K-1 are in the ring
+        for (; built < std::min(n, c + K); built++)
+            buildRow(built);
+
+        double left = 0, right = 0, full = 0, value = 0;
+        for (size_t k=1; k<=K; k++) {
+            const bool hasLow = k <= c, hasHigh = c + k - 1 < n;
+            const size_t low = c - k, high = c + k - 1;
+            if (hasLow) {
+                left += 2 * rowSum(forward, low, k - 1);
+                full += 2 * rowSum(forward, low, 2 * k - 2);
+            }
+            if (hasHigh) {
+                right += 2 * rowSum(backward, high, k - 1);
+                full += 2 * rowSum(backward, high, 2 * k - 2);
+            }
+            if (hasLow && hasHigh)
+                full += 2 * double(ssm.at(low, high));
+            value += weights[k] * (full - 2 * left - 2 * right);
+        }
+        out[c] = T(value);
+    }
+}
+
+template<typename T>
+void foote_segmenter<T>::novelty(const similarity_matrix<T>& ssm, std::vector<T>& out) {
+    computeNovelty(ssm, out);
+}
+
+template<typename T>
+void foote_segmenter<T>::novelty(const banded_similarity_matrix<T>& ssm, std::vector<T>& out) {
+    computeNovelty(ssm, out);
+}
+
+template<typename T>
+T foote_segmenter<T>::peakThreshold(const std::vector<T>& novelty) {
+    if (relativeThreshold <= 0 || novelty.empty())
+        return T(threshold);
+    sorted.assign(novelty.begin(), novelty.end());
+    std::nth_element(sorted.begin(), sorted.begin() + sorted.size() / 2, sorted.end());
+    const double median = sorted[sorted.size() / 2];
+    const double maximum = *std::max_element(novelty.begin(), novelty.end());
+    return T(std::max(noiseFloor, median + relativeThreshold * (maximum - median)));
+}
+
+template<typename T>
+void foote_segmenter<T>::peaks(const std::vector<T>& novelty, std::vector<size_t>& out) {
+    out.clear();
+    const T minimum = peakThreshold(novelty);
+    const size_t n = novelty.size();
+    for (size_t c=0; c<n; c++) {
+        const T value = novelty[c];
+        if (!(value >= minimum))
+            continue;
+        bool peak = true;
+        for (size_t i=c > peakRadius ? c - peakRadius : 0; i<c && peak; i++)
+            peak = novelty[i] < value;
+        for (size_t i=c+1; i<=c+peakRadius && i<n && peak; i++)
+            peak = novelty[i] <= value;
+        if (peak)
+            out.push_back(c);
+    }
+}
+
+template<typename T>
+void foote_segmenter<T>::segment(const similarity_matrix<T>& ssm, std::vector<size_t>& boundaries) {
+    computeNovelty(ssm, curve);
+    peaks(curve, boundaries);
+}
+
+template<typename T>
+void foote_segmenter<T>::segment(const banded_similarity_matrix<T>& ssm, std::vector<size_t>& boundaries) {
+    computeNovelty(ssm, curve);
+    peaks(curve, boundaries);
+}
+
+template class foote_segmenter<double>;
+template class foote_segmenter<float>;
@@ -0,0 +1,84 @@
+#ifndef SEGMENTATION_H
+#define SEGMENTATION_H
+
+#include "similaritymatrix.h"
+#include "streamingsimilarity.h"
+
+#include <cstddef>
+#include <vector>
+
+/* Foote novelty and segmentation of a self-similarity matrix
+ * A Gaussian-tapered checkerboard kernel of half width K slides along the diagonal of the matrix of cosine distances;
+ * the novelty at frame c is the weighted mean distance across the kernel minus the weighted mean distance within it,
+ * and the segment boundaries are the peaks of the novelty curve (Foote, 2000). The kernel and the peak picking take the
+ * same novelty_config as the live curve of streaming_similarity, and the novelty is in the same units.
+ *
+ * The scale of the novelty depends on the level, the noise and the features, so unlike the live curve, which has only
+ * seen the past, the offline peaks are picked against the whole curve: a boundary rises relativeThreshold of the way
+ * from the median, the novelty within segments, to the largest peak, and above noiseFloor.
+ *
+ * The taper is a Gaussian of the Chebyshev distance from the centre, exp(-(k-1/2)^2/(2 sigma^2)) for the cells on the
+ * border of the k-th box around the centre. Such a kernel is a weighted sum of the K nested checkerboard boxes, and the
+ * sums of the boxes grow from one to the next by a row and a column of the matrix. With per-row prefix sums along the
+ * lags, a ring of the 2K rows around the centre built once per row, every box costs O(1): O(N*K) for the whole curve
+ * instead of O(N*K^2) for evaluating the kernel cell by cell. Kernels that reach past either end of the matrix are
+ * clipped to it.
+ *
+ * A banded matrix must hold lags up to 2K-1; cells outside its band read as distance 1.
+ */
+template<typename T>
+class foote_segmenter {
+
+public:
+    explicit foote_segmenter(const novelty_config& config = novelty_config()) { init(config); }
+
+    // A copy gets the kernel only, not the rings and the curve of the last matrix
+    foote_segmenter(const foote_segmenter& other)
+        : K(other.K), peakRadius(other.peakRadius), threshold(other.threshold),
+          relativeThreshold(other.relativeThreshold), noiseFloor(other.noiseFloor), weights(other.weights) {}
+    foote_segmenter& operator=(const foote_segmenter& other) {
+        K = other.K;
+        peakRadius = other.peakRadius;
+        threshold = other.threshold;
+        relativeThreshold = other.relativeThreshold;
+        noiseFloor = other.noiseFloor;
+        weights = other.weights;
+        return *this;
+    }
+    foote_segmenter(foote_segmenter&&) = default;
+    foote_segmenter& operator=(foote_segmenter&&) = default;
+
+    void init(const novelty_config& config);
+
+    // Novelty of every frame of the matrix
+    void novelty(const similarity_matrix<T>& ssm, std::vector<T>& out);
+    void novelty(const banded_similarity_matrix<T>& ssm, std::vector<T>& out);
+
+    // Peaks of a novelty curve above the threshold, the first of equal values within peakRadius frames
+    void peaks(const std::vector<T>& novelty, std::vector<size_t>& out);
+
+    // Smallest novelty of a boundary of the curve, relative to its median and maximum or absolute
+    T peakThreshold(const std::vector<T>& novelty);
+
+    // First frames of the segments after the first one, the peaks of the novelty of the matrix
+    void segment(const similarity_matrix<T>& ssm, std::vector<size_t>& boundaries);
+    void segment(const banded_similarity_matrix<T>& ssm, std::vector<size_t>& boundaries);
+
+    size_t kernelHalfWidth() const { return K; }
+    // Smallest maximum lag of a banded matrix that the kernel fits into: it reaches 2K-1 frames apart
+    size_t minimumLag() const { return 2 * K - 1; }
+
+private:
+    size_t K = 0, peakRadius = 0;
+    double threshold = 0, relativeThreshold = 0, noiseFloor = 0;
+    std::vector<double> weights;        // weight of the k-th box, normalized by the weight of the whole kernel
+    std::vector<double> forward;        // ring of 2K rows i, sums of D(i,i+l) over l = 1 .. w
+    std::vector<double> backward;       // ring of 2K rows i, sums of D(i-l,i) over l = 1 .. w
+    std::vector<T> curve;
+    std::vector<T> sorted;              // copy of the curve for its median
+
+    template<typename M>
+    void computeNovelty(const M& ssm, std::vector<T>& out);
+};
+
+#endif // SEGMENTATION_H
@@ -0,0 +1,193 @@
+#include "similarity.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+
+namespace {
+
+// Cache budget for the B panels of one column block
+const size_t L2_BYTES = 256 * 1024;
+
+// Run task(index, tile) for index = 0 .. count-1 on the workers of pool and the calling thread, one tile buffer per thread
+template<typename T, typename F>
+void parallelTiles(task_system& pool, size_t count, size_t tileSize, F task) {
+    parallel_for(pool, count, [tileSize]() { return std::vector<T>(tileSize); },
+                 [task](size_t t, std::vector<T>& tile) { task(t, tile.data()); });
+}
+
+}
+
+template<typename T>
+void similarity_engine<T>::compute(const feature_matrix<T>& features, similarity_matrix<T>& out) {
+    compute(features.data(), features.rows(), features.cols(), features.cols(), out);
+}
+
+// Normalize every frame once and pack the frames into k-major panels for both operands
+template<typename T>
+void similarity_engine<T>::pack(const T* features, size_t n, size_t dim, size_t stride) {
+    const size_t MR = simd->tileRows, NR = simd->tileCols;
+    packedA.assign((n + MR - 1) / MR * MR * dim, T(0));
+    packedB.assign((n + NR - 1) / NR * NR * dim, T(0));
+
+    for (size_t i=0; i<n; i++) {
+        const T* x = features + i * stride;
+        T norm = 0;
+        for (size_t k=0; k<dim; k++)
+            norm += x[k] * x[k];
+        T inv = norm > 0 ? T(1) / std::sqrt(norm) : T(0);
+
+        T* a = packedA.data() + i / MR * MR * dim + i % MR;
+        T* b = packedB.data() + i / NR * NR * dim + i % NR;
+        for (size_t k=0; k<dim; k++) {
+            a[k * MR] = x[k] * inv;
+            b[k * NR] = x[k] * inv;
+        }
+    }
+}
+
+template<typename T>
+void similarity_engine<T>::computeBlock(size_t n, size_t dim, size_t rowBegin, size_t rowEnd, size_t colBegin,
+                                        size_t colEnd, T* tile, similarity_matrix<T>& out) const {
+    stage_probe probe(pipeline_stage::similarity);
+    const size_t MR = simd->tileRows, NR = simd->tileCols;
+    rowEnd = std::min(rowEnd, colEnd);
+    for (size_t ir=rowBegin; ir<rowEnd; ir+=MR) {
+        const T* a = packedA.data() + ir * dim;
+        for (size_t jr=std::max(colBegin, ir / NR * NR); jr<colEnd; jr+=NR) {
+            simd->gemmTile(a, packedB.data() + jr * dim, dim, tile);
+
+            // Keep the part of the tile on or above the diagonal
+            const size_t jEnd = std::min(jr + NR, colEnd);
+            for (size_t r=0; r<MR && ir + r < std::min(rowEnd, n); r++) {
+                const size_t i = ir + r;
+                T* row = out.upperRow(i);
+                for (size_t j=std::max(jr, i); j<jEnd; j++)
+                    row[j - i] = 1 - tile[r * NR + (j - jr)];
+            }
+        }
+    }
+}
+
+template<typename T>
+void similarity_engine<T>::compute(const T* features, size_t n, size_t dim, size_t stride, similarity_matrix<T>& out) {
+    const size_t MR = simd->tileRows, NR = simd->tileCols;
+    out.resize(n);
+    pack(features, n, dim, stride);
+    tile.assign(MR * NR, T(0));
+
+    // Columns per block, a whole number of B panels that fit in L2 together
+    const size_t panelBytes = std::max<size_t>(1, NR * dim * sizeof(T));
+    const size_t NC = std::max<size_t>(1, L2_BYTES / panelBytes) * NR;
+
+    // Every A panel with a row above the end of a column block has tiles on or above the diagonal in it
+    for (size_t jc=0; jc<n; jc+=NC)
+        computeBlock(n, dim, 0, n, jc, std::min(n, jc + NC), tile.data(), out);
+}
+
+template<typename T>
+void similarity_engine<T>::compute(const feature_matrix<T>& features, similarity_matrix<T>& out, task_system& pool) {
+    compute(features.data(), features.rows(), features.cols(), features.cols(), out, pool);
+}
+
+template<typename T>
+void similarity_engine<T>::compute(const T* features, size_t n, size_t dim, size_t stride, similarity_matrix<T>& out,
+                                   task_system& pool) {
+    const size_t MR = simd->tileRows, NR = simd->tileCols;
+    out.resize(n);
+    pack(features, n, dim, stride);
+
+    /* Square tiles with edges on both panel grids: about four tiles per worker along each edge of the triangle, but no
+     * smaller than 64 frames to keep the scheduling cost low and no wider than the L2 budget of the serial blocks.
+     */
+    const size_t align = std::max(MR, NR);
+    const size_t panelBytes = std::max<size_t>(1, NR * dim * sizeof(T));
+    const size_t maxEdge = std::max<size_t>(1, L2_BYTES / panelBytes) * NR;
+    const size_t tilesPerEdge = 4 * size_t(pool.size());
+    size_t edge = std::max<size_t>(64, (n + tilesPerEdge - 1) / tilesPerEdge);
+    edge = (std::min(edge, maxEdge) + align - 1) / align * align;
+
+    // Off-diagonal tiles first: they are twice the work of the diagonal ones, so the schedule ends on small tiles
+    struct tile_range { size_t row, col; };
+    std::vector<tile_range> tiles;
+    const size_t numEdges = (n + edge - 1) / edge;
+    tiles.reserve(numEdges * (numEdges + 1) / 2);
+    for (size_t d=1; d<numEdges; d++)
+        for (size_t t=0; t+d<numEdges; t++)
+            tiles.push_back({t * edge, (t + d) * edge});
+    for (size_t t=0; t<numEdges; t++)
+        tiles.push_back({t * edge, t * edge});
+    parallelTiles<T>(pool, tiles.size(), MR * NR, [this, &tiles, n, dim, edge, &out](size_t t, T* tile) {
+        const tile_range& r = tiles[t];
+        computeBlock(n, dim, r.row, std::min(n, r.row + edge), r.col, std::min(n, r.col + edge), tile, out);
+    });
+}
+
+template<typename T>
+void similarity_engine<T>::computeBand(size_t n, size_t dim, size_t rowBegin, size_t rowEnd, T* tile,
+                                       banded_similarity_matrix<T>& out) const {
+    stage_probe probe(pipeline_stage::similarity);
+    const size_t MR = simd->tileRows, NR = simd->tileCols;
+    const size_t maxLag = out.maxLag();
+    rowEnd = std::min(rowEnd, n);
+    for (size_t ir=rowBegin; ir<rowEnd; ir+=MR) {
+        const T* a = packedA.data() + ir * dim;
+        const size_t rEnd = std::min(MR, rowEnd - ir);
+        // Columns from the diagonal of the first row to the end of the band of the last row
+        const size_t colEnd = std::min(n, ir + rEnd - 1 + maxLag + 1);
+        for (size_t jr=ir / NR * NR; jr<colEnd; jr+=NR) {
+            simd->gemmTile(a, packedB.data() + jr * dim, dim, tile);
+
+            // Keep the part of the tile inside the band, on or above the diagonal
+            const size_t jEnd = std::min(jr + NR, colEnd);
+            for (size_t r=0; r<rEnd; r++) {
+                const size_t i = ir + r;
+                const size_t jLast = std::min(jEnd, i + maxLag + 1);
+                for (size_t j=std::max(jr, i); j<jLast; j++)
+                    out.diagonal(j - i)[i] = 1 - tile[r * NR + (j - jr)];
+            }
+        }
+    }
+}
+
+template<typename T>
+void similarity_engine<T>::compute(const feature_matrix<T>& features, size_t maxLag, banded_similarity_matrix<T>& out) {
+    compute(features.data(), features.rows(), features.cols(), features.cols(), maxLag, out);
+}
+
+template<typename T>
+void similarity_engine<T>::compute(const T* features, size_t n, size_t dim, size_t stride, size_t maxLag,
+                                   banded_similarity_matrix<T>& out) {
+    out.resize(n, maxLag);
+    pack(features, n, dim, stride);
+    tile.assign(simd->tileRows * simd->tileCols, T(0));
+    computeBand(n, dim, 0, n, tile.data(), out);
+}
+
+template<typename T>
+void similarity_engine<T>::compute(const feature_matrix<T>& features, size_t maxLag, banded_similarity_matrix<T>& out,
+                                   task_system& pool) {
+    compute(features.data(), features.rows(), features.cols(), features.cols(), maxLag, out, pool);
+}
+
+template<typename T>
+void similarity_engine<T>::compute(const T* features, size_t n, size_t dim, size_t stride, size_t maxLag,
+                                   banded_similarity_matrix<T>& out, task_system& pool) {
+    const size_t MR = simd->tileRows, NR = simd->tileCols;
+    out.resize(n, maxLag);
+    pack(features, n, dim, stride);
+
+    // Runs of whole A panels, about four per worker but no fewer than 64 rows; each run writes only its own rows
+    const size_t runs = 4 * size_t(pool.size());
+    size_t rows = std::max<size_t>(64, (n + runs - 1) / runs);
+    rows = (rows + MR - 1) / MR * MR;
+    const size_t numRuns = (n + rows - 1) / rows;
+
+    parallelTiles<T>(pool, numRuns, MR * NR, [this, n, dim, rows, &out](size_t t, T* tile) {
+        computeBand(n, dim, t * rows, std::min(n, (t + 1) * rows), tile, out);
+    });
+}
+
+template class similarity_engine<double>;
+template class similarity_engine<float>;
@@ -0,0 +1,83 @@
+#ifndef SIMILARITY_H
+#define SIMILARITY_H
+
+#include "featurematrix.h"
+#include "kernels.h"
+#include "similaritymatrix.h"
+#include "task.h"
+
+#include <cstddef>
+#include <vector>
+
+/* Cosine self-similarity as a blocked matrix product
+ * The cosine distance of frames i and j is 1 - <x_i,x_j>/(|x_i||x_j|). Normalizing every feature vector once turns all
+ * pairwise similarities into the product X*X^T of the normalized frame matrix, which is computed the way a GEMM is:
+ *   - the normalized rows are packed into panels of tileRows (A side) and tileCols (B side) frames, stored k-major,
+ *     so the register tile kernel reads both operands with unit stride,
+ *   - the columns are processed in blocks whose B panels fit in L2, and every A panel (4 frames) is swept across the
+ *     block while it sits in L1,
+ *   - only tiles that touch the upper triangle are computed, and each tile is written back as 1 - similarity.
+ * The tile kernel comes from the dispatched DSP kernels (4x4 scalar up to 4x16 floats with AVX2), so the same code
+ * serves the 13 MFCCs of the pipeline and wider features. A frame with zero norm is treated as orthogonal to every
+ * frame, distance 1, instead of producing NaN.
+ *
+ * The parallel overloads cut the triangle into square tiles of whole panels instead of bands of rows, which would be
+ * badly unbalanced as the triangle narrows. The tiles are handed out, largest first, from an atomic counter to up to
+ * one task per worker of the task_system and to the calling thread, which also keeps the caller from waiting on tasks
+ * queued behind it. Every cell is computed by the same register tile from the same packed panels whatever the
+ * partition, so the parallel result is bit for bit the serial one.
+ *
+ * The banded overloads compute only the cells with |i-j| <= maxLag into a lag-major banded_similarity_matrix, in
+ * O(n*L) time and memory: every A panel is swept across the B panels that reach into its band, a window that slides
+ * down the matrix with the rows so the B panels are reused from cache by the following A panels. The band has the same
+ * width everywhere, so the parallel version simply cuts it into equal runs of rows.
+ */
+template<typename T>
+class similarity_engine {
+
+public:
+    explicit similarity_engine(const basic_dsp_kernels<T>& simd = kernels<T>()) : simd(&simd) {}
+
+    // A copy gets the kernels only, its packed panels are rebuilt on first use
+    similarity_engine(const similarity_engine& other) : simd(other.simd) {}
+    similarity_engine& operator=(const similarity_engine& other) { simd = other.simd; return *this; }
+    similarity_engine(similarity_engine&&) = default;
+    similarity_engine& operator=(similarity_engine&&) = default;
+
+    // Cosine distances between all rows of features
+    void compute(const feature_matrix<T>& features, similarity_matrix<T>& out);
+
+    // Cosine distances between the n rows of a row-major matrix with dim features per row, stride values apart
+    void compute(const T* features, size_t n, size_t dim, size_t stride, similarity_matrix<T>& out);
+
+    // Same as compute(), with the tiles of the triangle spread over the workers of pool
+    void compute(const feature_matrix<T>& features, similarity_matrix<T>& out, task_system& pool);
+    void compute(const T* features, size_t n, size_t dim, size_t stride, similarity_matrix<T>& out, task_system& pool);
+
+    // Cosine distances between rows of features at most maxLag frames apart
+    void compute(const feature_matrix<T>& features, size_t maxLag, banded_similarity_matrix<T>& out);
+    void compute(const T* features, size_t n, size_t dim, size_t stride, size_t maxLag, banded_similarity_matrix<T>& out);
+
+    // Same as the banded compute(), with runs of rows spread over the workers of pool
+    void compute(const feature_matrix<T>& features, size_t maxLag, banded_similarity_matrix<T>& out, task_system& pool);
+    void compute(const T* features, size_t n, size_t dim, size_t stride, size_t maxLag, banded_similarity_matrix<T>& out,
+                 task_system& pool);
+
+    const basic_dsp_kernels<T>& kernelSet() const { return *simd; }
+
+private:
+    const basic_dsp_kernels<T>* simd;
+    std::vector<T> packedA, packedB, tile;
+
+    void pack(const T* features, size_t n, size_t dim, size_t stride);
+
+    // Tiles of rows [rowBegin, rowEnd) x columns [colBegin, colEnd) on or above the diagonal, bounds on panel edges
+    void computeBlock(size_t n, size_t dim, size_t rowBegin, size_t rowEnd, size_t colBegin, size_t colEnd,
+                      T* tile, similarity_matrix<T>& out) const;
+
+    // Tiles of rows [rowBegin, rowEnd) that reach into the band, rowBegin on a panel edge
+    void computeBand(size_t n, size_t dim, size_t rowBegin, size_t rowEnd, T* tile,
+                     banded_similarity_matrix<T>& out) const;
+};
+
+#endif // SIMILARITY_H
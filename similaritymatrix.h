@@ -0,0 +1,150 @@
+#ifndef SIMILARITYMATRIX_H
+#define SIMILARITYMATRIX_H
+
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+/* Self-similarity matrix in packed symmetric storage
+ * A self-similarity matrix of n frames is symmetric, so only the upper triangle including the diagonal is stored,
+ * row by row: row i holds the n-i elements (i,i), (i,i+1), ..., (i,n-1) and starts at offset i*n - i*(i-1)/2. That is
+ * n*(n+1)/2 values instead of n*n, and any element is found in O(1) by swapping (i,j) into the upper triangle.
+ *
+ * Row i of the full matrix is the column i of the upper triangle (elements j < i, one per packed row) followed by the
+ * contiguous tail of packed row i (elements j >= i); rows and columns are the same by symmetry. upperRow(i) gives
+ * direct access to the contiguous tail for loops that fill or scan the matrix.
+ */
+template<typename T>
+class similarity_matrix {
+
+public:
+    // Row (or, by symmetry, column) i of the full matrix
+    class row_view {
+    public:
+        row_view(const similarity_matrix* m, size_t i) : matrix(m), index(i) {}
+        T operator[](size_t j) const { return matrix->at(index, j); }
+        size_t size() const { return matrix->size(); }
+    private:
+        const similarity_matrix* matrix;
+        size_t index;
+    };
+
+    similarity_matrix() = default;
+    explicit similarity_matrix(size_t n) { resize(n); }
+
+    // Resize to n frames, all elements zero
+    void resize(size_t n) {
+        numFrames = n;
+        values.assign(n * (n + 1) / 2, T(0));
+    }
+
+    void clear() {
+        numFrames = 0;
+        values.clear();
+        values.shrink_to_fit();
+    }
+
+    // Number of frames (rows and columns)
+    size_t size() const { return numFrames; }
+
+    // Number of stored values
+    size_t storageSize() const { return values.size(); }
+
+    // Largest |i-j| that is stored, every element of the full matrix
+    size_t maxLag() const { return numFrames ? numFrames - 1 : 0; }
+    bool contains(size_t, size_t) const { return true; }
+
+    T at(size_t i, size_t j) const { return values[index(i, j)]; }
+    T& at(size_t i, size_t j) { return values[index(i, j)]; }
+    T operator()(size_t i, size_t j) const { return at(i, j); }
+
+    row_view row(size_t i) const { return row_view(this, i); }
+    row_view column(size_t j) const { return row_view(this, j); }
+
+    // Elements (i,i) .. (i,n-1), stored contiguously
+    T* upperRow(size_t i) { return values.data() + rowOffset(i); }
+    const T* upperRow(size_t i) const { return values.data() + rowOffset(i); }
+
+    T* data() { return values.data(); }
+    const T* data() const { return values.data(); }
+
+private:
+    size_t numFrames = 0;
+    std::vector<T> values;
+
+    size_t rowOffset(size_t i) const { return i * (2 * numFrames - i + 1) / 2; }
+
+    size_t index(size_t i, size_t j) const {
+        if (i > j)
+            std::swap(i, j);
+        return rowOffset(i) + (j - i);
+    }
+};
+
+/* Banded self-similarity matrix in lag-major storage
+ * Structure analysis rarely needs similarities further apart than a bounded lag, and the full matrix of an hour of
+ * audio at a 10 ms hop would not fit in memory anyway. This matrix keeps only the cells with |i-j| <= maxLag, in O(n*L)
+ * memory: lag l is the diagonal (0,l), (1,l+1), ..., (n-1-l,n-1), stored contiguously, and the diagonals follow each
+ * other from lag 0 up, so diagonal l starts at l*n - l*(l-1)/2. Walking along the time axis at a fixed lag, as
+ * novelty kernels and repetition detectors do, is a unit-stride scan.
+ *
+ * size(), at(i,j), contains(i,j) and maxLag() mirror similarity_matrix, so consumers can be written once for both.
+ * Cells outside the band read as the configured outside value (distance 1, unrelated frames, by default), which is
+ * also why there is no writable at(): the band is written through diagonal().
+ */
+template<typename T>
+class banded_similarity_matrix {
+
+public:
+    banded_similarity_matrix() = default;
+    banded_similarity_matrix(size_t n, size_t maxLag) { resize(n, maxLag); }
+
+    // Resize to n frames with lags up to maxLag (clamped to n-1), all elements zero
+    void resize(size_t n, size_t maxLag) {
+        numFrames = n;
+        numLags = n ? std::min(maxLag, n - 1) + 1 : 0;
+        values.assign(numLags ? diagonalOffset(numLags) : 0, T(0));
+    }
+
+    void clear() {
+        numFrames = numLags = 0;
+        values.clear();
+        values.shrink_to_fit();
+    }
+
+    // Value read for cells outside the band
+    void setOutsideValue(T value) { outside = value; }
+    T outsideValue() const { return outside; }
+
+    size_t size() const { return numFrames; }
+    size_t maxLag() const { return numLags ? numLags - 1 : 0; }
+    size_t storageSize() const { return values.size(); }
+
+    bool contains(size_t i, size_t j) const { return (i > j ? i - j : j - i) < numLags; }
+
+    T at(size_t i, size_t j) const {
+        if (i > j)
+            std::swap(i, j);
+        return j - i < numLags ? values[diagonalOffset(j - i) + i] : outside;
+    }
+
+    T operator()(size_t i, size_t j) const { return at(i, j); }
+
+    // Elements (i,i+lag) for i = 0 .. size()-1-lag, stored contiguously
+    T* diagonal(size_t lag) { return values.data() + diagonalOffset(lag); }
+    const T* diagonal(size_t lag) const { return values.data() + diagonalOffset(lag); }
+    size_t diagonalLength(size_t lag) const { return numFrames - lag; }
+
+    T* data() { return values.data(); }
+    const T* data() const { return values.data(); }
+
+private:
+    size_t numFrames = 0, numLags = 0;
+    T outside = T(1);
+    std::vector<T> values;
+
+    size_t diagonalOffset(size_t lag) const { return lag * (2 * numFrames - lag + 1) / 2; }
+};
+
+#endif // SIMILARITYMATRIX_H
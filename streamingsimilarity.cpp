@@ -0,0 +1,136 @@
+#include "streamingsimilarity.h"
+
+#include <algorithm>
+#include <cmath>
+
+template<typename T>
+void streaming_similarity<T>::init(size_t dim, const novelty_config& config) {
+    this->dim = dim;
+    K = std::max<size_t>(1, config.kernelHalfWidth);
+    H = std::max(2 * K, config.history);
+    peakRadius = config.peakRadius;
+    threshold = config.threshold;
+
+    /* Steps of half width k_m = K*m/M. A cell at Chebyshev distance r from the centre, k_(m-1) < r <= k_m, is in the
+     * boxes m .. M, so box m gets the taper at the middle of its step minus the taper at the middle of the next one
+     */
+    const size_t steps = std::min(std::max<size_t>(1, config.kernelSteps), K);
+    const double sigma = config.taperSigma * K;
+    auto taper = [sigma](double r) { return std::exp(-r * r / (2 * sigma * sigma)); };
+    widths.clear();
+    weights.clear();
+    size_t previous = 0;
+    double total = 0;
+    for (size_t m=1; m<=steps; m++) {
+        const size_t k = (K * m + steps - 1) / steps;
+        const size_t next = (K * (m + 1) + steps - 1) / steps;
+        const double weight = taper(0.5 * (previous + k)) - (m < steps ? taper(0.5 * (k + next)) : 0.0);
+        widths.push_back(k);
+        widths.push_back(2 * k);
+        weights.push_back(weight);
+        total += weight * 2 * k * k;
+        previous = k;
+    }
+    // Normalized so that distance 1 across the kernel and 0 within gives novelty 1
+    for (double& weight : weights)
+        weight /= total;
+
+    frames.assign(H * dim, T(0));
+    normalized.assign(dim, T(0));
+    dots.assign(H, T(0));
+    rows.assign(H * H, T(1));
+    prefix.assign(H + 1, 0.0);
+    sums.assign(widths.size() * (2 * K + 1), 0.0);
+    novelty.assign(2 * peakRadius + 1, T(0));
+    reset();
+}
+
+template<typename T>
+void streaming_similarity<T>::reset() {
+    std::fill(frames.begin(), frames.end(), T(0));
+    std::fill(rows.begin(), rows.end(), T(1));
+    std::fill(sums.begin(), sums.end(), 0.0);
+    std::fill(novelty.begin(), novelty.end(), T(0));
+    numFrames = decided = 0;
+}
+
+// Store the normalized frame, compute its row of distances and slide every window sum by one frame
+template<typename T>
+void streaming_similarity<T>::appendRow(const T* features) {
+    const uint64_t t = numFrames;
+    T norm = 0;
+    for (size_t k=0; k<dim; k++)
+        norm += features[k] * features[k];
+    const T inv = norm > 0 ? T(1) / std::sqrt(norm) : T(0);
+    for (size_t k=0; k<dim; k++)
+        normalized[k] = features[k] * inv;
+
+    // Products with all frames in the history at once, frame t-H still in the slot of t; slots not filled yet are zero
+    simd->matVec(frames.data(), normalized.data(), dots.data(), H, dim);
+    std::copy(normalized.begin(), normalized.end(), frames.begin() + t % H * dim);
+    T* row = rows.data() + t % H * H;
+    const size_t filled = size_t(std::min<uint64_t>(t, H));
+    for (size_t l=1; l<=filled; l++) {
+        row[l - 1] = 1 - dots[(t - l) % H];
+        prefix[l] = prefix[l - 1] + row[l - 1];
+    }
+    for (size_t l=filled+1; l<=H; l++) {
+        row[l - 1] = T(1);
+        prefix[l] = prefix[l - 1];
+    }
+
+    /* Window [t-w, t) becomes [t+1-w, t+1): the pairs of frame t with the frames before it enter, the pairs of frame
+     * t-w with the frames after it leave. Both are counted twice, for D(i,j) and D(j,i).
+     */
+    numFrames++;
+    for (size_t w=0; w<widths.size(); w++) {
+        const size_t width = widths[w];
+        double sum = t > 0 ? windowSum(w, t) : 0.0;
+        sum += 2 * prefix[std::min<uint64_t>(width - 1, t)];
+        if (t >= width) {
+            const uint64_t s = t - width;
+            double column = 0;
+            for (uint64_t i=s+1; i<t; i++)
+                column += rows[i % H * H + (i - s - 1)];
+            sum -= 2 * column;
+        }
+        windowSum(w, t + 1) = sum;
+    }
+}
+
+// Novelty of the frame the kernel now fits around; true when the frame peakRadius before it can be decided
+template<typename T>
+bool streaming_similarity<T>::updateNovelty() {
+    if (numFrames < K)
+        return false;
+    const uint64_t c = numFrames - K;
+
+    // Q of the window ending before frame end, 0 for windows that end before the stream started
+    auto Q = [this](size_t w, uint64_t end) { return end > 0 ? windowSum(w, end) : 0.0; };
+    double value = 0;
+    for (size_t m=0; m<weights.size(); m++) {
+        const size_t k = widths[2 * m];
+        value += weights[m] * (Q(2 * m + 1, c + k) - 2 * Q(2 * m, c) - 2 * Q(2 * m, c + k));
+    }
+    novelty[c % novelty.size()] = T(value);
+    return c >= peakRadius;
+}
+
+// A boundary is a novelty peak above the threshold, the first of equal values within peakRadius frames
+template<typename T>
+bool streaming_similarity<T>::isBoundary(uint64_t frame) const {
+    const T value = noveltyAt(frame);
+    if (!(value >= T(threshold)))
+        return false;
+    const uint64_t first = frame > peakRadius ? frame - peakRadius : 0;
+    for (uint64_t c=first; c<frame; c++)
+        if (noveltyAt(c) >= value)
+            return false;
+    for (uint64_t c=frame+1; c<=frame+peakRadius && c<numFrames; c++)
+        if (noveltyAt(c) > value)
+            return false;
+    return true;
+}
+
+template class streaming_similarity<double>;
+template class streaming_similarity<float>;
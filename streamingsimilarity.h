@@ -0,0 +1,112 @@
+#ifndef STREAMINGSIMILARITY_H
+#define STREAMINGSIMILARITY_H
+
+#include "kernels.h"
+#include "profiler.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Checkerboard kernel and peak picking of the novelty curve, in frames
+struct novelty_config {
+    size_t kernelHalfWidth = 64;    // K, frames on each side of the centre of the kernel
+    size_t kernelSteps = 4;         // nested boxes that approximate the Gaussian taper
+    double taperSigma = 0.5;        // standard deviation of the taper relative to K
+    size_t peakRadius = 32;         // a boundary is the largest novelty within this many frames on either side
+    double threshold = 0.002;       // smallest novelty of a live boundary, in cosine distance (small between MFCC frames)
+    double relativeThreshold = 0.2; // smallest novelty of an offline boundary, as a fraction of the way from the median
+                                    // to the maximum of the curve, 0 to use threshold
+    double noiseFloor = 1e-4;       // novelty of an offline boundary at least, so that audio without changes has none
+    size_t history = 0;             // frames of similarity rows kept, at least 2K (0 for 2K)
+};
+
+/* Incremental self-similarity and Foote novelty for streaming input
+ * Every pushed feature vector is normalized and compared against the last history() frames, which appends one row of
+ * the band of cosine distances D(t, t-l), l = 1 .. history(). From these rows the novelty of the checkerboard kernel of
+ * half width K is updated as the frames arrive (Foote, 2000). With A = [c-K,c) and B = [c,c+K) the novelty at frame c
+ * is the mean distance across the kernel, A x B, minus the mean distance within it, A x A and B x B. Writing Q(s,e) for
+ * the sum of D over [s,e) x [s,e), that is
+ *   novelty(c) ~ Q(c-K,c+K) - 2 Q(c-K,c) - 2 Q(c,c+K)
+ * so only the sums of square windows sliding along the diagonal are needed. Each window sum is updated per frame by
+ * adding the new row and removing the column of the frame that falls out, O(K) work per frame instead of the O(K^2) of
+ * evaluating the kernel. The Gaussian taper of the kernel is approximated by kernelSteps nested boxes, which gives a
+ * staircase in the Chebyshev distance from the centre that matches the Gaussian at the middle of every step; the offline
+ * segmentation uses the exact taper. The sums are kept in double precision, so they do not drift over hours of input.
+ *
+ * The novelty of frame c is known once frame c+K-1 arrived, and whether it is a boundary (a local maximum within
+ * peakRadius frames above the threshold) peakRadius frames later, so every frame is reported a fixed latency() frames
+ * after it was pushed. The first K frames are scored with the part of the kernel that lies inside the stream.
+ */
+template<typename T>
+class streaming_similarity {
+
+public:
+    explicit streaming_similarity(const basic_dsp_kernels<T>& simd = kernels<T>()) : simd(&simd) {}
+
+    // Set up the buffers for dim features per frame, and start a new stream
+    void init(size_t dim, const novelty_config& config = novelty_config());
+
+    // Drop the history and start a new stream with the same configuration
+    void reset();
+
+    /* Push the features of the next frame and call sink(frame, novelty, boundary) for the frame whose boundary decision
+     * became final, latency() frames behind the pushed one
+     */
+    template<typename Sink>
+    void push(const T* features, Sink&& sink) {
+        stage_timer timer;
+        appendRow(features);
+        const bool decidedFrame = updateNovelty();
+        timer.lap(pipeline_stage::streamingSimilarity);
+        if (decidedFrame) {
+            sink(decided, noveltyAt(decided), isBoundary(decided));
+            decided++;
+        }
+    }
+
+    /* Report the frames still waiting for a decision at the end of the stream; the last K frames, which the kernel
+     * does not fit around, get novelty 0
+     */
+    template<typename Sink>
+    void finish(Sink&& sink) {
+        for (; decided < numFrames; decided++)
+            sink(decided, noveltyAt(decided), isBoundary(decided));
+    }
+
+    // Cosine distances of frame to frame-1, ..., frame-history(); only the last history() frames are kept
+    const T* row(uint64_t frame) const { return rows.data() + frame % H * H; }
+
+    size_t dimension() const { return dim; }
+    size_t history() const { return H; }
+    size_t latency() const { return K + peakRadius - 1; }
+    uint64_t frameCount() const { return numFrames; }
+
+private:
+    const basic_dsp_kernels<T>* simd;
+    size_t dim = 0, H = 0, K = 0, peakRadius = 0;
+    double threshold = 0;
+    uint64_t numFrames = 0, decided = 0;
+
+    std::vector<T> frames;          // H normalized frames, frame f in slot f % H
+    std::vector<T> normalized;      // the new frame, stored after it was compared with the frame it replaces
+    std::vector<T> dots, rows;      // products with the new frame, H rows of H distances
+    std::vector<double> prefix;     // prefix sums of the new row
+
+    std::vector<size_t> widths;     // k and 2k of every step of the kernel
+    std::vector<double> weights;    // taper weight of every step, normalized by the weight of the whole kernel
+    std::vector<double> sums;       // Q of the window of every width ending at the last 2K+1 frames
+    std::vector<T> novelty;         // novelty of the last 2 peakRadius + 1 frames
+
+    // Q of the window of width widths[w] that ends before frame end, end within the last 2K+1 frames
+    double& windowSum(size_t w, uint64_t end) { return sums[w * (2 * K + 1) + end % (2 * K + 1)]; }
+
+    // Novelty of frame c, 0 where the kernel does not fit before the end of the frames pushed so far
+    T noveltyAt(uint64_t c) const { return c + K <= numFrames ? novelty[c % novelty.size()] : T(0); }
+
+    void appendRow(const T* features);
+    bool updateNovelty();
+    bool isBoundary(uint64_t frame) const;
+};
+
+#endif // STREAMINGSIMILARITY_H
@@ -1,95 +1,251 @@
-#include <atomic>
-#include <condition_variable>
-#include <deque>
-#include <mutex>
-#include <thread>
-#include <vector>
-
-/* Building a simple task system using a scheduler
- * (_q) std::deque (double-ended queue) is an indexed sequence container that allows fast insertion
- * and deletion at both its beginning and its end. The storage of a deque is automatically expanded and contracted as needed.
- * (_mutex) The mutex class is a synchronization primitive that can be used to protect shared data from being
- * simultaneously accessed by multiple threads. The class unique_lock is a general-purpose mutex ownership
- * wrapper allowing deferred locking, ...
- */
-class notification_queue {
-    std::deque<std::function<void()>> _q;
-    bool _done{false};
-    std::mutex _mutex;
-    std::condition_variable _ready;
-
-public:
-    void done() {
-        {
-            std::unique_lock<std::mutex> lock{_mutex};
-            _done = true;
+#include "task.h"
+
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+void notification_queue::done() {
+    {
+        std::unique_lock<std::mutex> lock{_mutex};
+        _done = true;
+    }
+    _ready.notify_all();
+}
+
+bool notification_queue::pop(task& x) {
+    std::unique_lock<std::mutex> lock{_mutex};
+    while (_q.empty() && !_done) _ready.wait(lock);
+    if (_q.empty())
+        return false;
+    x = std::move(_q.front()); // access the first element
+    _q.pop_front(); // removes the first element
+    return true;
+}
+
+bool notification_queue::try_pop(task& x) {
+    std::unique_lock<std::mutex> lock{_mutex, std::try_to_lock};
+    if (!lock || _q.empty())
+        return false;
+    x = std::move(_q.front());
+    _q.pop_front();
+    return true;
+}
+
+mutex_task_system::mutex_task_system(unsigned count, unsigned spin) : _count(std::max(1u, count)), _spin(spin) {
+    for (unsigned n=0; n!=_count; ++n) {
+        _threads.emplace_back([&, n](){ run(n); });
+    }
+}
+
+mutex_task_system::~mutex_task_system() {
+    for (auto& e : _q) {
+        e.done();
+    }
+    for (auto& e : _threads) {
+        e.join(); // waits for a thread to finish its execution
+    }
+}
+
+void mutex_task_system::run(unsigned i) {
+    while (true) {
+        task f; // move-only polymorphic function wrapper
+        // Steal from any queue that is not busy, starting with our own
+        for (unsigned n=0; n!=_count*_spin && !f; ++n)
+            _q[(i+n) % _count].try_pop(f);
+        if (!f && !_q[i].pop(f))
+            return;
+        f();
+        finished();
+    }
+}
+
+void mutex_task_system::finished() {
+    if (--_pending == 0) {
+        // Taking the lock orders the notification after the check of a waiter that is about to wait
+        std::unique_lock<std::mutex> lock{_idleMutex};
+        _idle.notify_all();
+    }
+}
+
+void mutex_task_system::wait_idle() {
+    std::unique_lock<std::mutex> lock{_idleMutex};
+    while (_pending != 0) _idle.wait(lock);
+}
+
+namespace {
+
+// The task system and the index of the worker that runs on this thread, if any
+thread_local const task_system* currentSystem = nullptr;
+thread_local unsigned currentWorker = 0;
+
+inline void cpuRelax() {
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
+    _mm_pause();
+#endif
+}
+
+}
+
+task_system::task_system(unsigned count, unsigned spin) : _count(std::max(1u, count)), _spin(spin) {
+    for (unsigned n=0; n!=_count; ++n)
+        _deques.emplace_back(new chase_lev_deque<task*>());
+    for (unsigned n=0; n!=_count; ++n)
+        _threads.emplace_back([&, n](){ run(n); });
+}
+
+task_system::~task_system() {
+    {
+        std::unique_lock<std::mutex> lock{_parkMutex};
+        _done = true;
+        _epoch++;
+    }
+    _wake.notify_all();
+    for (auto& e : _threads) {
+        e.join();
+    }
+    task* t = nullptr;
+    while (_free.try_pop(t))
+        delete t;
+    for (task* o : _overflow)
+        delete o;
+}
+
+task* task_system::acquire() {
+    task* t = nullptr;
+    if (_free.try_pop(t))
+        return t;
+    // One load when nothing overflowed, which is the common case
+    if (_overflowSize.load(std::memory_order_relaxed) > 0) {
+        std::lock_guard<std::mutex> lock{_overflowMutex};
+        if (!_overflow.empty()) {
+            t = _overflow.back();
+            _overflow.pop_back();
+            _overflowSize.store(_overflow.size(), std::memory_order_relaxed);
+            return t;
         }
-        _ready.notify_all();
     }
+    return new task();
+}
 
-    void pop(std::function<void()>& x) {
-        std::unique_lock<std::mutex> lock{_mutex};
-        while (_q.empty() && !_done) _ready.wait(lock);
-        x = std::move(_q.front());
-        _q.pop_front();
+void task_system::release(task* t) {
+    t->reset(); // what the callable captured goes now, not when the task is reused
+    if (_free.try_push(t))
+        return;
+    std::lock_guard<std::mutex> lock{_overflowMutex};
+    try {
+        _overflow.push_back(t); // grows only past the largest burst so far
+    } catch (...) {
+        delete t;
+        return;
+    }
+    _overflowSize.store(_overflow.size(), std::memory_order_relaxed);
+}
+
+void task_system::submit(task* t) {
+    _pending++;
+    if (currentSystem == this) {
+        _deques[currentWorker]->push(t);
+    } else {
+        while (!_injector.try_push(t))
+            std::this_thread::yield(); // full, the workers are behind
     }
 
-    template<typename F>
-    void push(F&& f) {
+    // Publish the task before looking for sleepers, see park()
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (_sleepers.load(std::memory_order_relaxed) != 0) {
         {
-            std::unique_lock<std::mutex> lock{_mutex};
-            _q.emplace_back(std::forward<F>(f));
-        }
-        _ready.notify_one();
-    }
-};
-
-/* (_index) Atomic is a new kid in town since C++11. Atomic is here to ensure no races are to be expected
- * while accessing a variable. The possible syntax can result in a very compact code, at which you may not always
- * be aware the _index you’re incrementing actually involves the overhead of atomic operations.
- */
-class task_system {
-    // returns the number of concurrent threads supported by the implementation
-    const unsigned _count{std::thread::hardware_concurrency()};
-    // one notification queue for each thread...
-    std::vector<std::thread> _threads;
-    std::vector<notification_queue> _q{_count};
-    std::atomic<unsigned> _index{0};
-
-    void run(unsigned i) {
-        while (true) {
-            std::function<void()> f; // store a function
-            _q[i].pop(f);
-            f();
+            std::unique_lock<std::mutex> lock{_parkMutex};
+            _epoch++;
         }
+        _wake.notify_one();
     }
+}
 
-public:
-    task_system() {
-        for (unsigned n=0; n!=_count; ++n) {
-            _threads.emplace_back([&, n](){ run(n); });
-        }
+task* task_system::find(unsigned i) {
+    task* t = nullptr;
+    if (_deques[i]->pop(t) || _injector.try_pop(t))
+        return t;
+    for (unsigned n=1; n<_count; ++n) {
+        if (_deques[(i+n) % _count]->steal(t))
+            return t;
+    }
+    return nullptr;
+}
+
+bool task_system::hasWork() const {
+    if (!_injector.empty())
+        return true;
+    for (const auto& d : _deques) {
+        if (!d->empty())
+            return true;
     }
+    return false;
+}
 
-    ~task_system() {
-        for (auto& e : _threads) {
-            e.join(); // waits for a thread to finish its execution
+// Wait for a wakeup, returns false once the task system is done and every queue is drained
+bool task_system::park() {
+    std::unique_lock<std::mutex> lock{_parkMutex};
+    _sleepers.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (hasWork()) {
+        _sleepers.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+    }
+    if (_done) {
+        _sleepers.fetch_sub(1, std::memory_order_relaxed);
+        return false;
+    }
+    const std::uint64_t epoch = _epoch;
+    while (epoch == _epoch) _wake.wait(lock);
+    _sleepers.fetch_sub(1, std::memory_order_relaxed);
+    return true;
+}
+
+void task_system::run(unsigned i) {
+    currentSystem = this;
+    currentWorker = i;
+    while (true) {
+        task* t = find(i);
+        for (unsigned n=0; n<_spin && !t; ++n) {
+            cpuRelax();
+            t = find(i);
         }
-        for (auto& e : _q) {
-            e.done();
+        if (!t) {
+            if (!park())
+                return;
+            continue;
         }
+        (*t)();
+        release(t);
+        finished();
     }
+}
 
-    template<typename F>
-    void async(F&& f) {
-        auto i = _index++;
-        _q[i % _count].push(std::forward<F>(f));
+void task_system::finished() {
+    if (--_pending == 0) {
+        // Taking the lock orders the notification after the check of a waiter that is about to wait
+        std::unique_lock<std::mutex> lock{_idleMutex};
+        _idle.notify_all();
     }
+}
+
+void task_system::wait_idle() {
+    std::unique_lock<std::mutex> lock{_idleMutex};
+    while (_pending != 0) _idle.wait(lock);
+}
 
+task_system& default_task_system() {
+    static task_system ts; // thread-safe initialisation on first use
+    return ts;
+}
 
+void countdown_latch::count_down() {
+    std::unique_lock<std::mutex> lock{_mutex};
+    if (--_count == 0)
+        _zero.notify_all();
+}
 
-};
-/* The template function std::async runs the function f asynchronously (potentially in a separate thread
- * which may be part of a thread pool) and returns a std::future that will eventually hold the result of
- * that function call.
- */
+void countdown_latch::wait() {
+    std::unique_lock<std::mutex> lock{_mutex};
+    while (_count != 0) _zero.wait(lock);
+}
@@ -1,40 +1,946 @@
 #ifndef TASK_H
 #define TASK_H
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
 #include <functional>
-#include <future>
 #include <memory>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 template<class T>
 using decay_t = typename std::decay<T>::type;
 template<class T>
 using result_of_t = typename std::result_of<T>::type;
 
+template<typename T>
+class task_future;
+
+/* Move-only task
+ * A callable with no arguments behind a type-erased handle, like std::function<void()>, but move-only, so it also
+ * takes lambdas that capture a unique_ptr or a packaged_task, and with Size bytes of storage of its own: a callable
+ * that fits there and moves without throwing is kept in the task and costs no allocation, a larger one goes to the
+ * heap. Instead of a virtual base class every stored type has one static table of functions, and an empty or
+ * moved-from task has none.
+ */
+template<std::size_t Size>
+class basic_task {
+    struct operations {
+        void (*invoke)(void* storage);
+        void (*relocate)(void* from, void* to);     // move-construct at to, destroy at from
+        void (*destroy)(void* storage);
+    };
+
+    template<typename F>
+    struct inline_operations {
+        static void invoke(void* s) { (*static_cast<F*>(s))(); }
+        static void relocate(void* from, void* to) {
+            new (to) F(std::move(*static_cast<F*>(from)));
+            static_cast<F*>(from)->~F();
+        }
+        static void destroy(void* s) { static_cast<F*>(s)->~F(); }
+        static const operations* table() {
+            static const operations t = {invoke, relocate, destroy};
+            return &t;
+        }
+    };
+
+    // The storage holds a pointer to the callable
+    template<typename F>
+    struct heap_operations {
+        static F* get(void* s) { return *static_cast<F**>(s); }
+        static void invoke(void* s) { (*get(s))(); }
+        static void relocate(void* from, void* to) { new (to) F*(get(from)); }
+        static void destroy(void* s) { delete get(s); }
+        static const operations* table() {
+            static const operations t = {invoke, relocate, destroy};
+            return &t;
+        }
+    };
+
+    typename std::aligned_storage<Size, alignof(std::max_align_t)>::type _storage;
+    const operations* _operations{nullptr};
+
+    template<typename F, typename A>
+    void construct(A&& f, std::true_type) {
+        new (&_storage) F(std::forward<A>(f));
+        _operations = inline_operations<F>::table();
+    }
+    template<typename F, typename A>
+    void construct(A&& f, std::false_type) {
+        new (&_storage) F*(new F(std::forward<A>(f)));
+        _operations = heap_operations<F>::table();
+    }
+
+public:
+    static_assert(Size >= sizeof(void*), "the storage must hold at least a pointer");
+
+    // Whether a callable of type F is stored without an allocation
+    template<typename F>
+    static constexpr bool stored_inline() {
+        return sizeof(F) <= Size && alignof(F) <= alignof(std::max_align_t) &&
+               std::is_nothrow_move_constructible<F>::value;
+    }
+
+    basic_task() noexcept {}
+
+    template<typename F, typename = typename std::enable_if<!std::is_same<decay_t<F>, basic_task>::value>::type>
+    basic_task(F&& f) {
+        construct<decay_t<F>>(std::forward<F>(f), std::integral_constant<bool, stored_inline<decay_t<F>>()>());
+    }
+
+    basic_task(basic_task&& other) noexcept : _operations(other._operations) {
+        if (_operations) {
+            _operations->relocate(&other._storage, &_storage);
+            other._operations = nullptr;
+        }
+    }
+
+    basic_task& operator=(basic_task&& other) noexcept {
+        if (this != &other) {
+            reset();
+            if (other._operations) {
+                other._operations->relocate(&other._storage, &_storage);
+                _operations = other._operations;
+                other._operations = nullptr;
+            }
+        }
+        return *this;
+    }
+
+    ~basic_task() { reset(); }
+
+    // Destroy the callable and what it captured
+    void reset() noexcept {
+        if (_operations) {
+            _operations->destroy(&_storage);
+            _operations = nullptr;
+        }
+    }
+
+    explicit operator bool() const noexcept { return _operations != nullptr; }
+
+    // Must not be empty
+    void operator()() { _operations->invoke(&_storage); }
+};
+
+// The task of the schedulers: a lambda that captures up to eight pointers or a shared state and its arguments fits
+typedef basic_task<64> task;
+
+/* Building a simple task system using a scheduler
+ * (_q) std::deque (double-ended queue) is an indexed sequence container that allows fast insertion
+ * and deletion at both its beginning and its end. The storage of a deque is automatically expanded and contracted as needed.
+ * (_q) What task does is represent any callable that can be invoked with no arguments, without allocating for small ones.
+ * (_mutex) The mutex class is a synchronization primitive that can be used to protect shared data from being
+ * simultaneously accessed by multiple threads. The class unique_lock is a general-purpose mutex ownership
+ * wrapper allowing deferred locking, ...
+ */
+class notification_queue {
+    std::deque<task> _q;
+    bool _done{false};
+    std::mutex _mutex;
+    std::condition_variable _ready;
+
+public:
+    void done();
+
+    // Wait for a task, returns false once the queue is done and has been drained
+    bool pop(task& x);
+
+    // Take a task if the queue is not locked by another thread and not empty
+    bool try_pop(task& x);
+
+    template<typename F>
+    void push(F&& f) {
+        {
+            std::unique_lock<std::mutex> lock{_mutex};
+            _q.emplace_back(std::forward<F>(f));
+        }
+        _ready.notify_one();
+    }
+
+    // Append a task if the queue is not locked by another thread, f is left untouched otherwise
+    template<typename F>
+    bool try_push(F&& f) {
+        {
+            std::unique_lock<std::mutex> lock{_mutex, std::try_to_lock};
+            if (!lock)
+                return false;
+            _q.emplace_back(std::forward<F>(f));
+        }
+        _ready.notify_one();
+        return true;
+    }
+};
+
+/* (_index) Atomic is here to ensure no races are to be expected while accessing a variable. The possible syntax
+ * can result in a very compact code, at which you may not always be aware the _index you’re incrementing actually
+ * involves the overhead of atomic operations.
+ *
+ * Work stealing (Sean Parent, "Better Code: Concurrency"): async() offers the task to the queues in turn with
+ * try_push(), starting at the next queue of the round robin, for spin rounds over all queues before it waits for the
+ * lock of its own queue. A worker likewise tries every queue with try_pop() before it blocks on its own. A busy queue
+ * is skipped instead of waited for, so a slow task delays only the tasks nobody else picks up, and an idle worker
+ * takes tasks from the queues of busy ones. With spin = 0 every task goes to its round-robin queue and stays there.
+ *
+ * wait_idle() blocks until every task handed to async() so far, and every task those spawned, has run; it must not be
+ * called from a worker. The destructor marks every queue done before joining, so the workers finish the queued tasks
+ * and return.
+ *
+ * Every push and pop takes the lock of a queue and may signal its condition variable. The lock-free task_system below
+ * replaced it as the scheduler of the analysis; it stays as the reference for the scheduler benchmarks.
+ */
+class mutex_task_system {
+    // number of worker threads, by default the number of concurrent threads supported by the implementation
+    const unsigned _count;
+    // rounds over all queues before async() and the workers block on one queue
+    const unsigned _spin;
+    // one notification queue for each thread...
+    std::vector<std::thread> _threads;
+    std::vector<notification_queue> _q{_count};
+    std::atomic<unsigned> _index{0};
+    // tasks handed to async() that have not finished
+    std::atomic<std::size_t> _pending{0};
+    std::mutex _idleMutex;
+    std::condition_variable _idle;
+
+    void run(unsigned i);
+    void finished();
+
+public:
+    explicit mutex_task_system(unsigned count = std::thread::hardware_concurrency(), unsigned spin = 4);
+    ~mutex_task_system();
+
+    template<typename F>
+    void async(F&& f) {
+        _pending++;
+        auto i = _index++;
+        for (unsigned n=0; n!=_count*_spin; ++n) {
+            if (_q[(i+n) % _count].try_push(std::forward<F>(f))) // only moves from f when it succeeds
+                return;
+        }
+        _q[i % _count].push(std::forward<F>(f)); // forwards lvalues as either lvalues or as rvalues, depending on F
+    }
+
+    // Wait until all tasks have run
+    void wait_idle();
+
+    // Number of worker threads
+    unsigned size() const { return _count; }
+    unsigned spin() const { return _spin; }
+};
+
+/* Chase-Lev work-stealing deque (Chase and Lev, 2005; memory orders after Le, Pop, Cohen and Zappa Nardelli, 2013)
+ * The owner thread pushes and pops at the bottom, LIFO, without a lock or a read-modify-write except when it takes the
+ * last item; other threads steal from the top, FIFO, with one compare-and-swap. The ring doubles when it is full. A
+ * thief may still read the old ring, so replaced rings are kept until the deque is destroyed: at most as much memory
+ * again as the largest ring. Holds trivially copyable items, pointers to tasks in the task_system.
+ */
+template<typename T>
+class chase_lev_deque {
+    struct ring {
+        explicit ring(std::int64_t capacity) : capacity(capacity), slots(new std::atomic<T>[capacity]) {}
+        T get(std::int64_t i) const { return slots[i & (capacity - 1)].load(std::memory_order_relaxed); }
+        void put(std::int64_t i, T x) { slots[i & (capacity - 1)].store(x, std::memory_order_relaxed); }
+
+        const std::int64_t capacity;    // a power of two
+        std::unique_ptr<std::atomic<T>[]> slots;
+    };
+
+    std::atomic<std::int64_t> _top{0};
+    char _padTop[64];                   // keep the thieves' index and the owner's index on separate cache lines
+    std::atomic<std::int64_t> _bottom{0};
+    std::atomic<ring*> _ring;
+    std::vector<std::unique_ptr<ring>> _rings;     // current ring last, owner only
+
+public:
+    explicit chase_lev_deque(std::int64_t capacity = 256) {
+        std::int64_t c = 1;
+        while (c < capacity) c *= 2;
+        _rings.push_back(std::unique_ptr<ring>(new ring(c)));
+        _ring.store(_rings.back().get(), std::memory_order_relaxed);
+    }
+
+    chase_lev_deque(const chase_lev_deque&) = delete;
+    chase_lev_deque& operator=(const chase_lev_deque&) = delete;
+
+    // Owner only
+    void push(T x) {
+        const std::int64_t b = _bottom.load(std::memory_order_relaxed);
+        const std::int64_t t = _top.load(std::memory_order_acquire);
+        ring* a = _ring.load(std::memory_order_relaxed);
+        if (b - t > a->capacity - 1) {
+            ring* bigger = new ring(2 * a->capacity);
+            for (std::int64_t i=t; i<b; i++)
+                bigger->put(i, a->get(i));
+            _rings.push_back(std::unique_ptr<ring>(bigger));
+            _ring.store(bigger, std::memory_order_release);
+            a = bigger;
+        }
+        a->put(b, x);
+        _bottom.store(b + 1, std::memory_order_release);
+    }
+
+    // Owner only, the item pushed last
+    bool pop(T& x) {
+        const std::int64_t b = _bottom.load(std::memory_order_relaxed) - 1;
+        ring* a = _ring.load(std::memory_order_relaxed);
+        _bottom.store(b, std::memory_order_seq_cst);
+        std::int64_t t = _top.load(std::memory_order_seq_cst);
+        if (t > b) {
+            _bottom.store(b + 1, std::memory_order_relaxed);
+            return false;
+        }
+        x = a->get(b);
+        if (t == b) {
+            // The last item, race the thieves for it
+            const bool won = _top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                                          std::memory_order_relaxed);
+            _bottom.store(b + 1, std::memory_order_relaxed);
+            return won;
+        }
+        return true;
+    }
+
+    // Any thread, the oldest item; fails when the deque is empty or another thread took the item first
+    bool steal(T& x) {
+        std::int64_t t = _top.load(std::memory_order_seq_cst);
+        const std::int64_t b = _bottom.load(std::memory_order_seq_cst);
+        if (t >= b)
+            return false;
+        ring* a = _ring.load(std::memory_order_acquire);
+        T item = a->get(t);
+        if (!_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            return false;
+        x = item;
+        return true;
+    }
+
+    bool empty() const {
+        return _bottom.load(std::memory_order_seq_cst) <= _top.load(std::memory_order_seq_cst);
+    }
+};
+
+/* Bounded lock-free multi-producer multi-consumer queue (Dmitry Vyukov)
+ * Every cell carries a sequence number that tells producers and consumers whose turn it is, so a push or a pop costs
+ * one compare-and-swap on the shared position and no lock. Holds trivially copyable items.
+ */
+template<typename T>
+class mpmc_queue {
+    struct cell {
+        std::atomic<std::size_t> sequence;
+        T data;
+    };
+
+    std::unique_ptr<cell[]> _cells;
+    const std::size_t _mask;
+    char _pad0[64];
+    std::atomic<std::size_t> _enqueuePos{0};
+    char _pad1[64];
+    std::atomic<std::size_t> _dequeuePos{0};
+    char _pad2[64];
+
+    static std::size_t roundUp(std::size_t n) {
+        std::size_t c = 2;
+        while (c < n) c *= 2;
+        return c;
+    }
+
+public:
+    explicit mpmc_queue(std::size_t capacity) : _cells(new cell[roundUp(capacity)]), _mask(roundUp(capacity) - 1) {
+        for (std::size_t i=0; i<=_mask; i++)
+            _cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    mpmc_queue(const mpmc_queue&) = delete;
+    mpmc_queue& operator=(const mpmc_queue&) = delete;
+
+    // Append x, returns false if the queue is full
+    bool try_push(T x) {
+        std::size_t pos = _enqueuePos.load(std::memory_order_relaxed);
+        cell* c;
+        while (true) {
+            c = &_cells[pos & _mask];
+            const std::size_t seq = c->sequence.load(std::memory_order_acquire);
+            const std::ptrdiff_t dif = std::ptrdiff_t(seq) - std::ptrdiff_t(pos);
+            if (dif == 0) {
+                if (_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            } else if (dif < 0) {
+                return false;
+            } else {
+                pos = _enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+        c->data = x;
+        c->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Take the oldest item, returns false if the queue is empty
+    bool try_pop(T& x) {
+        std::size_t pos = _dequeuePos.load(std::memory_order_relaxed);
+        cell* c;
+        while (true) {
+            c = &_cells[pos & _mask];
+            const std::size_t seq = c->sequence.load(std::memory_order_acquire);
+            const std::ptrdiff_t dif = std::ptrdiff_t(seq) - std::ptrdiff_t(pos + 1);
+            if (dif == 0) {
+                if (_dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            } else if (dif < 0) {
+                return false;
+            } else {
+                pos = _dequeuePos.load(std::memory_order_relaxed);
+            }
+        }
+        x = c->data;
+        c->sequence.store(pos + _mask + 1, std::memory_order_release);
+        return true;
+    }
+
+    // May report an item that a producer is still writing
+    bool empty() const {
+        return _enqueuePos.load(std::memory_order_seq_cst) == _dequeuePos.load(std::memory_order_seq_cst);
+    }
+
+    std::size_t capacity() const { return _mask + 1; }
+};
+
+/* Lock-free work-stealing task system
+ * Every worker owns a chase_lev_deque. A task spawned on a worker goes to the bottom of that worker's deque and is
+ * usually run by it next, while its cache is warm; tasks from other threads go through a lock-free MPMC injection
+ * queue (a submitter waits while it is full). A worker looks for work in its own deque, then in the injection queue,
+ * then steals from the top of the other deques. Neither path takes a lock.
+ *
+ * The queues hold pointers to tasks. A worker that has run a task empties it and returns it to a lock-free free list,
+ * where async() takes it for the next callable. Tasks that do not fit into the free list, in a burst of more tasks than
+ * it holds, go to an overflow list under a mutex instead of being deleted, and async() takes them back from there when
+ * the free list runs empty. The free tasks grow to the most tasks ever in flight and are then reused, so after the first
+ * burst of a size, scheduling a callable that fits in a task allocates nothing.
+ *
+ * A worker that finds nothing keeps looking for spin rounds and then parks on a condition variable. Submitters wake a
+ * worker only if one is parked, which costs one atomic load when all are busy. A worker announces itself in _sleepers
+ * and looks for work once more before it waits, and a submitter publishes its task before it reads _sleepers; both
+ * sides are fenced, so either the submitter sees the sleeper or the sleeper sees the task, and no wakeup is lost.
+ *
+ * wait_idle() blocks until every task handed to async() so far, and every task those spawned, has run; it must not be
+ * called from a worker. The destructor lets the workers drain every queue, then joins them.
+ */
+class task_system {
+    // number of worker threads, by default the number of concurrent threads supported by the implementation
+    const unsigned _count;
+    // rounds of looking for work before a worker parks
+    const unsigned _spin;
+    std::vector<std::unique_ptr<chase_lev_deque<task*>>> _deques;
+    mpmc_queue<task*> _injector{4096};
+    mpmc_queue<task*> _free{8192};      // finished tasks, reused by async(), room for a full injection queue and more
+    std::vector<task*> _overflow;       // finished tasks that found _free full, under _overflowMutex
+    std::atomic<std::size_t> _overflowSize{0};
+    std::mutex _overflowMutex;
+    std::vector<std::thread> _threads;
+
+    std::atomic<unsigned> _sleepers{0};
+    bool _done{false};                  // under _parkMutex
+    std::uint64_t _epoch{0};            // under _parkMutex, advanced by every wakeup
+    std::mutex _parkMutex;
+    std::condition_variable _wake;
+
+    // tasks handed to async() that have not finished
+    std::atomic<std::size_t> _pending{0};
+    std::mutex _idleMutex;
+    std::condition_variable _idle;
+
+    task* acquire();
+    void release(task* t);
+    void submit(task* t);
+    task* find(unsigned i);
+    bool hasWork() const;
+    bool park();
+    void run(unsigned i);
+    void finished();
+
+public:
+    explicit task_system(unsigned count = std::thread::hardware_concurrency(), unsigned spin = 64);
+    ~task_system();
+
+    template<typename F>
+    void async(F&& f) {
+        task callable(std::forward<F>(f)); // forwards lvalues as either lvalues or as rvalues, depending on F
+        task* t = acquire();
+        *t = std::move(callable);
+        submit(t);
+    }
+
+    // Run f(args...) on a worker, the future holds its result
+    template<typename F, typename... Args>
+    task_future<result_of_t<decay_t<F>(decay_t<Args>...)>> spawn(F&& f, Args&&... args);
+
+    // Wait until all tasks have run
+    void wait_idle();
+
+    // Number of worker threads
+    unsigned size() const { return _count; }
+};
+
+// Task system shared by the analysis stages, started on first use
+task_system& default_task_system();
+
+/* Futures of tasks on a task_system
+ * spawn() runs a callable on the pool and returns a task_future of its result. Like std::shared_future, copies of a
+ * task_future share one result and get() returns a reference to it. get() and wait() block, so they belong on threads
+ * outside the pool; work on the pool is chained instead: then(f) runs f(value) as a new task once the value is there
+ * and returns the future of the result of f, and when_all() and when_any() complete a future when all or the first of
+ * a set of futures complete. Nothing in such a chain waits, the continuations are queued by whichever thread completes
+ * the future they wait for.
+ *
+ * An exception thrown by a task is kept in its future and rethrown by get(). Continuations of a failed future do not
+ * run; their futures take over the exception.
+ */
+
+// Storage for the result of a future, constructed when the task completes
+template<typename T>
+class future_value {
+    typename std::aligned_storage<sizeof(T), alignof(T)>::type _storage;
+    bool _set{false};
+
+public:
+    future_value() = default;
+    future_value(const future_value&) = delete;
+    future_value& operator=(const future_value&) = delete;
+    ~future_value() { if (_set) get().~T(); }
+
+    template<typename... A>
+    void set(A&&... a) {
+        new (&_storage) T(std::forward<A>(a)...);
+        _set = true;
+    }
+    T& get() { return *reinterpret_cast<T*>(&_storage); }
+};
+
+template<>
+class future_value<void> {
+public:
+    void set() {}
+    void get() {}
+};
+
+// Shared state of a task_future: the result or the exception, and the continuations waiting for either
+template<typename T>
+class future_state {
+    std::mutex _mutex;
+    std::condition_variable _readyCondition;
+    bool _ready{false};
+    std::vector<task> _continuations;
+
+    template<typename Set>
+    void complete(Set&& set) {
+        std::vector<task> continuations;
+        {
+            std::unique_lock<std::mutex> lock{_mutex};
+            set();
+            _ready = true;
+            continuations.swap(_continuations);
+        }
+        _readyCondition.notify_all();
+        for (auto& f : continuations)
+            pool.async(std::move(f));
+    }
+
+public:
+    explicit future_state(task_system& pool) : pool(pool) {}
+
+    task_system& pool;
+    future_value<T> value;          // valid once ready, unless error is set
+    std::exception_ptr error;
+
+    template<typename... A>
+    void setValue(A&&... a) { complete([&]() { value.set(std::forward<A>(a)...); }); }
+    void setError(std::exception_ptr e) { complete([&]() { error = e; }); }
+
+    bool ready() {
+        std::unique_lock<std::mutex> lock{_mutex};
+        return _ready;
+    }
+
+    void wait() {
+        std::unique_lock<std::mutex> lock{_mutex};
+        while (!_ready) _readyCondition.wait(lock);
+    }
+
+    // Queue f on the pool once the result or the exception is there
+    void onReady(task f) {
+        {
+            std::unique_lock<std::mutex> lock{_mutex};
+            if (!_ready) {
+                _continuations.push_back(std::move(f));
+                return;
+            }
+        }
+        pool.async(std::move(f));
+    }
+};
+
+// Store the result of f(args...) in state, or the exception it throws
+template<typename T>
+struct future_invoke {
+    template<typename F, typename... A>
+    static void run(future_state<T>& state, F& f, A&&... args) {
+        try {
+            state.setValue(f(std::forward<A>(args)...));
+        } catch (...) {
+            state.setError(std::current_exception());
+        }
+    }
+};
+
+template<>
+struct future_invoke<void> {
+    template<typename F, typename... A>
+    static void run(future_state<void>& state, F& f, A&&... args) {
+        try {
+            f(std::forward<A>(args)...);
+        } catch (...) {
+            state.setError(std::current_exception());
+            return;
+        }
+        state.setValue();
+    }
+};
+
+template<typename R, typename F, typename Tuple, std::size_t... I>
+void future_apply(future_state<R>& state, F& f, Tuple& args, std::index_sequence<I...>) {
+    future_invoke<R>::run(state, f, std::move(std::get<I>(args))...);
+}
+
+// Result of a continuation f of a future of T, called with the value of the future (nothing for void)
+template<typename F, typename T>
+struct continuation_result { typedef result_of_t<F(const T&)> type; };
+template<typename F>
+struct continuation_result<F, void> { typedef result_of_t<F()> type; };
+
+template<typename T>
+struct future_continuation {
+    template<typename R, typename F>
+    static void run(future_state<T>& previous, future_state<R>& next, F& f) {
+        if (previous.error)
+            next.setError(previous.error);
+        else
+            future_invoke<R>::run(next, f, static_cast<const T&>(previous.value.get()));
+    }
+};
+
+template<>
+struct future_continuation<void> {
+    template<typename R, typename F>
+    static void run(future_state<void>& previous, future_state<R>& next, F& f) {
+        if (previous.error)
+            next.setError(previous.error);
+        else
+            future_invoke<R>::run(next, f);
+    }
+};
+
+template<typename T>
+struct future_reference { typedef const T& type; };
+template<>
+struct future_reference<void> { typedef void type; };
+
+template<typename T>
+class task_future {
+    std::shared_ptr<future_state<T>> _state;
+
+public:
+    task_future() = default;
+    explicit task_future(std::shared_ptr<future_state<T>> state) : _state(std::move(state)) {}
+
+    bool valid() const { return _state != nullptr; }
+    bool is_ready() const { return _state->ready(); }
+    void wait() const { _state->wait(); }
+
+    // Wait for the result, rethrows the exception of the task
+    typename future_reference<T>::type get() const {
+        _state->wait();
+        if (_state->error)
+            std::rethrow_exception(_state->error);
+        return _state->value.get();
+    }
+
+    // Run f(value) on the pool once the value is there, returns the future of its result
+    template<typename F>
+    task_future<typename continuation_result<decay_t<F>, T>::type> then(F&& f) const {
+        typedef typename continuation_result<decay_t<F>, T>::type R;
+        auto previous = _state;
+        auto next = std::make_shared<future_state<R>>(_state->pool);
+        _state->onReady([previous, next, fn = decay_t<F>(std::forward<F>(f))]() mutable {
+            future_continuation<T>::run(*previous, *next, fn);
+        });
+        return task_future<R>(next);
+    }
+
+    // Run f() on the pool once the future is ready, whether it holds a value or an exception
+    void on_ready(task f) const { _state->onReady(std::move(f)); }
+
+    task_system& pool() const { return _state->pool; }
+};
+
+template<typename F, typename... Args>
+task_future<result_of_t<decay_t<F>(decay_t<Args>...)>> task_system::spawn(F&& f, Args&&... args) {
+    typedef result_of_t<decay_t<F>(decay_t<Args>...)> R;
+    auto state = std::make_shared<future_state<R>>(*this);
+    async([state, fn = decay_t<F>(std::forward<F>(f)), bound = std::make_tuple(std::forward<Args>(args)...)]() mutable {
+        future_apply(*state, fn, bound, std::index_sequence_for<Args...>());
+    });
+    return task_future<R>(state);
+}
+
+template<typename T>
+struct when_all_result {
+    typedef std::vector<T> type;
+
+    static void complete(future_state<type>& result, const std::vector<task_future<T>>& futures) {
+        type values;
+        values.reserve(futures.size());
+        try {
+            for (const auto& f : futures)
+                values.push_back(f.get());
+        } catch (...) {
+            result.setError(std::current_exception());
+            return;
+        }
+        result.setValue(std::move(values));
+    }
+};
+
+template<>
+struct when_all_result<void> {
+    typedef void type;
+
+    static void complete(future_state<void>& result, const std::vector<task_future<void>>& futures) {
+        try {
+            for (const auto& f : futures)
+                f.get();
+        } catch (...) {
+            result.setError(std::current_exception());
+            return;
+        }
+        result.setValue();
+    }
+};
+
+// Future of the values of all futures, in order, or of the first exception among them
+template<typename T>
+task_future<typename when_all_result<T>::type> when_all(const std::vector<task_future<T>>& futures) {
+    typedef typename when_all_result<T>::type R;
+    auto result = std::make_shared<future_state<R>>(futures.empty() ? default_task_system() : futures.front().pool());
+    if (futures.empty()) {
+        when_all_result<T>::complete(*result, futures);
+        return task_future<R>(result);
+    }
+    auto inputs = std::make_shared<std::vector<task_future<T>>>(futures);
+    auto remaining = std::make_shared<std::atomic<std::size_t>>(futures.size());
+    for (const auto& f : futures) {
+        f.on_ready([inputs, remaining, result]() {
+            if (--*remaining == 0)
+                when_all_result<T>::complete(*result, *inputs);
+        });
+    }
+    return task_future<R>(result);
+}
+
+// Future of the index of the first of the futures to complete, with a value or an exception
+template<typename T>
+task_future<std::size_t> when_any(const std::vector<task_future<T>>& futures) {
+    auto result = std::make_shared<future_state<std::size_t>>(
+        futures.empty() ? default_task_system() : futures.front().pool());
+    if (futures.empty()) {
+        result->setError(std::make_exception_ptr(std::invalid_argument("when_any of no futures")));
+        return task_future<std::size_t>(result);
+    }
+    auto decided = std::make_shared<std::atomic<bool>>(false);
+    for (std::size_t i=0; i<futures.size(); i++) {
+        futures[i].on_ready([decided, result, i]() {
+            if (!decided->exchange(true))
+                result->setValue(i);
+        });
+    }
+    return task_future<std::size_t>(result);
+}
+
+/* Run f(a) on the shared task system instead of a thread of its own: creating and detaching a std::thread per call
+ * cost far more than the tasks, and detached threads could not be joined at exit.
+ */
 template<typename F, typename A>
-std::future<result_of_t<decay_t<F>(decay_t<A>)>> spawn_task(F&& f, A&& a) {
-    //std::cout << "in spawn_task()" << "\n";
-    using result_t = result_of_t<decay_t<F>(decay_t<A>)>;
-    std::packaged_task<result_t(decay_t<A>)> task(std::forward<F>(f));
-    auto res = task.get_future();
-    std::thread t(std::move(task), std::forward<A>(a));
-    t.detach();
-    return res;
+task_future<result_of_t<decay_t<F>(decay_t<A>)>> spawn_task(F&& f, A&& a) {
+    return default_task_system().spawn(std::forward<F>(f), std::forward<A>(a));
+}
+
+template<class Func, class... Args>
+task_future<result_of_t<decay_t<Func>(decay_t<Args>...)>> async_task(Func&& f, Args&&... args) {
+    return default_task_system().spawn(std::forward<Func>(f), std::forward<Args>(args)...);
 }
 
-template <class Func, class... Args>
-std::future <std::result_of_t<std::decay_t<Func>(std::decay_t <Args>...)>> async_task(Func&& f, Args&&... args) {
-    using return_type = std::result_of_t<std::decay_t<Func>(std::decay_t<Args>...)>;
+/* Bounded queue
+ * A FIFO of at most capacity items that connects the stages of a pipeline. push() blocks while the queue is full, so a
+ * slow consumer holds back its producer (backpressure) instead of letting items pile up without limit; try_push() and
+ * try_pop() never block, for a coordinator that must not stall on one queue. After close() pushes fail and pop() drains
+ * the remaining items, then returns false.
+ */
+template<typename T>
+class bounded_queue {
+    std::deque<T> _q;
+    const std::size_t _capacity;
+    bool _closed{false};
+    std::mutex _mutex;
+    std::condition_variable _notEmpty;
+    std::condition_variable _notFull;
+
+public:
+    explicit bounded_queue(std::size_t capacity) : _capacity(std::max<std::size_t>(1, capacity)) {}
+
+    /* Wait for room and append x, returns false if the queue is closed
+     * The consumer is notified under the lock, so it may destroy the queue as soon as it has popped the last item.
+     */
+    bool push(T x) {
+        std::unique_lock<std::mutex> lock{_mutex};
+        while (_q.size() >= _capacity && !_closed) _notFull.wait(lock);
+        if (_closed)
+            return false;
+        _q.push_back(std::move(x));
+        _notEmpty.notify_one();
+        return true;
+    }
+
+    // Append x if there is room, x is left untouched otherwise
+    bool try_push(T& x) {
+        std::unique_lock<std::mutex> lock{_mutex};
+        if (_q.size() >= _capacity || _closed)
+            return false;
+        _q.push_back(std::move(x));
+        _notEmpty.notify_one();
+        return true;
+    }
+
+    // Wait for an item, returns false once the queue is closed and has been drained
+    bool pop(T& x) {
+        {
+            std::unique_lock<std::mutex> lock{_mutex};
+            while (_q.empty() && !_closed) _notEmpty.wait(lock);
+            if (_q.empty())
+                return false;
+            x = std::move(_q.front());
+            _q.pop_front();
+        }
+        _notFull.notify_one();
+        return true;
+    }
+
+    bool try_pop(T& x) {
+        {
+            std::unique_lock<std::mutex> lock{_mutex};
+            if (_q.empty())
+                return false;
+            x = std::move(_q.front());
+            _q.pop_front();
+        }
+        _notFull.notify_one();
+        return true;
+    }
+
+    void close() {
+        {
+            std::unique_lock<std::mutex> lock{_mutex};
+            _closed = true;
+        }
+        _notEmpty.notify_all();
+        _notFull.notify_all();
+    }
+
+    std::size_t size() {
+        std::unique_lock<std::mutex> lock{_mutex};
+        return _q.size();
+    }
+
+    std::size_t capacity() const { return _capacity; }
+};
+
+/* Countdown latch
+ * wait() blocks until count_down() has been called the number of times given to the constructor. Used to join a
+ * batch of tasks that were handed to the task_system without a future per task.
+ */
+class countdown_latch {
+    std::size_t _count;
+    std::mutex _mutex;
+    std::condition_variable _zero;
+
+public:
+    explicit countdown_latch(std::size_t count) : _count(count) {}
+
+    void count_down();
+    void wait();
+};
+
+/* Run task(index, scratch) for index = 0 .. count-1 on up to one task per worker of pool and on the calling thread, and
+ * return when all of them are done. Every thread that takes an index first makes its own scratch with makeScratch(),
+ * so buffers or engine copies are made once per thread and not per index. Indices are handed out one at a time from a
+ * shared counter: the calling thread takes whatever the workers do not, so the call completes even when every worker
+ * is busy, also when it is made from a worker. If task or makeScratch throws, the indices not yet started are skipped
+ * and the first exception is rethrown once every thread let go of the state.
+ */
+template<typename MakeScratch, typename F>
+void parallel_for(task_system& pool, std::size_t count, MakeScratch makeScratch, F task) {
+    if (count == 0)
+        return;
+
+    // State shared with the tasks, which may start after this call returned when every index was already taken
+    struct shared_state {
+        std::atomic<std::size_t> next{0};
+        std::atomic<bool> failed{false};
+        std::exception_ptr error;       // written once, by the thread that set failed, before its count_down
+        countdown_latch remaining;
+        explicit shared_state(std::size_t count) : remaining(count) {}
+    };
+    auto state = std::make_shared<shared_state>(count);
 
-    // std::packaged_task<> is movable but not copy-able, ...
-    std::packaged_task<return_type(std::decay_t<Func> f, std::decay_t<Args>... args)> task(
-        [](std::decay_t<Func> f, std::decay_t<Args>... args){ return f(args...); }
-    );
+    // Only the shared state is touched until an index was taken, task lives until the last index is done
+    auto work = [state, makeScratch, task, count]() {
+        std::size_t i = state->next++;
+        if (i >= count)
+            return;
+        try {
+            auto scratch = makeScratch();
+            for (; i<count; i=state->next++) {
+                if (!state->failed.load(std::memory_order_relaxed))
+                    task(i, scratch);
+                state->remaining.count_down();
+            }
+        } catch (...) {
+            if (!state->failed.exchange(true))
+                state->error = std::current_exception();
+            // The index that threw and the ones still to take are counted down without running them
+            for (; i<count; i=state->next++)
+                state->remaining.count_down();
+        }
+    };
 
-    // ..., therefore we fetch the std::future<> object from it before moving it to thread.
-    auto task_future = task.get_future();
-    std::thread t(std::move(task), f, std::forward<Args>(args)...);
-    t.detach ();
-    return task_future;
+    const std::size_t helpers = std::min<std::size_t>(pool.size(), count - 1);
+    for (std::size_t i=0; i<helpers; i++)
+        pool.async(work);
+    work();
+    state->remaining.wait();
+    if (state->error)
+        std::rethrow_exception(state->error);
 }
 
 #endif // TASK_H
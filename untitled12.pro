@@ -4,17 +4,53 @@ QT += qml quick
 
 CONFIG += c++14
 
+# 64-bit off_t on 32-bit targets, so that RF64 files over 2 GB can be opened and mapped
+DEFINES += _FILE_OFFSET_BITS=64
+
 SOURCES += main.cpp \
     widget.cpp \
     function.cpp \
-    #task.cpp
+    fft.cpp \
+    kernels.cpp \
+    melfilterbank.cpp \
+    mfcc.cpp \
+    mfccextractor.cpp \
+    wavfile.cpp \
+    featurefile.cpp \
+    featurecache.cpp \
+    hash.cpp \
+    batch.cpp \
+    similarity.cpp \
+    streamingsimilarity.cpp \
+    segmentation.cpp \
+    profiler.cpp \
+    task.cpp
 
 RESOURCES += qml.qrc
 
 HEADERS += \
     widget.h \
     function.h \
-    #task.h
+    fft.h \
+    kernels.h \
+    melfilterbank.h \
+    mfcc.h \
+    mfccextractor.h \
+    wavfile.h \
+    byteorder.h \
+    featurefile.h \
+    featurecache.h \
+    hash.h \
+    batch.h \
+    similaritymatrix.h \
+    featurematrix.h \
+    similarity.h \
+    streamingsimilarity.h \
+    segmentation.h \
+    fixedpoint.h \
+    cowptr.h \
+    polystorage.h \
+    profiler.h \
     task.h
 
 # Default rules for deployment.
@@ -0,0 +1,265 @@
+#include "wavfile.h"
+#include "byteorder.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <iterator>
+#include <utility>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+bool hasId(const uint8_t* p, const char* id) {
+    return std::memcmp(p, id, 4) == 0;
+}
+
+const uint16_t WAVE_FORMAT_EXTENSIBLE = 0xFFFE;
+
+}
+
+mapped_file::mapped_file(mapped_file&& other) noexcept {
+    *this = std::move(other);
+}
+
+mapped_file& mapped_file::operator=(mapped_file&& other) noexcept {
+    if (this != &other) {
+        close();
+        std::swap(ptr, other.ptr);
+        std::swap(length, other.length);
+#ifdef _WIN32
+        std::swap(fileHandle, other.fileHandle);
+        std::swap(mappingHandle, other.mappingHandle);
+#endif
+    }
+    return *this;
+}
+
+#ifdef _WIN32
+
+int mapped_file::open(const char* path) {
+    close();
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        std::cout << "Unable to open input file: " << path << std::endl;
+        return 1;
+    }
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize)) {
+        std::cout << "Unable to read the size of input file: " << path << std::endl;
+        CloseHandle(file);
+        return 1;
+    }
+    if (fileSize.QuadPart == 0) {
+        std::cout << "Unable to map empty input file: " << path << std::endl;
+        CloseHandle(file);
+        return 1;
+    }
+    if (uint64_t(fileSize.QuadPart) > uint64_t(SIZE_MAX)) {
+        std::cout << "Input file too large to map in this address space: " << path << std::endl;
+        CloseHandle(file);
+        return 1;
+    }
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    const void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (!view) {
+        std::cout << "Unable to map input file: " << path << std::endl;
+        if (mapping)
+            CloseHandle(mapping);
+        CloseHandle(file);
+        return 1;
+    }
+    ptr = static_cast<const uint8_t*>(view);
+    length = size_t(fileSize.QuadPart);
+    fileHandle = file;
+    mappingHandle = mapping;
+    return 0;
+}
+
+void mapped_file::close() {
+    if (ptr) {
+        UnmapViewOfFile(ptr);
+        CloseHandle(mappingHandle);
+        CloseHandle(fileHandle);
+    }
+    ptr = nullptr;
+    length = 0;
+    fileHandle = mappingHandle = nullptr;
+}
+
+#else
+
+int mapped_file::open(const char* path) {
+    close();
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) {
+        std::cout << "Unable to open input file: " << path << std::endl;
+        return 1;
+    }
+    // Without large file support (_FILE_OFFSET_BITS=64 on 32-bit systems) fstat fails with EOVERFLOW beyond 2 GB
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        std::cout << "Unable to read the size of input file: " << path << " (" << std::strerror(errno) << ")"
+                  << std::endl;
+        ::close(fd);
+        return 1;
+    }
+    if (st.st_size == 0) {
+        std::cout << "Unable to map empty input file: " << path << std::endl;
+        ::close(fd);
+        return 1;
+    }
+    if (uint64_t(st.st_size) > uint64_t(SIZE_MAX)) {
+        std::cout << "Input file too large to map in this address space: " << path << std::endl;
+        ::close(fd);
+        return 1;
+    }
+    void* view = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd); // the mapping keeps its own reference to the file
+    if (view == MAP_FAILED) {
+        std::cout << "Unable to map input file: " << path << std::endl;
+        return 1;
+    }
+    // The extractor reads the samples front to back, let the kernel read ahead aggressively
+    madvise(view, size_t(st.st_size), MADV_SEQUENTIAL);
+    ptr = static_cast<const uint8_t*>(view);
+    length = size_t(st.st_size);
+    return 0;
+}
+
+void mapped_file::close() {
+    if (ptr)
+        munmap(const_cast<uint8_t*>(ptr), length);
+    ptr = nullptr;
+    length = 0;
+}
+
+#endif
+
+int wav_file::open(const char* path) {
+    stage_probe probe(pipeline_stage::wavRead);
+    buffer.clear();
+    if (map.open(path) != 0)
+        return 1;
+    return parse(map.data(), map.size());
+}
+
+int wav_file::read(std::istream& in) {
+    stage_probe probe(pipeline_stage::wavRead);
+    map.close();
+    buffer.clear();
+
+    // Size the buffer up front when the stream is seekable, otherwise read until end of stream
+    std::streampos start = in.tellg();
+    in.seekg(0, std::ios::end);
+    std::streampos end = in.tellg();
+    if (start != std::streampos(-1) && end != std::streampos(-1) && end >= start) {
+        in.seekg(start);
+        buffer.resize(size_t(end - start));
+        in.read(reinterpret_cast<char*>(buffer.data()), std::streamsize(buffer.size()));
+        buffer.resize(size_t(in.gcount()));
+    } else {
+        in.clear();
+        buffer.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    return parse(buffer.data(), buffer.size());
+}
+
+int wav_file::parse(const uint8_t* image, size_t size) {
+    fmt = wav_format();
+    audio = nullptr;
+    audioSize = 0;
+    rf64 = false;
+
+    // RIFF Chunk Descriptor: "RIFF" (or "RF64"/"BW64"), size, "WAVE"
+    if (size < 12 || !(hasId(image, "RIFF") || hasId(image, "RF64") || hasId(image, "BW64")) || !hasId(image + 8, "WAVE")) {
+        std::cout << "Not a RIFF WAVE file" << std::endl;
+        return 1;
+    }
+    rf64 = !hasId(image, "RIFF");
+
+    // Walk the sub-chunks until both fmt and data have been seen; every chunk is padded to an even size
+    uint64_t ds64DataSize = 0;
+    bool haveFmt = false, haveData = false;
+    size_t pos = 12;
+    while (pos + 8 <= size && !(haveFmt && haveData)) {
+        const uint8_t* chunk = image + pos;
+        const uint8_t* body = chunk + 8;
+        uint64_t chunkSize = readLE32(chunk + 4);
+        size_t available = size - pos - 8;
+
+        if (hasId(chunk, "ds64")) {
+            // 64-bit RIFF size, data size and sample count of an RF64 file
+            if (chunkSize < 24 || available < 24) {
+                std::cout << "Truncated ds64 chunk" << std::endl;
+                return 1;
+            }
+            ds64DataSize = readLE64(body + 8);
+        } else if (hasId(chunk, "fmt ")) {
+            if (chunkSize < 16 || available < 16) {
+                std::cout << "Truncated fmt chunk" << std::endl;
+                return 1;
+            }
+            fmt.formatTag = readLE16(body);
+            fmt.numChannels = readLE16(body + 2);
+            fmt.sampleRate = readLE32(body + 4);
+            fmt.byteRate = readLE32(body + 8);
+            fmt.blockAlign = readLE16(body + 12);
+            fmt.bitsPerSample = readLE16(body + 14);
+            fmt.validBitsPerSample = fmt.bitsPerSample;
+            // WAVE_FORMAT_EXTENSIBLE: cbSize, valid bits, channel mask and a sub-format GUID that starts with the format tag
+            if (fmt.formatTag == WAVE_FORMAT_EXTENSIBLE && chunkSize >= 40 && available >= 40) {
+                fmt.extensible = true;
+                fmt.validBitsPerSample = readLE16(body + 18);
+                fmt.channelMask = readLE32(body + 20);
+                fmt.formatTag = readLE16(body + 24);
+            }
+            haveFmt = true;
+        } else if (hasId(chunk, "data")) {
+            if (rf64 && chunkSize == 0xFFFFFFFF)
+                chunkSize = ds64DataSize;
+            audio = body;
+            audioSize = std::min<uint64_t>(chunkSize, available);
+            haveData = true;
+        }
+
+        if (chunkSize + (chunkSize & 1) >= available)
+            break;
+        pos += 8 + size_t(chunkSize + (chunkSize & 1));
+    }
+
+    if (!haveFmt) {
+        std::cout << "Missing fmt chunk" << std::endl;
+        return 1;
+    }
+    if (!haveData) {
+        std::cout << "Missing data chunk" << std::endl;
+        return 1;
+    }
+    if (fmt.blockAlign == 0 || fmt.numChannels == 0) {
+        std::cout << "Invalid fmt chunk" << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+sample_span<int16_t> wav_file::samples() const {
+    sample_span<int16_t> span;
+    // Chunks start at even offsets, so the data of a well-formed file is always 16-bit aligned
+    if (!isPcm16() || reinterpret_cast<uintptr_t>(audio) % alignof(int16_t) != 0)
+        return span;
+    span.data = reinterpret_cast<const int16_t*>(audio);
+    span.size = size_t(audioSize / sizeof(int16_t));
+    return span;
+}
@@ -0,0 +1,114 @@
+#ifndef WAVFILE_H
+#define WAVFILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <vector>
+
+// Read-only memory mapping of a whole file
+class mapped_file {
+
+public:
+    mapped_file() = default;
+    ~mapped_file() { close(); }
+
+    mapped_file(const mapped_file&) = delete;
+    mapped_file& operator=(const mapped_file&) = delete;
+    mapped_file(mapped_file&& other) noexcept;
+    mapped_file& operator=(mapped_file&& other) noexcept;
+
+    // Map the file at path, returns 0 on success
+    int open(const char* path);
+    void close();
+
+    bool is_open() const { return ptr != nullptr; }
+    const uint8_t* data() const { return ptr; }
+    size_t size() const { return length; }
+
+private:
+    const uint8_t* ptr = nullptr;
+    size_t length = 0;
+#ifdef _WIN32
+    void* fileHandle = nullptr;
+    void* mappingHandle = nullptr;
+#endif
+};
+
+// Contiguous, non-owning view of n values
+template<typename T>
+struct sample_span {
+    const T* data = nullptr;
+    size_t size = 0;
+
+    const T* begin() const { return data; }
+    const T* end() const { return data + size; }
+    const T& operator[](size_t i) const { return data[i]; }
+    bool empty() const { return size == 0; }
+};
+
+// Contents of the fmt chunk, with the format tag of WAVE_FORMAT_EXTENSIBLE files resolved from their sub-format
+struct wav_format {
+    uint16_t formatTag = 0;             // 1=PCM, 3=IEEE float, 6=A-law, 7=mu-law
+    uint16_t numChannels = 0;           // Number of channels 1=Mono 2=Stereo
+    uint32_t sampleRate = 0;            // Sampling Frequency in Hz
+    uint32_t byteRate = 0;              // bytes per second
+    uint16_t blockAlign = 0;            // bytes per sample frame, 2=16-bit mono, 4=16-bit stereo
+    uint16_t bitsPerSample = 0;         // Number of bits per sample (container size)
+    uint16_t validBitsPerSample = 0;    // Number of significant bits, from WAVE_FORMAT_EXTENSIBLE (else bitsPerSample)
+    uint32_t channelMask = 0;           // Speaker positions, from WAVE_FORMAT_EXTENSIBLE
+    bool extensible = false;
+};
+
+/* WAV file reader
+ * Walks the RIFF chunks of a WAVE file instead of assuming a fixed 44-byte header, so LIST, fact, bext, JUNK and any
+ * other chunks before or after the audio are skipped. The fmt chunk may be plain PCM, IEEE float or
+ * WAVE_FORMAT_EXTENSIBLE; RF64 and BW64 files, which keep 64-bit RIFF and data sizes in a ds64 chunk, open like any
+ * other file. A data size that runs past the end of the file (a recording that was cut off) is clamped to the bytes
+ * that are there.
+ *
+ * open() maps the file into memory and samples() points straight into the mapping, so the audio is neither read nor
+ * copied before the extractor touches it. read() takes the whole stream into a buffer for sources that cannot be
+ * mapped. Fields are decoded as little endian; the zero-copy sample view assumes a little-endian host.
+ */
+class wav_file {
+
+public:
+    wav_file() = default;
+
+    // Map and parse the file at path, returns 0 on success
+    int open(const char* path);
+
+    // Read and parse a whole stream, returns 0 on success
+    int read(std::istream& in);
+
+    // Parse a WAV image that stays owned by the caller, returns 0 on success
+    int parse(const uint8_t* image, size_t size);
+
+    const wav_format& format() const { return fmt; }
+
+    // True for 16-bit integer PCM, the format samples() can view
+    bool isPcm16() const { return fmt.formatTag == 1 && fmt.bitsPerSample == 16; }
+
+    bool isRF64() const { return rf64; }
+
+    // Raw bytes of the data chunk
+    const uint8_t* data() const { return audio; }
+    uint64_t dataSize() const { return audioSize; }
+
+    // Number of sample frames (one sample per channel)
+    uint64_t numFrames() const { return fmt.blockAlign ? audioSize / fmt.blockAlign : 0; }
+
+    // Interleaved 16-bit samples of the data chunk, empty unless isPcm16()
+    sample_span<int16_t> samples() const;
+
+private:
+    mapped_file map;
+    std::vector<uint8_t> buffer;
+    wav_format fmt;
+    const uint8_t* audio = nullptr;
+    uint64_t audioSize = 0;
+    bool rf64 = false;
+};
+
+#endif // WAVFILE_H
@@ -1,10 +1,19 @@
 #include "widget.h"
-
-#include <chrono>
+#include "cowptr.h"
+#include "kernels.h"
+#include "featurecache.h"
+#include "featurefile.h"
+#include "mfccextractor.h"
+#include "profiler.h"
+#include "segmentation.h"
+#include "similarity.h"
+#include "streamingsimilarity.h"
+#include "wavfile.h"
+
+#include <algorithm>
 #include <complex>
 #include <fstream>
 #include <iostream>
-#include <map>
 #include <memory>
 #include <vector>
 #include <math.h>
@@ -16,6 +25,20 @@
  * determines the resolution of the resultant self-similarity matrix.
  */
 
+namespace {
+
+// Print row i of a self-similarity matrix up to column count, full or banded (cells outside the band read as distance 1)
+template<typename M>
+void printSimilarity(const M& ssm, size_t i, size_t count) {
+    std::cout << "frames: " << ssm.size() << std::endl;
+    for (size_t j=i+1; j<=count && j<ssm.size(); ++j) {
+        std::cout << ssm.at(i, j) << " ";
+    }
+    std::cout << std::endl;
+}
+
+}
+
 class widget::impl {
 
 public:
@@ -23,196 +46,198 @@ public:
     typedef std::complex<double> c_d;
     typedef std::vector<v_d> v_v_d;
     typedef std::vector<c_d> v_c_d;
-    typedef std::map<int, std::map<int, c_d>> twmap;
 
-    std::vector<double> vecdsimilarity;
+    // Results are shared by copies of the widget until one of them recomputes them
+    cow_ptr<similarity_matrix<double>> ssm;
+    cow_ptr<banded_similarity_matrix<double>> bandedSsm;
+    cow_ptr<std::vector<size_t>> boundaries;
+    int status = 0;                 // result of the last analysis
 
-    void initTo(void) {
-        winWidthSamples = winWidth * fs / 1000;
-        frameShiftSamples = frameShift * fs / 1000;
-        numFFTBins = numFFT / 2 + 1;
-        powerSpectralCoef.assign(numFFTBins, 0);
-        prevSamples.assign(winWidthSamples - frameShiftSamples, 0);
-
-        initFilterbank();
-        initHammingDct();
-        compTwiddle();
+    const cow_ptr<feature_matrix<double>>& features() const { return mfccs; }
+
+    // Limit the self-similarity matrix to frames at most seconds apart, 0 for the full matrix (after initTo)
+    void setMaxLag(double seconds) {
+        maxLag = seconds > 0 ? size_t(seconds * config.fs / extractor.frameShiftLength()) : 0;
+        if (maxLag > 0)
+            maxLag = std::max(maxLag, segmenter.minimumLag());
     }
+    bool isBanded() const { return maxLag > 0; }
 
-    // Calculate cosine similarity between two vectors
-    double cosine_similarity(std::vector<double> veca, std::vector<double> vecb) {
-        double multiply = 0.0;
-        double d_a = 0.0;
-        double d_b = 0.0;
+    void initTo(void) {
+        extractor.init(config);
+        live.init(extractor.numCoefficients());
+        winWidthSamples = extractor.frameLength();
+        frameShiftSamples = extractor.frameShiftLength();
+        mfcc.assign(extractor.numCoefficients(), 0);
+    }
 
-        std::vector<double>::iterator itera, iterb;
+    // Push samples to the extractor and collect the MFCCs of the completed frames
+    void processFrameTo(const int16_t* samples, size_t N) {
+        feature_matrix<double>& features = mfccs.write();
+        extractor.push(samples, N, [&features](size_t, const double* coef) {
+            features.appendRow(coef);
+        });
+    }
 
-        for (itera = veca.begin(), iterb = vecb.begin(); itera != veca.end(); itera++, iterb++) {
-            multiply += *itera * *iterb;
-            d_a += *itera * *itera;
-            d_b += *iterb * *iterb;
+    // Calculate self-similarity measures between all pairs of frames, or the pairs within the maximum lag
+    void compSimilarity(void) {
+        if (isBanded()) {
+            ssm.reset();
+            similarity.compute(*mfccs, maxLag, bandedSsm.reset(), default_task_system());
+        } else {
+            bandedSsm.reset();
+            similarity.compute(*mfccs, ssm.reset(), default_task_system());
         }
+    }
 
-        return multiply / (sqrt(d_a) * sqrt(d_b));
+    int loadSimilarity(uint64_t key) {
+        if (isBanded()) {
+            ssm.reset();
+            return cache.load(key, bandedSsm.reset());
+        }
+        bandedSsm.reset();
+        return cache.load(key, ssm.reset());
     }
 
-    // Process each frame and return MFCCs as vector of double
-    std::vector<double> processFrameTo(int16_t* samples, size_t N) {
-        // Add samples from the previous frame that overlap with the current frame to the current samples and create the frame.
-        frame = prevSamples;
-        for (size_t i=0; i<N; i++)
-            frame.push_back(samples[i]);
-        prevSamples.assign(frame.begin()+frameShiftSamples, frame.end());
+    int storeSimilarity(uint64_t key) {
+        return isBanded() ? cache.store(key, *bandedSsm) : cache.store(key, *ssm);
+    }
 
-        preEmphHamming();
-        compPowerSpec();
-        applyLogMelFilterbank();
-        applyDct();
+    // Find segment boundaries at the peaks of the Foote novelty of the self-similarity matrix
+    void compSegmentation(void) {
+        if (isBanded())
+            segmenter.segment(*bandedSsm, boundaries.reset());
+        else
+            segmenter.segment(*ssm, boundaries.reset());
+    }
 
-        return mfcc;
+    void printSegments(void) const {
+        const double hop = double(frameShiftSamples) / config.fs;
+        std::cout << "segment boundaries (s):";
+        for (size_t frame : *boundaries)
+            std::cout << " " << frame * hop;
+        std::cout << std::endl;
     }
 
     // Read samples, extract MFCCs and calculate self-similarity measures
     int processSamplesTo(std::vector<double> levels) {
         uint16_t bufferLength = winWidthSamples - frameShiftSamples;
-        uint16_t position = bufferLength;
+        size_t position = 0;
 
-        // Read and set the initial samples
-        for (int i=0; i<bufferLength; i++)
-            prevSamples[i] = levels[i];
+        // Allocate memory for the coefficients of all frames
+        feature_matrix<double>& features = mfccs.reset();
+        features.reset(extractor.numCoefficients());
+        features.reserve(extractor.pendingFrames(levels.size()));
+        extractor.reset();
 
         // Initialise buffer (allocate a block of memory of type double, dynamically allocated memory is allocated on Heap^)
-        bufferLength = frameShiftSamples;
         int16_t * buffer = new int16_t[bufferLength];
 
-        // Allocate memory for 790 coefficients, read data and process each frame
-        vecdmfcc.reserve(790);
-        vecdmfcc.clear();
-
-        for (int i=0; i<bufferLength; i++)
-            buffer[i] = levels[position + i];
-        position += bufferLength;
-
-        while (position < levels.size() && vecdmfcc.size() < 790) {
-            vecdmfcc.push_back(processFrameTo(buffer, bufferLength));
+        // Convert the levels to samples block by block and stream them through the extractor
+        while (position + bufferLength <= levels.size()) {
             for (int i=0; i<bufferLength; i++)
                 buffer[i] = levels[position + i];
+            processFrameTo(buffer, bufferLength);
             position += bufferLength;
         }
 
-        // Allocate memory for self-similarity measures
-        vecdsimilarity.reserve(365 * 790);
-        vecdsimilarity.clear();
-        std::vector<double> veca, vecb;
-        double measure;
-        for (size_t j=0; j<365; j++) {
-            veca = vecdmfcc[j];
-            for (size_t i=j; i<790; i++) {
-                vecb = vecdmfcc[i];
-                // ...measure = 1 - cosine_similarity(veca, vecb);
-                // Lambda expression (capture all variables by reference)
-                measure = 1 - [&veca, &vecb](){
-                    double multiply = 0.0;
-                    double d_a = 0.0;
-                    double d_b = 0.0;
-
-                    std::vector<double>::iterator itera, iterb;
-
-                    for (itera = veca.begin(), iterb = vecb.begin(); itera != veca.end(); itera++, iterb++) {
-                        multiply += *itera * *iterb;
-                        d_a += *itera * *itera;
-                        d_b += *iterb * *iterb;
-                    }
-
-                    return multiply / (sqrt(d_a) * sqrt(d_b));
-                }();
-                vecdsimilarity.push_back(measure);
-            }
-        }
+        compSimilarity();
+        compSegmentation();
 
         delete [] buffer; // delete a block of memory
         buffer = nullptr;
         return 0;
     }
 
-    // Read input file stream, extract MFCCs and calculate self-similarity measures
-    int processTo(std::ifstream &wavFp) {
-        // Read the wav header
-        wavHeader hdr;
-        int headerSize = sizeof(wavHeader);
-        wavFp.read((char *)&hdr, headerSize); // cast the address of hdr, denoted &hdr, to a char *, i.e. a pointer to characters
-
+    // Extract MFCCs from the samples of a wav file and calculate self-similarity measures
+    int processTo(const wav_file& wav) {
         // Check audio format
-        if (hdr.AudioFormat != 1 || hdr.bitsPerSample != 16) {
-            std::cout << "Unsupported audio format, use 16 bit PCM Wave" << std::endl;
+        const wav_format& fmt = wav.format();
+        if (!wav.isPcm16() || fmt.numChannels != 1) {
+            std::cout << "Unsupported audio format, use 16 bit mono PCM Wave" << std::endl;
             return 1;
         }
         // Check sampling rate
-        if (hdr.SamplesPerSec != fs) {
-            std::cout << "Sampling rate mismatch: found " << hdr.SamplesPerSec << " instead of " << fs << std::endl;
+        if (fmt.sampleRate != config.fs) {
+            std::cout << "Sampling rate mismatch: found " << fmt.sampleRate << " instead of " << config.fs << std::endl;
             return 1;
         }
 
-        // Initialise buffer (allocate a block of memory of type double, dynamically allocated memory is allocated on Heap^)
-        uint16_t bufferLength = winWidthSamples - frameShiftSamples;
-        int16_t * buffer = new int16_t[bufferLength];
-        std::cout << "is_pointer: " << std::is_pointer<decltype(buffer)>::value << std::endl;
-        // Calculate bytes per sample (size of the first element in bytes)
-        int bufferbps = (sizeof buffer[0]);
-        std::cout << "bufferLength: " << bufferLength << std::endl;
-
-        // Read and set the initial samples
-        wavFp.read((char *)buffer, bufferLength * bufferbps);   // cast the pointer of the double variable to a pointer to characters
-        for (int i=0; i<bufferLength; i++) {
-            prevSamples[i] = buffer[i];                         // prevSamples[i] is an ith element of std::vector<double>
+        // Stream the samples straight out of the file image
+        sample_span<int16_t> samples = wav.samples();
+        std::cout << "samples: " << samples.size << std::endl;
+
+        // Skip the analysis of audio that was analysed with the same configuration before
+        const uint64_t key = feature_cache::key(wav.data(), size_t(wav.dataSize()), config);
+        feature_matrix<double>& features = mfccs.reset();
+        if (cache.load(key, features) == 0) {
+            std::cout << "MFCCs from cache" << std::endl;
+        } else {
+            // Every frame of the file is there, compute them on all cores
+            extractor.extract(samples.data, samples.size, features, default_task_system());
+            cache.store(key, features);
         }
-        delete [] buffer;
-
-        // Recalculate buffer size
-        bufferLength = frameShiftSamples;
-        buffer = new int16_t[bufferLength];
-
-        // Allocate memory for 790 coefficients, read data and process each frame
-        vecdmfcc.reserve(790);
-        vecdmfcc.clear();
-        wavFp.read((char *)buffer, bufferLength * bufferbps);
-        while (wavFp.gcount() == bufferLength * bufferbps && !wavFp.eof() && vecdmfcc.size() < 790) {
-            vecdmfcc.push_back(processFrameTo(buffer, bufferLength));
-            wavFp.read((char *)buffer, bufferLength * bufferbps);
+
+        const uint64_t ssmKey = feature_cache::similarityKey(key, maxLag);
+        if (loadSimilarity(ssmKey) == 0) {
+            std::cout << "Self-similarity from cache" << std::endl;
+        } else {
+            compSimilarity();
+            storeSimilarity(ssmKey);
         }
+        compSegmentation();
+
+        return 0;
+    }
+
+    // Write the MFCCs of all frames to a binary feature file
+    int writeFeaturesTo(const char* path) {
+        const feature_matrix<double>& features = *mfccs;
+        feature_file_writer writer;
+        if (writer.open(path, config, features.cols()) != 0)
+            return 1;
+        for (size_t i=0; i<features.rows(); i++)
+            writer.append(features.row(i));
+        return writer.close();
+    }
 
-        // Allocate memory for self-similarity measures
-        vecdsimilarity.reserve(365 * 790);
-        vecdsimilarity.clear();
-        std::vector<double> veca, vecb;
-        double measure;
-        for (size_t j=0; j<365; j++) {
-            veca = vecdmfcc[j];
-            for (size_t i=j; i<790; i++) {
-                vecb = vecdmfcc[i];
-                // ...measure = 1 - cosine_similarity(veca, vecb);
-                // Lambda expression (capture all variables by reference)
-                measure = 1 - [&veca, &vecb](){
-                    double multiply = 0.0;
-                    double d_a = 0.0;
-                    double d_b = 0.0;
-
-                    std::vector<double>::iterator itera, iterb;
-
-                    for (itera = veca.begin(), iterb = vecb.begin(); itera != veca.end(); itera++, iterb++) {
-                        multiply += *itera * *iterb;
-                        d_a += *itera * *itera;
-                        d_b += *iterb * *iterb;
-                    }
-
-                    return multiply / (sqrt(d_a) * sqrt(d_b));
-                }();
-                vecdsimilarity.push_back(measure);
-            }
+    // Write the MFCCs of all frames to an HTK parameter file
+    int writeHtkTo(const char* path) {
+        const feature_matrix<double>& features = *mfccs;
+        htk_writer writer;
+        if (writer.open(path, config, features.cols()) != 0)
+            return 1;
+        for (size_t i=0; i<features.rows(); i++)
+            writer.append(features.row(i));
+        return writer.close();
+    }
+
+    // Feed the samples of a wav file block by block as a live input would, and report segment boundaries as they are found
+    int monitorTo(const wav_file& wav, double blockSeconds) {
+        // Interleaved channels would be taken for samples at a multiple of the rate
+        const wav_format& fmt = wav.format();
+        sample_span<int16_t> samples = wav.samples();
+        if (!wav.isPcm16() || fmt.numChannels != 1 || samples.size == 0 || fmt.sampleRate != config.fs) {
+            std::cout << "Unsupported audio format, use 16 bit mono PCM Wave" << std::endl;
+            return 1;
         }
 
-        delete [] buffer;
-        buffer = nullptr;
+        const size_t blockLength = std::max<size_t>(1, size_t(blockSeconds * config.fs));
+        const double hop = double(frameShiftSamples) / config.fs;
+        auto report = [hop](uint64_t frame, double novelty, bool boundary) {
+            if (boundary)
+                std::cout << "boundary at " << frame * hop << " s, novelty " << novelty << std::endl;
+        };
+        extractor.reset();
+        live.reset();
+        for (size_t position=0; position<samples.size; position+=blockLength) {
+            size_t n = std::min(blockLength, samples.size - position);
+            extractor.push(samples.data + position, n, [this, &report](size_t, const double* coef) {
+                live.push(coef, report);
+            });
+        }
+        live.finish(report);
+        std::cout << "boundary latency: " << live.latency() * hop << " s" << std::endl;
         return 0;
     }
 
@@ -226,21 +251,16 @@ public:
     }
 
 private:
-    const double PI = 4*atan(1.0);
-    size_t winWidthSamples, frameShiftSamples, numFFTBins;
-    std::vector<double> frame, prevSamples, powerSpectralCoef, lmfbCoef, hamming, mfcc;
-    std::vector<std::vector<double>> vecdmfcc, fbank, dct;
-    std::map<int, std::map<int, std::complex<double>>> twiddle;
-
-    size_t fs = 44100;                 // Sampling rate in Hertz (default=16000)
-    size_t numCepstral = 12;           // Number of output cepstra, excluding log-energy (default=12)
-    size_t numFilters = 40;            // Number of Mel warped filters in filterbank (default=40)
-    double preEmphCoef = 0.97;         // Pre-emphasis coefficient
-    double lowFreq = 50;               // Filterbank low frequency cutoff in Hertz (default=50)
-    double highFreq = 4000;            // Filterbank high freqency cutoff in Hertz (default=fs/2)
-    size_t numFFT = 512;               // N-point FFT on each frame
-    size_t winWidth = 25;              // Width of analysis window in milliseconds (default=25)
-    size_t frameShift = 10;            // Frame shift in milliseconds (default=10)
+    size_t winWidthSamples, frameShiftSamples;
+    size_t maxLag = 0;
+    std::vector<double> mfcc;
+    cow_ptr<feature_matrix<double>> mfccs;
+    mfcc_config config;
+    mfcc_extractor<double> extractor;
+    similarity_engine<double> similarity;
+    foote_segmenter<double> segmenter;
+    feature_cache cache;
+    streaming_similarity<double> live;
 
     // Convert vector of double to string
     std::string v_d_to_string(v_d vec) {
@@ -255,207 +275,73 @@ private:
         return vecStream.str();
     }
 
-    // Process each frame and extract MFCCs as string
-    std::string processFrame(int16_t* samples, size_t N) {
-        // Add samples from the previous frame that overlap with the current frame to the current samples and create the frame.
-        frame = prevSamples;
-        for (size_t i=0; i<N; i++)
-            frame.push_back(samples[i]);
-        prevSamples.assign(frame.begin() + frameShiftSamples, frame.end());
-
-        preEmphHamming();
-        compPowerSpec();
-        applyLogMelFilterbank();
-        applyDct();
-
+    // Process each frame and extract MFCCs of the last completed frame as string
+    std::string processFrame(const int16_t* samples, size_t N) {
+        extractor.push(samples, N, [this](size_t, const double* coef) {
+            mfcc.assign(coef, coef + extractor.numCoefficients());
+        });
         return v_d_to_string(mfcc);
     }
 
-    // Hertz to Mel conversion
-    inline double Hz2Mel(double f) {
-        return 2595*std::log10(1 + f/700);
-    }
+    int internal_data = 0;
+};
 
-    // Mel to Hertz conversion
-    inline double Mel2Hz(double m) {
-        return 700*(std::pow(10, m/2595) - 1);
-    }
+int widget::processTo(std::ifstream &wavFp) {
 
-    // Cooley-Tukey FFT recursive function
-    std::vector<std::complex<double>> fft(std::vector<std::complex<double>> x) {
-        size_t N = x.size();
-        if (N==1)
-            return x;
-
-        std::vector<std::complex<double>> xe(N/2,0), xo(N/2,0), Xjo, Xjo2;
-
-        // Construct arrays from even and odd indices
-        for (size_t i=0; i<N; i+=2)
-            xe[i/2] = x[i];
-        for (size_t i=1; i<N; i+=2)
-            xo[(i-1)/2] = x[i];
-
-        // Compute N/2-point FFT
-        Xjo = fft(xe);
-        Xjo2 = fft(xo);
-        Xjo.insert (Xjo.end(), Xjo2.begin(), Xjo2.end());
-
-        // Butterfly computations
-        for (size_t i=0; i<=N/2-1; i++) {
-            c_d t = Xjo[i], tw = twiddle[N][i];
-            Xjo[i] = t + tw * Xjo[i+N/2];
-            Xjo[i+N/2] = t - tw * Xjo[i+N/2];
-        }
-        return Xjo;
-    }
+    // Streams cannot be mapped, read the whole file and parse it from memory
+    wav_file wav;
+    pimpl->status = wav.read(wavFp) != 0 ? 1 : pimpl->processTo(wav);
+    return pimpl->status;
+}
 
-    /* Pre-emphasis and Hamming window
-     * The first step is to apply a pre-emphasis filter on the signal to amplify the high frequencies.
-     * A pre-emphasis filter is useful in several ways: (1) balance the frequency spectrum since high frequencies
-     * usually have smaller magnitudes compared to lower frequencies, (2) avoid numerical problems during the
-     * Fourier transform operation and (3) may also improve the Signal-to-Noise Ratio (SNR).
-     * The pre-emphasis filter can be applied to a signal x using the first order filter in the following equation: y(t)=x(t)−αx(t−1).
-     */
-    void preEmphHamming(void) {
-        v_d procFrame(frame.size(), hamming[0]*frame[0]);
-        for (size_t i=1; i<frame.size(); i++)
-            procFrame[i] = hamming[i] * (frame[i] - preEmphCoef * frame[i-1]);
-        frame = procFrame;
-    }
+void widget::setMaxLag(double seconds) {
 
-    /* Power spectrum computation
-     * After pre-emphasis, we need to split the signal into short-time frames. We can safely assume that frequencies in a signal
-     * are stationary over a very short period of time. Therefore, by doing a Fourier transform over this short-time frame,
-     * we can obtain a good approximation of the frequency contours of the signal by concatenating adjacent frames.
-     *
-     * We can now do an N-point FFT on each frame to calculate the frequency spectrum, which is also called Short-Time
-     * Fourier-Transform, where N is typically 256 or 512, numFFT = 512 in this case; and then compute the power spectrum (periodogram)
-     * using the following equation: P=|FFT(xi)|^2 where, xi is the ith frame of signal x.
-     */
-    void compPowerSpec(void) {
-        frame.resize(numFFT); // Pads zeros
-        v_c_d framec (frame.begin(), frame.end()); // Complex frame
-        v_c_d fftc = fft(framec);
-
-        for (size_t i=0; i<numFFTBins; i++)
-            powerSpectralCoef[i] = pow(abs(fftc[i]),2);
-    }
+    pimpl->setMaxLag(seconds);
+}
 
-    /* Applying log Mel filterbank
-     * The final step to computing filter banks is applying triangular filters, typically 40 filters, numFilters = 40 on a Mel-scale
-     * to the power spectrum to extract frequency bands. The Mel-scale aims to mimic the non-linear human ear perception of sound,
-     * by being more discriminative at lower frequencies and less discriminative at higher frequencies.
-     */
-    void applyLogMelFilterbank(void) {
-        lmfbCoef.assign(numFilters,0);
-
-        for (size_t i=0; i<numFilters; i++) {
-            // Multiply the filterbank matrix
-            for (size_t j=0; j<fbank[i].size(); j++)
-                lmfbCoef[i] += fbank[i][j] * powerSpectralCoef[j];
-            // Apply Mel-flooring
-            if (lmfbCoef[i] < 1.0)
-                lmfbCoef[i] = 1.0;
-        }
+int widget::analysisStatus() const {
 
-        // Applying log on amplitude
-        for (size_t i=0; i<numFilters; i++)
-            lmfbCoef[i] = std::log(lmfbCoef[i]);
-    }
+    return pimpl->status;
+}
 
-    /* Computing discrete cosine transform
-     * It turns out that filter bank coefficients computed in the previous step are highly correlated, which could be
-     * problematic in some machine learning algorithms. Therefore, we can apply Discrete Cosine Transform (DCT)
-     * to decorrelate the filter bank coefficients and yield a compressed representation of the filter banks. Typically,
-     * for Automatic Speech Recognition (ASR), the resulting cepstral coefficients 2-13 are retained and the rest are discarded.
-     */
-    void applyDct(void) {
-        mfcc.assign(numCepstral+1,0);
-        for (size_t i=0; i<=numCepstral; i++) {
-            for (size_t j=0; j<numFilters; j++)
-                mfcc[i] += dct[i][j] * lmfbCoef[j];
-        }
-    }
+int widget::monitorTo(const char* wavPath, double blockSeconds) {
 
-    // Precompute filterbank
-    void initFilterbank(void) {
-        // Convert low and high frequencies to Mel scale
-        double lowFreqMel = Hz2Mel(lowFreq);
-        double highFreqMel = Hz2Mel(highFreq);
-
-        // Calculate filter centre-frequencies
-        v_d filterCentreFreq;
-        filterCentreFreq.reserve(numFilters+2);
-        for (size_t i=0; i<numFilters+2; i++)
-            filterCentreFreq.push_back(Mel2Hz(lowFreqMel + (highFreqMel-lowFreqMel)/(numFilters+1)*i));
-
-        // Calculate FFT bin frequencies
-        v_d fftBinFreq;
-        fftBinFreq.reserve(numFFTBins);
-        for (size_t i=0; i<numFFTBins; i++)
-            fftBinFreq.push_back(fs/2.0/(numFFTBins-1)*i);
-
-        // Allocate memory for the filterbank
-        fbank.reserve(numFilters*numFFTBins);
-
-        // Populate the filterbank matrix
-        for (size_t filt=1; filt<=numFilters; filt++) {
-            v_d ftemp;
-            for (size_t bin=0; bin<numFFTBins; bin++) {
-                double weight;
-                if (fftBinFreq[bin] < filterCentreFreq[filt-1])
-                    weight = 0;
-                else if (fftBinFreq[bin] <= filterCentreFreq[filt])
-                    weight = (fftBinFreq[bin] - filterCentreFreq[filt-1]) / (filterCentreFreq[filt] - filterCentreFreq[filt-1]);
-                else if (fftBinFreq[bin] <= filterCentreFreq[filt+1])
-                    weight = (filterCentreFreq[filt+1] - fftBinFreq[bin]) / (filterCentreFreq[filt+1] - filterCentreFreq[filt]);
-                else
-                    weight = 0;
-                ftemp.push_back(weight);
-            }
-            fbank.push_back(ftemp);
-        }
+    wav_file wav;
+    if (wav.open(wavPath) != 0) {
+        std::cout << "Unable to open input file: " << wavPath << std::endl;
+        return 1;
     }
+    return pimpl->monitorTo(wav, blockSeconds);
+}
 
-    // Precompute Hamming window and dct matrix
-    void initHammingDct(void) {
-        size_t i, j;
-
-        // After slicing the signal into frames, we apply a window function such as the Hamming window to each frame.
-        hamming.assign(winWidthSamples, 0);
-        for (i=0; i<winWidthSamples; i++)
-            hamming[i] = 0.54 - 0.46 * cos(2 * PI * i / (winWidthSamples-1));
-
-        v_d v1(numCepstral+1,0), v2(numFilters,0);
-        for (i=0; i <= numCepstral; i++)
-            v1[i] = i;
-        for (i=0; i < numFilters; i++)
-            v2[i] = i + 0.5;
-
-        dct.reserve(numFilters*(numCepstral+1));
-        double c = sqrt(2.0/numFilters);
-        for (i=0; i<=numCepstral; i++) {
-            v_d dtemp;
-            for (j=0; j<numFilters; j++)
-                dtemp.push_back(c * cos(PI / numFilters * v1[i] * v2[j]));
-            dct.push_back(dtemp);
-        }
-    }
+int widget::writeFeaturesTo(const char* path) {
 
-    // Twiddle factor computation
-    void compTwiddle(void) {
-        const std::complex<double> J(0,1);
-        for (size_t n=2; n<=numFFT; n*=2)
-            for (size_t k=0; k<=n/2-1; k++)
-                twiddle[n][k] = exp(-2*PI*k/n*J);
-    }
+    return pimpl->writeFeaturesTo(path);
+}
 
-    int internal_data = 0;
-};
+int widget::writeHtkTo(const char* path) {
 
-int widget::processTo(std::ifstream &wavFp) {
+    return pimpl->writeHtkTo(path);
+}
+
+std::shared_ptr<const feature_matrix<double>> widget::features() const {
+
+    return pimpl->features().share();
+}
+
+std::shared_ptr<const similarity_matrix<double>> widget::similarity() const {
+
+    return pimpl->ssm.share();
+}
 
-    return pimpl->processTo(wavFp);
+std::shared_ptr<const banded_similarity_matrix<double>> widget::bandedSimilarity() const {
+
+    return pimpl->bandedSsm.share();
+}
+
+std::shared_ptr<const std::vector<size_t>> widget::segmentBoundaries() const {
+
+    return pimpl->boundaries.share();
 }
 
 void widget::do_internal_work() {
@@ -467,37 +353,35 @@ widget::widget() : pimpl(std::make_unique<impl>()) {
 
     std::cout << "is_copy_constructible<impl>: " << std::is_copy_constructible<impl>::value << '\n';
     std::cout << "is_move_constructible<impl>: " << std::is_move_constructible<impl>::value << '\n';
+    std::cout << "DSP kernels: " << kernels().name << '\n';
 
     const char* wavPath = "partita.wav";
-    std::ifstream wavFp;
-    // Check if input is readable
-    wavFp.open(wavPath);
-    if (!wavFp.is_open()) {
+    wav_file wav;
+    pimpl->initTo();
+    // Check if input is readable (the file is memory-mapped, not read)
+    if (wav.open(wavPath) != 0) {
         std::cout << "Unable to open input file: " << wavPath << std::endl;
+        pimpl->status = 1;
+        return;
     }
 
-    auto start = std::chrono::system_clock::now();
-    pimpl->initTo();
-    pimpl->processTo(wavFp);
-    std::chrono::duration<double> duration = std::chrono::system_clock::now() - start;
-    std::cout << "Time native: " << duration.count() << " seconds" << std::endl;
-    // Time native: 1.92913 seconds
-    // Time native: 1.92514 seconds
-    // Time native: 1.89696 seconds
-    // Time native: 1.91688 seconds
-    // Time native: 1.90403 seconds
-    // ...
-
-    wavFp.close();
-
-    for (int i=1; i<=365; ++i) {
-        std::cout << pimpl->vecdsimilarity[i] << " ";
-    }
-    std::cout << std::endl;
+    pimpl->status = pimpl->processTo(wav);
+    if (pimpl->status != 0)
+        return;
+
+    if (pimpl->isBanded())
+        printSimilarity(*pimpl->bandedSsm, 0, 365);
+    else
+        printSimilarity(*pimpl->ssm, 0, 365);
+    pimpl->printSegments();
+
+    // Where the time of the analysis went, per stage and frame
+    printStageReport(std::cout);
 }
 
 /* The copy operations should either be explicitly deleted or implemented by performing a deep copy of the
- * impl structure.
+ * impl structure. The deep copy is cheap here: results and tables are copy-on-write, so the copy shares them with the
+ * original until either recomputes them, and only the small per-frame buffers are duplicated.
  */
 
 // widget::widget(const widget& other) : pimpl(new impl(*other.pimpl)) { // Scott Meyers' C++11 approach
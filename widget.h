@@ -3,7 +3,13 @@
 
 #include <QCoreApplication>
 
+#include <cstddef>
 #include <memory>
+#include <vector>
+
+template<typename T> class feature_matrix;
+template<typename T> class similarity_matrix;
+template<typename T> class banded_similarity_matrix;
 
 /* "Pointer to implementation" or "pImpl" is a C++ programming technique that removes implementation details of a class
  * from its object representation by placing them in a separate class, accessed through unique-ownership opaque pointer.
@@ -24,6 +30,29 @@ public:
     widget& operator=(const widget& other);
 
     int processTo(std::ifstream &wavFp);
+
+    /* Limit the self-similarity matrix of the next analysis to frames at most seconds apart, in O(n*L) memory instead
+     * of O(n^2); 0, the default, computes the full matrix. The lag is widened to what the segmentation kernel needs.
+     */
+    void setMaxLag(double seconds);
+
+    // Result of the analysis in the constructor, 0 if the features, similarity and segments are there
+    int analysisStatus() const;
+
+    /* Feed the samples of a wav file block by block as a live input would, through the streaming extractor and the
+     * live novelty, and report segment boundaries as they are found. A second pass over the file, not cached.
+     */
+    int monitorTo(const char* wavPath, double blockSeconds);
+    int writeFeaturesTo(const char* path);
+    int writeHtkTo(const char* path);
+
+    /* Results of the last analysis, shared rather than copied: handing them to another thread or to QML costs a
+     * reference count, and they stay unchanged while the widget goes on to analyse other audio
+     */
+    std::shared_ptr<const feature_matrix<double>> features() const;
+    std::shared_ptr<const similarity_matrix<double>> similarity() const;
+    std::shared_ptr<const banded_similarity_matrix<double>> bandedSimilarity() const;
+    std::shared_ptr<const std::vector<size_t>> segmentBoundaries() const;
     void do_internal_work();
 
 private:
@@ -31,23 +60,4 @@ private:
     std::unique_ptr<impl> pimpl;
 };
 
-struct wavHeader {
-    /* RIFF Chunk Descriptor */
-    uint8_t         RIFF[4];            // RIFF Header Magic header
-    uint32_t        ChunkSize;          // RIFF Chunk Size
-    uint8_t         WAVE[4];            // WAVE Header
-    /* "fmt" sub-chunk */
-    uint8_t         fmt[4];             // FMT header
-    uint32_t        Subchunk1Size;      // Size of the fmt chunk
-    uint16_t        AudioFormat;        // Audio format 1=PCM, 6=mulaw, 7=alaw, 257=IBM Mu-Law, 258=IBM A-Law, 259=ADPCM
-    uint16_t        NumOfChan;          // Number of channels 1=Mono 2=Stereo
-    uint32_t        SamplesPerSec;      // Sampling Frequency in Hz
-    uint32_t        bytesPerSec;        // bytes per second
-    uint16_t        blockAlign;         // 2=16-bit mono, 4=16-bit stereo
-    uint16_t        bitsPerSample;      // Number of bits per sample
-    /* "data" sub-chunk */
-    uint8_t         Subchunk2ID[4];     // "data" string
-    uint32_t        Subchunk2Size;      // Sampled data length
-};
-
 #endif // WIDGET